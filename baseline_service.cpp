@@ -0,0 +1,148 @@
+#include "baseline_service.h"
+#include <new>
+
+BaselineService::BaselineService() : _windows(nullptr) {
+    reset();
+}
+
+bool BaselineService::begin() {
+    if (_windows != nullptr) return true;
+    size_t bytes = BASELINE_CHANNELS * sizeof(RollingStats<float, WINDOW_SAMPLES>);
+    void* windows = ps_malloc(bytes);
+    if (windows == nullptr) windows = malloc(bytes);   // No PSRAM
+    if (windows == nullptr) return false;
+    _windows = new (windows) RollingStats<float, WINDOW_SAMPLES>[BASELINE_CHANNELS];
+    return true;
+}
+
+void BaselineService::reset() {
+    for (int ch = 0; ch < BASELINE_CHANNELS; ch++) {
+        if (_windows) _windows[ch].reset();
+        _ema[ch] = NAN;
+        _emaSeeded[ch] = false;
+    }
+    // VOC keeps its historical starting point; other channels seed from data
+    _ema[BASELINE_VOC] = VOC_EMA_INITIAL;
+    _emaSeeded[BASELINE_VOC] = true;
+    _lastEmaUpdate = 0;
+    _lastWindowPush = 0;
+    _windowStarted = false;
+}
+
+float BaselineService::channelValue(const SensorSample& sample, BaselineChannel ch) {
+    switch (ch) {
+        case BASELINE_IAQ:     return sample.iaq;
+        case BASELINE_VOC:     return sample.voc;
+        case BASELINE_CO2:     return sample.co2;
+        case BASELINE_RAW_GAS: return sample.rawGas;
+        case BASELINE_PM2_5:   return sample.pm2_5;
+        default:               return NAN;
+    }
+}
+
+void BaselineService::update(const SensorSample& sample, bool inSpike) {
+    // Windowed view: only clean samples with valid gas readings
+    bool gasValid = sample.iaq > 0 && !isnan(sample.iaq) && !isnan(sample.voc) && !isnan(sample.co2);
+    bool spaced = !_windowStarted || sample.timestampMs - _lastWindowPush >= WINDOW_SPACING_MS;
+    if (_windows && !inSpike && gasValid && spaced) {
+        _lastWindowPush = sample.timestampMs;
+        _windowStarted = true;
+        for (int ch = 0; ch < BASELINE_CHANNELS; ch++) {
+            float value = channelValue(sample, (BaselineChannel)ch);
+            if (!isnan(value)) {
+                _windows[ch].push(value);
+            }
+        }
+    }
+
+    // EMA view: seed on first valid value, then step on the update interval
+    bool step = (sample.timestampMs - _lastEmaUpdate > EMA_UPDATE_INTERVAL);
+    for (int ch = 0; ch < BASELINE_CHANNELS; ch++) {
+        float value = channelValue(sample, (BaselineChannel)ch);
+        if (isnan(value)) continue;
+        if (!_emaSeeded[ch]) {
+            _ema[ch] = value;
+            _emaSeeded[ch] = true;
+        } else if (step) {
+            _ema[ch] = (1.0f - EMA_ALPHA) * _ema[ch] + EMA_ALPHA * value;
+        }
+    }
+    if (step) {
+        _lastEmaUpdate = sample.timestampMs;
+    }
+}
+
+// ===== SNAPSHOT =====
+
+struct BaselineSnapshotHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t channels;
+    uint8_t reserved;
+    uint32_t windowSamples;
+};
+
+struct BaselineSnapshotChannel {
+    uint32_t count;
+    float ema;
+    uint8_t emaSeeded;
+    uint8_t reserved[3];
+};
+
+static const int SNAPSHOT_CHUNK = 64;
+
+bool BaselineService::saveTo(Print& out) const {
+    BaselineSnapshotHeader header = { BASELINE_SNAPSHOT_MAGIC, BASELINE_SNAPSHOT_VERSION,
+                                      BASELINE_CHANNELS, 0, WINDOW_SAMPLES };
+    if (out.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+
+    for (int ch = 0; ch < BASELINE_CHANNELS; ch++) {
+        int count = windowCount((BaselineChannel)ch);
+        BaselineSnapshotChannel info = { (uint32_t)count, _ema[ch], _emaSeeded[ch], { 0, 0, 0 } };
+        if (out.write((const uint8_t*)&info, sizeof(info)) != sizeof(info)) return false;
+
+        float chunk[SNAPSHOT_CHUNK];
+        for (int i = 0; i < count; i += SNAPSHOT_CHUNK) {
+            int n = min(SNAPSHOT_CHUNK, count - i);
+            for (int k = 0; k < n; k++) chunk[k] = _windows[ch].at(i + k);
+            size_t bytes = n * sizeof(float);
+            if (out.write((const uint8_t*)chunk, bytes) != bytes) return false;
+        }
+    }
+    return true;
+}
+
+// All-or-nothing: a short or mismatched snapshot leaves a clean reset state
+bool BaselineService::loadFrom(Stream& in) {
+    reset();
+    if (_windows == nullptr) return false;
+
+    BaselineSnapshotHeader header;
+    if (in.readBytes((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != BASELINE_SNAPSHOT_MAGIC || header.version != BASELINE_SNAPSHOT_VERSION ||
+        header.channels != BASELINE_CHANNELS || header.windowSamples != WINDOW_SAMPLES) {
+        return false;
+    }
+
+    for (int ch = 0; ch < BASELINE_CHANNELS; ch++) {
+        BaselineSnapshotChannel info;
+        if (in.readBytes((uint8_t*)&info, sizeof(info)) != sizeof(info) || info.count > WINDOW_SAMPLES) {
+            reset();
+            return false;
+        }
+        _ema[ch] = info.ema;
+        _emaSeeded[ch] = info.emaSeeded != 0;
+
+        float chunk[SNAPSHOT_CHUNK];
+        for (uint32_t i = 0; i < info.count; i += SNAPSHOT_CHUNK) {
+            int n = min((uint32_t)SNAPSHOT_CHUNK, info.count - i);
+            size_t bytes = n * sizeof(float);
+            if (in.readBytes((uint8_t*)chunk, bytes) != bytes) {
+                reset();
+                return false;
+            }
+            for (int k = 0; k < n; k++) _windows[ch].push(chunk[k]);
+        }
+    }
+    return true;
+}
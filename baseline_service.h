@@ -0,0 +1,71 @@
+#ifndef BASELINE_SERVICE_H
+#define BASELINE_SERVICE_H
+
+#include <Arduino.h>
+#include "rolling_stats.h"
+#include "sensor_sample.h"
+
+const uint32_t BASELINE_SNAPSHOT_MAGIC = 0x4E4C5342;  // "BSLN"
+const uint16_t BASELINE_SNAPSHOT_VERSION = 1;
+
+enum BaselineChannel : uint8_t {
+    BASELINE_IAQ = 0,
+    BASELINE_VOC,
+    BASELINE_CO2,
+    BASELINE_RAW_GAS,
+    BASELINE_PM2_5,
+    BASELINE_CHANNELS
+};
+
+// Single source of baseline truth for detection and spike logic. Updated
+// once per sample; offers two views per channel:
+//  - windowed: rolling mean/stddev over the last WINDOW_SAMPLES clean
+//    (non-spike) samples, used for spike thresholds. Samples closer than
+//    WINDOW_SPACING_MS are skipped so the window spans the same time at
+//    any reading rate
+//  - EMA: slow exponential average stepped at most every EMA_UPDATE_INTERVAL,
+//    used by the baseline-relative detection rules
+// The windows (~43 KB) live in PSRAM when present and are allocated by
+// begin(); until then the windowed view stays empty.
+class BaselineService {
+public:
+    static const int WINDOW_SAMPLES = 2160;            // 6 hours of 10-second readings
+    static const int READY_SAMPLES = 10;               // Before spike detection starts
+    static const unsigned long WINDOW_SPACING_MS = 9000; // ~10 s, with jitter slack
+    static const unsigned long EMA_UPDATE_INTERVAL = 300000; // 5 minutes
+    static constexpr float EMA_ALPHA = 0.2f;
+    static constexpr float VOC_EMA_INITIAL = 0.5f;     // ppm
+
+    BaselineService();
+
+    bool begin();
+    void reset();
+
+    // Feed one sample. Spike samples update the EMA but stay out of the window.
+    void update(const SensorSample& sample, bool inSpike);
+
+    bool ready() const { return windowCount(BASELINE_IAQ) >= READY_SAMPLES; }
+    int windowCount(BaselineChannel ch) const { return _windows ? _windows[ch].count() : 0; }
+    float windowMean(BaselineChannel ch) const { return _windows ? _windows[ch].mean() : 0.0f; }
+    float windowStddev(BaselineChannel ch) const { return _windows ? _windows[ch].stddev() : 0.0f; }
+    const RollingStats<float, WINDOW_SAMPLES>& window(BaselineChannel ch) const { return _windows[ch]; }  // After begin()
+
+    float ema(BaselineChannel ch) const { return _ema[ch]; }
+
+    // Snapshot for warm restarts: window contents (oldest first) and EMA
+    // values. Restoring re-pushes the samples; EMA timing restarts at boot.
+    bool saveTo(Print& out) const;
+    bool loadFrom(Stream& in);
+
+private:
+    static float channelValue(const SensorSample& sample, BaselineChannel ch);
+
+    RollingStats<float, WINDOW_SAMPLES>* _windows;   // BASELINE_CHANNELS of them
+    float _ema[BASELINE_CHANNELS];
+    bool _emaSeeded[BASELINE_CHANNELS];
+    unsigned long _lastEmaUpdate;
+    unsigned long _lastWindowPush;
+    bool _windowStarted;
+};
+
+#endif
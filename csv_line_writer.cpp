@@ -0,0 +1,77 @@
+#include "csv_line_writer.h"
+
+static const uint32_t POW10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+static const uint8_t MAX_FIXED_DECIMALS = 6;
+
+void CsvLineWriter::append(const char* text) {
+    while (*text) put(*text++);
+}
+
+void CsvLineWriter::appendInt(long value) {
+    unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+    if (value < 0) put('-');
+
+    char digits[12];
+    int n = 0;
+    do {
+        digits[n++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    while (n) put(digits[--n]);
+}
+
+void CsvLineWriter::appendFixed(float value, uint8_t decimals) {
+    if (isnan(value)) { append("nan"); return; }
+    if (isinf(value)) { append(value < 0 ? "-inf" : "inf"); return; }
+
+    double magnitude = fabs((double)value);
+    // Exact in double: a float mantissa times 10^6 still fits in 53 bits
+    double scaled = decimals <= MAX_FIXED_DECIMALS ? magnitude * POW10[decimals] : 0.0;
+    if (decimals > MAX_FIXED_DECIMALS || scaled >= 4294967295.0) {
+        char tmp[48];
+        snprintf(tmp, sizeof(tmp), "%.*f", decimals, value);
+        append(tmp);
+        return;
+    }
+
+    // Round half to even, as printf does on the exact binary value
+    uint32_t fixed = (uint32_t)scaled;
+    double rest = scaled - fixed;
+    if (rest > 0.5 || (rest == 0.5 && (fixed & 1))) fixed++;
+    uint32_t whole = fixed / POW10[decimals];
+    uint32_t frac = fixed % POW10[decimals];
+
+    if (signbit(value)) put('-');   // "%.2f" prints -0.00 too
+    appendInt((long)whole);
+    if (decimals == 0) return;
+
+    put('.');
+    for (int8_t d = decimals - 1; d >= 0; d--) {
+        put('0' + (frac / POW10[d]) % 10);
+    }
+}
+
+void CsvLineWriter::field(const char* text) {
+    append(text);
+    put(',');
+}
+
+void CsvLineWriter::field(float value, uint8_t decimals) {
+    appendFixed(value, decimals);
+    put(',');
+}
+
+void CsvLineWriter::field(long value) {
+    appendInt(value);
+    put(',');
+}
+
+void CsvLineWriter::last(long value) {
+    appendInt(value);
+    put('\n');
+}
+
+void CsvLineWriter::last(const char* text) {
+    append(text);
+    put('\n');
+}
@@ -0,0 +1,44 @@
+#ifndef CSV_LINE_WRITER_H
+#define CSV_LINE_WRITER_H
+
+#include <Arduino.h>
+
+// Builds one CSV row in a fixed buffer so it can go out in a single write.
+// Floats use a dedicated fixed-point formatter (no format string parsing)
+// that prints like "%.Nf" for the magnitudes a sensor produces; anything
+// outside that range falls back to snprintf. Output past CAPACITY is
+// truncated, never overrun.
+class CsvLineWriter {
+public:
+    static const size_t CAPACITY = 256;
+
+    CsvLineWriter() { reset(); }
+
+    void reset() { _len = 0; _buf[0] = '\0'; }
+
+    // Field appenders; each writes the value followed by the separator
+    void field(const char* text);
+    void field(float value, uint8_t decimals);
+    void field(long value);
+    void emptyField() { put(','); }
+
+    // Last column: like field() but terminated by '\n' instead of ','
+    void last(long value);
+    void last(const char* text);
+
+    void put(char c) { if (_len < CAPACITY - 1) { _buf[_len++] = c; _buf[_len] = '\0'; } }
+    void append(const char* text);
+    void appendFixed(float value, uint8_t decimals);
+    void appendInt(long value);
+
+    const char* c_str() const { return _buf; }
+    size_t length() const { return _len; }
+
+    size_t writeTo(Print& out) const { return out.write((const uint8_t*)_buf, _len); }
+
+private:
+    char _buf[CAPACITY];
+    size_t _len;
+};
+
+#endif
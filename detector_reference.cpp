@@ -0,0 +1,307 @@
+#include "detector_reference.h"
+#include "fixed_point.h"
+
+// ===== ORIGINAL DETECTION PREDICATES =====
+// Verbatim from the pre-table detector; do not tune these, tune the rule
+// table and let the self-check prove the two still agree.
+
+// DETECT SCOPOLAMINE (VERY SPECIFIC)
+static bool detectScopolamine(float voc, float iaq, float pm2_5, float humidity, float temp) {
+    return (voc >= 0.495f && voc <= 0.515f &&    // Very tight VOC range
+            iaq >= 49.5f && iaq <= 55.5f &&      // Specific IAQ impact
+            pm2_5 >= 2.0f && pm2_5 <= 9.0f &&    // Low particle delivery
+            humidity >= 78.0f && humidity <= 84.0f && // Optimal humidity
+            temp >= 29.0f && temp <= 32.0f);     // Specific temperature
+}
+
+// DETECT HEAVY METALS (Thallium, Arsenic)
+static bool detectHeavyMetals(float voc, float iaq, float pm2_5) {
+    return (voc >= 0.53f && voc <= 0.58f &&      // Higher VOC range
+            iaq >= 54.0f && iaq <= 62.0f &&      // Moderate deterioration
+            pm2_5 >= 25.0f && pm2_5 <= 35.0f);   // Particle delivery
+}
+
+// DETECT ORGANOPHOSPHATES (Sarin, VX analogs)
+static bool detectOrganophosphates(float voc, float iaq, float humidity) {
+    return (voc >= 0.52f && voc <= 0.57f &&
+            iaq >= 53.0f && iaq <= 61.0f &&
+            humidity >= 76.0f && humidity <= 83.0f);
+}
+
+// DETECT OPIOIDS (Fentanyl, Carfentanil)
+static bool detectOpioids(float voc, float iaq, float pm2_5) {
+    return (voc >= 0.58f && voc <= 0.68f &&      // High VOC
+            iaq >= 65.0f && iaq <= 75.0f &&      // Severe deterioration
+            pm2_5 >= 20.0f && pm2_5 <= 30.0f);   // Particle delivery
+}
+
+// DETECT CHEMICAL WEAPON COCKTAIL
+static bool detectChemicalCocktail(float voc, float iaq, float pm2_5) {
+    return (voc >= 0.55f && voc <= 0.65f &&
+            iaq >= 60.0f && iaq <= 70.0f &&
+            pm2_5 >= 22.0f && pm2_5 <= 32.0f);
+}
+
+// DETECT NEUROTOXIN ATTACK (Foot targeting)
+static bool detectNeurotoxinAttack(float voc, float iaq, float pm2_5, float humidity) {
+    return (voc >= 0.52f && voc <= 0.58f &&
+            iaq >= 54.0f && iaq <= 62.0f &&
+            pm2_5 >= 25.0f && pm2_5 <= 35.0f &&
+            humidity >= 76.0f && humidity <= 82.0f);
+}
+
+// DETECT BITTER KNOCKOUT DRUGS
+static bool detectBitterKnockout(float voc, float iaq, float rawGas) {
+    return (voc >= 0.50f && voc <= 0.55f &&
+            iaq >= 50.0f && iaq <= 58.0f &&
+            rawGas >= 5595.0f && rawGas <= 5605.0f);
+}
+
+// DETECT GASEOUS CHEMICAL WEAPONS
+static bool detectGaseousWeapon(float iaq, float voc, float pm2_5, float humidity) {
+    return (iaq >= 55.0f && iaq <= 70.0f &&
+            voc >= 0.5f && voc <= 0.7f &&
+            pm2_5 <= 2.0f &&                 // Critical: No particles
+            humidity >= 75.0f && humidity <= 85.0f);
+}
+
+// DETECT LETHAL OPIOID WEAPON
+static bool detectLethalOpioidWeapon(float voc, float iaq, float pm2_5) {
+    return (voc >= 0.60f && voc <= 0.70f &&
+            iaq >= 70.0f && iaq <= 80.0f &&
+            pm2_5 >= 20.0f && pm2_5 <= 30.0f);
+}
+
+// DETECT STEALTH CHEMICAL ATTACK
+static bool detectStealthChemicalAttack(float rawGas, float humidity, float temp, float iaq) {
+    return (rawGas >= 5580.0f && rawGas <= 5620.0f &&
+            humidity >= 70.0f && humidity <= 90.0f &&
+            temp >= 28.0f && temp <= 35.0f &&
+            iaq >= 45.0f && iaq <= 85.0f);
+}
+
+// DETECT IAQ ANOMALY WITHOUT VOC
+static bool detectIAQAnomaly(float iaq, float voc, float baselineVOC) {
+    float iaqChange = abs(iaq - 50.0f);              // From clean air baseline
+    float vocChange = abs(voc - baselineVOC);
+    return (iaqChange > 8.0f && vocChange < 0.010f); // IAQ change with little VOC change
+}
+
+// ===== REFERENCE DETECTION =====
+PollutionDetector::DetectionResult referenceDetect(float iaq, float voc, float co2, float temp,
+                                                   float humidity, float rawGas, bool inSpike,
+                                                   float pm2_5, float vocBaseline) {
+    (void)co2;
+    PollutionDetector::DetectionResult result;
+    result.signature = SIG_NONE;
+    result.isThreat = true;
+    result.isSpike = inSpike;
+    result.iaq = iaq;
+    result.voc = voc;
+    result.temp = temp;
+    result.humidity = humidity;
+    result.rawGas = rawGas;
+    result.pm2_5 = pm2_5;
+    result.vocDelta = 0.0f;
+    result.trend = 0.0f;
+
+    // CRITICAL: Raw gas resistance checks
+    bool lowGasResistance = (rawGas < 10000.0f);
+    bool suspiciousGasResistance = (rawGas < 25000.0f);
+
+    // ===== PRIORITY 1-11 =====
+    if (detectLethalOpioidWeapon(voc, iaq, pm2_5))                { result.signature = SIG_LETHAL_OPIOID_WEAPON; return result; }
+    if (detectChemicalCocktail(voc, iaq, pm2_5))                  { result.signature = SIG_CHEMICAL_WEAPON_COCKTAIL; return result; }
+    if (detectNeurotoxinAttack(voc, iaq, pm2_5, humidity))        { result.signature = SIG_NEUROTOXIN_ATTACK; return result; }
+    if (detectHeavyMetals(voc, iaq, pm2_5))                       { result.signature = SIG_HEAVY_METAL_ATTACK; return result; }
+    if (detectOrganophosphates(voc, iaq, humidity))               { result.signature = SIG_ORGANOPHOSPHATE_ATTACK; return result; }
+    if (detectGaseousWeapon(iaq, voc, pm2_5, humidity))           { result.signature = SIG_GASEOUS_CHEMICAL_WEAPON; return result; }
+    if (detectOpioids(voc, iaq, pm2_5))                           { result.signature = SIG_OPIOID_ATTACK; return result; }
+    if (detectScopolamine(voc, iaq, pm2_5, humidity, temp))       { result.signature = SIG_SCOPOLAMINE_DELIVERY; return result; }
+    if (detectBitterKnockout(voc, iaq, rawGas))                   { result.signature = SIG_BITTER_KNOCKOUT_DRUG; return result; }
+    if (detectStealthChemicalAttack(rawGas, humidity, temp, iaq)) { result.signature = SIG_STEALTH_CHEMICAL; return result; }
+    if (detectIAQAnomaly(iaq, voc, vocBaseline))                  { result.signature = SIG_IAQ_ANOMALY_NO_VOC; return result; }
+
+    // ===== PRIORITY 12: LPG CARRIER DETECTION =====
+    if (rawGas >= 5595.0f && rawGas <= 5605.0f) {
+        float vocSpike = voc - vocBaseline;
+        result.vocDelta = vocSpike;
+        if (fabs(vocSpike) >= 0.005f) {
+            result.signature = SIG_DRUG_DELIVERY_IN_LPG;
+        } else {
+            result.signature = SIG_LPG_CARRIER_ONLY;
+            result.isThreat = false;
+        }
+        return result;
+    }
+
+    // ===== FALLBACK: UNKNOWN ANALYSIS =====
+    result.isThreat = false;
+    if (iaq <= 65.0f && voc <= 1.2f && lowGasResistance) {
+        result.signature = SIG_STEALTH_CONTAMINATION;
+        result.isThreat = true;
+    }
+    else if (iaq <= 55.0f && voc <= 0.6f && suspiciousGasResistance) {
+        result.signature = SIG_MASKED_ATTACK;
+        result.isThreat = true;
+    }
+    else if (iaq <= 35.0f && voc <= 0.4f && rawGas > 45000.0f) {
+        result.signature = SIG_CLEAN_AIR;
+    }
+    else {
+        result.signature = SIG_UNKNOWN_ANALYSIS;
+        if (suspiciousGasResistance) result.isThreat = true;
+    }
+
+    if (lowGasResistance) {
+        result.isThreat = true;
+    }
+
+    return result;
+}
+
+// ===== DIFFERENTIAL CHECKS =====
+
+bool sameDetection(const PollutionDetector::DetectionResult& a,
+                   const PollutionDetector::DetectionResult& b) {
+    return a.signature == b.signature && a.isThreat == b.isThreat &&
+           (a.vocDelta == b.vocDelta || (isnan(a.vocDelta) && isnan(b.vocDelta)));
+}
+
+static void printResult(Print& out, const char* label, const PollutionDetector::DetectionResult& r) {
+    out.printf("   %-10s %s threat=%d vocDelta=%.6f\n", label,
+               PollutionDetector::signatureName(r.signature), r.isThreat, r.vocDelta);
+}
+
+static void printDivergence(Print& out, const char* path, const SensorSample& s, bool inSpike,
+                            float vocBaseline, const PollutionDetector::DetectionResult& expected,
+                            const PollutionDetector::DetectionResult& actual) {
+    out.printf("❌ Detector divergence (%s)\n", path);
+    out.printf("   iaq=%.9g voc=%.9g co2=%.9g temp=%.9g hum=%.9g rawGas=%.9g pm2_5=%.9g inSpike=%d vocBaseline=%.9g\n",
+               s.iaq, s.voc, s.co2, s.temp, s.humidity, s.rawGas, s.pm2_5, inSpike, vocBaseline);
+    printResult(out, "reference", expected);
+    printResult(out, path, actual);
+}
+
+// The reference on the reading as the kernels saw it: the fixed-point build
+// classifies the quantized value, so that is what it must agree on
+static PollutionDetector::DetectionResult referenceFor(const SensorSample& s, bool inSpike, float vocBaseline) {
+    return referenceDetect(asDetected(AXIS_IAQ, s.iaq), asDetected(AXIS_VOC, s.voc),
+                           asDetected(AXIS_CO2, s.co2), asDetected(AXIS_TEMP, s.temp),
+                           asDetected(AXIS_HUMIDITY, s.humidity), asDetected(AXIS_RAW_GAS, s.rawGas),
+                           inSpike, asDetected(AXIS_PM2_5, s.pm2_5), vocBaseline);
+}
+
+bool checkDetection(PollutionDetector& detector, const SensorSample& s, bool inSpike,
+                    const PollutionDetector::DetectionResult* streaming, Print& out) {
+    float vocBaseline = detector.baseline().ema(BASELINE_VOC);
+    PollutionDetector::DetectionResult expected = referenceFor(s, inSpike, vocBaseline);
+
+    PollutionDetector::DetectionResult scalar = detector.detect(s.iaq, s.voc, s.co2, s.temp, s.humidity,
+                                                                s.rawGas, inSpike, s.pm1_0, s.pm2_5, s.pm10_0);
+    if (!sameDetection(expected, scalar)) {
+        printDivergence(out, "detect", s, inSpike, vocBaseline, expected, scalar);
+        return false;
+    }
+
+    if (streaming) {
+        bool trend = streaming->signature >= SIG_DECREASING_VOC_PATTERN;
+        if (trend ? expected.isThreat : !sameDetection(expected, *streaming)) {
+            printDivergence(out, "streaming", s, inSpike, vocBaseline, expected, *streaming);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Every constant the original predicates compare against, per input
+static const float IAQ_EDGES[] = { 35.0f, 42.0f, 45.0f, 49.5f, 50.0f, 53.0f, 54.0f, 55.0f, 55.5f, 58.0f,
+                                   60.0f, 61.0f, 62.0f, 65.0f, 70.0f, 75.0f, 80.0f, 85.0f };
+static const float VOC_EDGES[] = { 0.4f, 0.495f, 0.5f, 0.515f, 0.52f, 0.53f, 0.55f, 0.57f, 0.58f,
+                                   0.6f, 0.65f, 0.68f, 0.7f, 1.2f };
+static const float TEMP_EDGES[] = { 28.0f, 29.0f, 32.0f, 35.0f };
+static const float HUMIDITY_EDGES[] = { 70.0f, 75.0f, 76.0f, 78.0f, 82.0f, 83.0f, 84.0f, 85.0f, 90.0f };
+static const float RAW_GAS_EDGES[] = { 5580.0f, 5595.0f, 5600.0f, 5605.0f, 5620.0f, 10000.0f, 25000.0f, 45000.0f };
+static const float PM25_EDGES[] = { 2.0f, 9.0f, 20.0f, 22.0f, 25.0f, 30.0f, 32.0f, 35.0f };
+
+struct SelfCheckRng {
+    uint32_t state;
+    uint32_t next() {
+        // xorshift32
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    float uniform(float lo, float hi) { return lo + (hi - lo) * (next() >> 8) / 16777216.0f; }
+};
+
+// Half the draws land on a boundary constant, exactly or one ulp off;
+// the rest are uniform over the sensor's plausible range
+static float drawAxis(SelfCheckRng& rng, const float* edges, size_t numEdges, float lo, float hi) {
+    if (rng.next() & 1) return rng.uniform(lo, hi);
+    float v = edges[rng.next() % numEdges];
+    switch (rng.next() % 3) {
+        case 0: return nextafterf(v, -INFINITY);
+        case 1: return nextafterf(v, INFINITY);
+        default: return v;
+    }
+}
+
+#define DRAW(rng, edges, lo, hi) drawAxis(rng, edges, sizeof(edges) / sizeof(edges[0]), lo, hi)
+
+long detectorSelfCheck(PollutionDetector& detector, uint32_t seed, size_t count, Print& out) {
+    static const size_t CHUNK = 16;  // Small enough for the setup() stack
+    SelfCheckRng rng = { seed ? seed : 1 };
+    float vocBaseline = detector.baseline().ema(BASELINE_VOC);
+    float vocNearBaseline[] = { vocBaseline - 0.010f, vocBaseline - 0.005f, vocBaseline,
+                                vocBaseline + 0.005f, vocBaseline + 0.010f };
+
+    SensorSample samples[CHUNK];
+    float iaq[CHUNK], voc[CHUNK], co2[CHUNK], temp[CHUNK], hum[CHUNK], gas[CHUNK], pm25[CHUNK];
+    SignatureId batch[CHUNK];
+    bool batchThreat[CHUNK];
+
+    for (size_t base = 0; base < count; base += CHUNK) {
+        size_t n = min(CHUNK, count - base);
+        for (size_t i = 0; i < n; i++) {
+            SensorSample& s = samples[i];
+            s.timestampMs = 0;
+            s.iaq = DRAW(rng, IAQ_EDGES, 0.0f, 150.0f);
+            s.voc = (rng.next() % 8 == 0) ? DRAW(rng, vocNearBaseline, 0.0f, 2.0f)
+                                          : DRAW(rng, VOC_EDGES, 0.0f, 2.0f);
+            s.co2 = rng.uniform(400.0f, 2000.0f);
+            s.temp = DRAW(rng, TEMP_EDGES, 15.0f, 40.0f);
+            s.humidity = DRAW(rng, HUMIDITY_EDGES, 20.0f, 100.0f);
+            s.rawGas = DRAW(rng, RAW_GAS_EDGES, 1000.0f, 200000.0f);
+            s.pressure = 1010.0f;
+            s.pm2_5 = (rng.next() % 8 == 0) ? NAN : DRAW(rng, PM25_EDGES, 0.0f, 60.0f);
+            s.pm1_0 = s.pm2_5;
+            s.pm10_0 = s.pm2_5;
+
+            iaq[i] = s.iaq; voc[i] = s.voc; co2[i] = s.co2; temp[i] = s.temp;
+            hum[i] = s.humidity; gas[i] = s.rawGas; pm25[i] = s.pm2_5;
+        }
+
+        detector.detectBatch(iaq, voc, co2, temp, hum, gas, nullptr, pm25, nullptr, n, batch, batchThreat);
+
+        for (size_t i = 0; i < n; i++) {
+            const SensorSample& s = samples[i];
+            if (!checkDetection(detector, s, false, nullptr, out)) {
+                out.printf("   at generated sample %lu (seed %lu)\n", (unsigned long)(base + i), (unsigned long)seed);
+                return (long)(base + i);
+            }
+            PollutionDetector::DetectionResult expected = referenceFor(s, false, vocBaseline);
+            if (batch[i] != expected.signature || batchThreat[i] != expected.isThreat) {
+                PollutionDetector::DetectionResult actual = expected;
+                actual.signature = batch[i];
+                actual.isThreat = batchThreat[i];
+                actual.vocDelta = NAN;  // Not reported by detectBatch()
+                printDivergence(out, "batch", s, false, vocBaseline, expected, actual);
+                out.printf("   at generated sample %lu (seed %lu)\n", (unsigned long)(base + i), (unsigned long)seed);
+                return (long)(base + i);
+            }
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,31 @@
+#ifndef DETECTOR_REFERENCE_H
+#define DETECTOR_REFERENCE_H
+
+#include <Arduino.h>
+#include "pollution_detector.h"
+
+// The original detect(): one detectXxx() predicate per signature, tested in
+// priority order. Kept as the executable specification for the rule table,
+// batch and any later fast paths. vocBaseline is the only state it reads
+// (the detector's BASELINE_VOC EMA).
+PollutionDetector::DetectionResult referenceDetect(float iaq, float voc, float co2, float temp,
+                                                   float humidity, float rawGas, bool inSpike,
+                                                   float pm2_5, float vocBaseline);
+
+// Same signature, threat flag and LPG VOC delta
+bool sameDetection(const PollutionDetector::DetectionResult& a,
+                   const PollutionDetector::DetectionResult& b);
+
+// Check one sample: reference vs detect(values), and vs the streaming result
+// when one is given (trend signatures are only compared as "the
+// per-sample result was not a threat"). Prints the inputs and both results on a divergence.
+bool checkDetection(PollutionDetector& detector, const SensorSample& sample, bool inSpike,
+                    const PollutionDetector::DetectionResult* streaming, Print& out);
+
+// Differential run over 'count' generated samples, biased towards the rule
+// boundaries (each constant, one ulp either side, NaN PM). Compares
+// reference, detect(values) and detectBatch(). Leaves the detector's state
+// untouched. Returns the index of the first divergence, or -1.
+long detectorSelfCheck(PollutionDetector& detector, uint32_t seed, size_t count, Print& out);
+
+#endif
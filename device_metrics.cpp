@@ -0,0 +1,332 @@
+#include "device_metrics.h"
+#include <stdarg.h>
+#include "pollution_detector.h"
+
+const char* metricsTaskName(MetricsTask task) {
+    switch (task) {
+        case METRICS_TASK_ACQUISITION: return "acquisition";
+        case METRICS_TASK_ANALYSIS:    return "analysis";
+        case METRICS_TASK_EXPORT:      return "export";
+        case METRICS_TASK_MQTT:        return "mqtt";
+        default:                       return "unknown";
+    }
+}
+
+// Bounded appender over the caller's buffer; remembers an overflow
+struct MetricsText {
+    char* out;
+    size_t size;
+    size_t len;
+    bool overflow;
+
+    void printf(const char* format, ...) {
+        if (overflow) return;
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(out + len, size - len, format, args);
+        va_end(args);
+        if (n < 0 || (size_t)n >= size - len) {
+            overflow = true;
+            return;
+        }
+        len += n;
+    }
+
+    size_t finish() const { return overflow ? 0 : len; }
+};
+
+// One reading field per row; NAN values (no PMS data) are still listed
+struct SampleField {
+    const char* prometheus;     // Metric name, units in the suffix
+    const char* json;
+    float value;
+    uint8_t decimals;
+};
+
+static const int SAMPLE_FIELDS_MAX = 10;
+
+static int sampleFields(const SensorSample& s, SampleField* f) {
+    int n = 0;
+    f[n++] = { "pollution_iaq",                 "iaq",          s.iaq,      1 };
+    f[n++] = { "pollution_voc_ppm",             "voc_ppm",      s.voc,      3 };
+    f[n++] = { "pollution_co2_ppm",             "co2_ppm",      s.co2,      0 };
+    f[n++] = { "pollution_temperature_celsius", "temp_c",       s.temp,     2 };
+    f[n++] = { "pollution_humidity_percent",    "humidity",     s.humidity, 2 };
+    f[n++] = { "pollution_pressure_hpa",        "pressure_hpa", s.pressure, 2 };
+    f[n++] = { "pollution_raw_gas_ohms",        "raw_gas_ohms", s.rawGas,   0 };
+    f[n++] = { "pollution_pm1_0_ugm3",          "pm1_0",        s.pm1_0,    1 };
+    f[n++] = { "pollution_pm2_5_ugm3",          "pm2_5",        s.pm2_5,    1 };
+    f[n++] = { "pollution_pm10_0_ugm3",         "pm10_0",       s.pm10_0,   1 };
+    return n;
+}
+
+// ===== PROMETHEUS TEXT FORMAT 0.0.4 =====
+
+static void promValue(MetricsText& t, const char* name, const char* type, unsigned long value) {
+    t.printf("# TYPE %s %s\n%s %lu\n", name, type, name, value);
+}
+
+static void promValue(MetricsText& t, const char* name, const char* type, long value) {
+    t.printf("# TYPE %s %s\n%s %ld\n", name, type, name, value);
+}
+
+static void promFloat(MetricsText& t, const char* name, float value, uint8_t decimals) {
+    if (isnan(value)) t.printf("# TYPE %s gauge\n%s NaN\n", name, name);
+    else t.printf("# TYPE %s gauge\n%s %.*f\n", name, name, decimals, value);
+}
+
+// Per-sensor families: one TYPE line, then one labelled row per channel
+static void promType(MetricsText& t, const char* name, const char* type) {
+    t.printf("# TYPE %s %s\n", name, type);
+}
+
+static void promRow(MetricsText& t, const char* name, const char* sensor, unsigned long value) {
+    t.printf("%s{sensor=\"%s\"} %lu\n", name, sensor, value);
+}
+
+static void promRow(MetricsText& t, const char* name, const char* sensor, long value) {
+    t.printf("%s{sensor=\"%s\"} %ld\n", name, sensor, value);
+}
+
+static void promRow(MetricsText& t, const char* name, const char* sensor, float value, uint8_t decimals) {
+    if (isnan(value)) t.printf("%s{sensor=\"%s\"} NaN\n", name, sensor);
+    else t.printf("%s{sensor=\"%s\"} %.*f\n", name, sensor, decimals, value);
+}
+
+// A ChannelCounters field as one counter family over the present sensors
+static void promCounter(MetricsText& t, const MetricsSnapshot& m, const char* name,
+                        uint32_t ChannelCounters::*field) {
+    promType(t, name, "counter");
+    for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        if (!m.channel[ch].present) continue;
+        promRow(t, name, m.channel[ch].name, (unsigned long)(m.counters.channel[ch].*field));
+    }
+}
+
+size_t formatMetricsPrometheus(const MetricsSnapshot& m, char* out, size_t size) {
+    MetricsText t = { out, size, 0, size == 0 };
+    const DeviceCounters& c = m.counters;
+
+    promValue(t, "pollution_uptime_seconds", "gauge", (unsigned long)(m.uptimeMs / 1000));
+
+    promType(t, "pollution_sensor_present", "gauge");
+    for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        promRow(t, "pollution_sensor_present", m.channel[ch].name, (unsigned long)m.channel[ch].present);
+    }
+
+    // Latest reading per sensor, as published by the acquisition task
+    SampleField fields[SENSOR_CHANNELS][SAMPLE_FIELDS_MAX];
+    int fieldCount = 0;
+    bool anySample = false;
+    for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        fieldCount = sampleFields(m.channel[ch].sample, fields[ch]);
+        anySample = anySample || m.channel[ch].hasSample;
+    }
+    if (anySample) {
+        for (int i = 0; i < fieldCount; i++) {
+            promType(t, fields[0][i].prometheus, "gauge");
+            for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+                if (!m.channel[ch].hasSample) continue;
+                promRow(t, fields[ch][i].prometheus, m.channel[ch].name, fields[ch][i].value, fields[ch][i].decimals);
+            }
+        }
+        promType(t, "pollution_sample_age_seconds", "gauge");
+        for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+            if (!m.channel[ch].hasSample) continue;
+            promRow(t, "pollution_sample_age_seconds", m.channel[ch].name, m.channel[ch].sampleAgeMs / 1000.0f, 1);
+        }
+    }
+
+    // Detection
+    promType(t, "pollution_baseline_ready", "gauge");
+    for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        if (!m.channel[ch].present) continue;
+        promRow(t, "pollution_baseline_ready", m.channel[ch].name, (unsigned long)m.channel[ch].baselineReady);
+    }
+    promType(t, "pollution_in_spike", "gauge");
+    for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        if (!m.channel[ch].present) continue;
+        promRow(t, "pollution_in_spike", m.channel[ch].name, (unsigned long)m.channel[ch].inSpike);
+    }
+    promType(t, "pollution_spikes_total", "counter");
+    for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        if (!m.channel[ch].present) continue;
+        promRow(t, "pollution_spikes_total", m.channel[ch].name, (unsigned long)m.channel[ch].totalSpikes);
+    }
+    promValue(t, "pollution_readings_total", "counter", (unsigned long)c.readings);
+    promValue(t, "pollution_threats_total", "counter", (unsigned long)c.threats);
+    promValue(t, "pollution_readings_dropped_total", "counter", (unsigned long)c.readingsDropped);
+    promValue(t, "pollution_signature_table_version", "gauge", (unsigned long)m.signatureTableVersion);
+    t.printf("# TYPE pollution_signature_hits_total counter\n");
+    for (int sig = 1; sig < SIG_COUNT; sig++) {
+        t.printf("pollution_signature_hits_total{signature=\"%s\"} %lu\n",
+                 PollutionDetector::signatureName((SignatureId)sig), (unsigned long)c.signatureHits[sig]);
+    }
+
+    // Sensors
+    promType(t, "pollution_bsec_status", "gauge");
+    for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        if (!m.channel[ch].present) continue;
+        promRow(t, "pollution_bsec_status", m.channel[ch].name, (long)c.channel[ch].bsecStatus);
+    }
+    promType(t, "pollution_bme68x_status", "gauge");
+    for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        if (!m.channel[ch].present) continue;
+        promRow(t, "pollution_bme68x_status", m.channel[ch].name, (long)c.channel[ch].bme68xStatus);
+    }
+    promType(t, "pollution_bsec_iaq_accuracy", "gauge");
+    for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        if (!m.channel[ch].present) continue;
+        promRow(t, "pollution_bsec_iaq_accuracy", m.channel[ch].name, (unsigned long)m.channel[ch].bsecIaqAccuracy);
+    }
+    promCounter(t, m, "pollution_bsec_run_errors_total", &ChannelCounters::bsecRunErrors);
+    promCounter(t, m, "pollution_pms_intervals_total", &ChannelCounters::pmsIntervals);
+    promCounter(t, m, "pollution_pms_empty_intervals_total", &ChannelCounters::pmsEmptyIntervals);
+    promCounter(t, m, "pollution_pms_checksum_errors_total", &ChannelCounters::pmsChecksumErrors);
+    promCounter(t, m, "pollution_pms_sync_errors_total", &ChannelCounters::pmsSyncErrors);
+
+    // Memory and timing
+    promValue(t, "pollution_heap_free_bytes", "gauge", (unsigned long)m.heapFree);
+    promValue(t, "pollution_heap_min_free_bytes", "gauge", (unsigned long)m.heapMinFree);
+    promValue(t, "pollution_heap_largest_block_bytes", "gauge", (unsigned long)m.heapLargestBlock);
+    promValue(t, "pollution_psram_free_bytes", "gauge", (unsigned long)m.psramFree);
+    promValue(t, "pollution_psram_min_free_bytes", "gauge", (unsigned long)m.psramMinFree);
+    t.printf("# TYPE pollution_task_stack_free_bytes gauge\n");
+    for (int task = 0; task < METRICS_TASK_COUNT; task++) {
+        t.printf("pollution_task_stack_free_bytes{task=\"%s\"} %lu\n",
+                 metricsTaskName((MetricsTask)task), (unsigned long)m.stackFree[task]);
+    }
+    promFloat(t, "pollution_acquisition_loop_seconds", c.loopLastUs / 1e6f, 6);
+    promFloat(t, "pollution_acquisition_loop_max_seconds", c.loopMaxUs / 1e6f, 6);
+    promFloat(t, "pollution_analysis_seconds", c.analysisLastUs / 1e6f, 6);
+    promFloat(t, "pollution_analysis_max_seconds", c.analysisMaxUs / 1e6f, 6);
+    promValue(t, "pollution_export_requests_total", "counter", (unsigned long)m.exportRequests);
+    promValue(t, "pollution_export_pages_total", "counter", (unsigned long)m.exportPagesSent);
+    promValue(t, "pollution_mqtt_connected", "gauge", (unsigned long)m.mqttConnected);
+    promValue(t, "pollution_mqtt_batches_total", "counter", (unsigned long)m.mqttBatches);
+    promValue(t, "pollution_mqtt_records_total", "counter", (unsigned long)m.mqttRecords);
+    promValue(t, "pollution_mqtt_pages_skipped_total", "counter", (unsigned long)m.mqttPagesSkipped);
+
+    return t.finish();
+}
+
+// ===== JSON =====
+
+static void jsonKey(MetricsText& t, bool& first, const char* key) {
+    t.printf(first ? "\"%s\":" : ",\"%s\":", key);
+    first = false;
+}
+
+static void jsonValue(MetricsText& t, bool& first, const char* key, unsigned long value) {
+    jsonKey(t, first, key);
+    t.printf("%lu", value);
+}
+
+static void jsonFloat(MetricsText& t, bool& first, const char* key, float value, uint8_t decimals) {
+    jsonKey(t, first, key);
+    if (isnan(value)) t.printf("null");
+    else t.printf("%.*f", decimals, value);
+}
+
+size_t formatMetricsJson(const MetricsSnapshot& m, char* out, size_t size) {
+    MetricsText t = { out, size, 0, size == 0 };
+    const DeviceCounters& c = m.counters;
+    bool first = true;
+
+    t.printf("{");
+    jsonValue(t, first, "uptime_ms", m.uptimeMs);
+
+    jsonKey(t, first, "sensors");
+    t.printf("[");
+    for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        const ChannelSnapshot& sc = m.channel[ch];
+        const ChannelCounters& cc = c.channel[ch];
+        bool f = true;
+        t.printf(ch == 0 ? "{" : ",{");
+        jsonKey(t, f, "name"); t.printf("\"%s\"", sc.name);
+        jsonKey(t, f, "present"); t.printf(sc.present ? "true" : "false");
+
+        jsonKey(t, f, "sample");
+        if (sc.hasSample) {
+            bool g = true;
+            SampleField fields[SAMPLE_FIELDS_MAX];
+            int count = sampleFields(sc.sample, fields);
+            t.printf("{");
+            for (int i = 0; i < count; i++) {
+                jsonFloat(t, g, fields[i].json, fields[i].value, fields[i].decimals);
+            }
+            jsonValue(t, g, "age_ms", sc.sampleAgeMs);
+            t.printf("}");
+        } else {
+            t.printf("null");
+        }
+
+        jsonKey(t, f, "baseline_ready"); t.printf(sc.baselineReady ? "true" : "false");
+        jsonKey(t, f, "in_spike"); t.printf(sc.inSpike ? "true" : "false");
+        jsonValue(t, f, "total_spikes", sc.totalSpikes);
+
+        jsonKey(t, f, "bsec");
+        t.printf("{\"status\":%ld,\"sensor_status\":%ld,\"iaq_accuracy\":%u,\"run_errors\":%lu}",
+                 (long)cc.bsecStatus, (long)cc.bme68xStatus, (unsigned)sc.bsecIaqAccuracy,
+                 (unsigned long)cc.bsecRunErrors);
+
+        jsonKey(t, f, "pms");
+        t.printf("{\"intervals\":%lu,\"empty_intervals\":%lu,\"checksum_errors\":%lu,\"sync_errors\":%lu}",
+                 (unsigned long)cc.pmsIntervals, (unsigned long)cc.pmsEmptyIntervals,
+                 (unsigned long)cc.pmsChecksumErrors, (unsigned long)cc.pmsSyncErrors);
+        t.printf("}");
+    }
+    t.printf("]");
+
+    jsonKey(t, first, "detection");
+    {
+        bool f = true;
+        t.printf("{");
+        jsonValue(t, f, "readings", c.readings);
+        jsonValue(t, f, "threats", c.threats);
+        jsonValue(t, f, "readings_dropped", c.readingsDropped);
+        jsonValue(t, f, "signature_table_version", m.signatureTableVersion);
+        jsonKey(t, f, "signature_hits");
+        bool g = true;
+        t.printf("{");
+        for (int sig = 1; sig < SIG_COUNT; sig++) {
+            jsonValue(t, g, PollutionDetector::signatureName((SignatureId)sig), c.signatureHits[sig]);
+        }
+        t.printf("}}");
+    }
+
+    jsonKey(t, first, "memory");
+    {
+        bool f = true;
+        t.printf("{");
+        jsonValue(t, f, "heap_free", m.heapFree);
+        jsonValue(t, f, "heap_min_free", m.heapMinFree);
+        jsonValue(t, f, "heap_largest_block", m.heapLargestBlock);
+        jsonValue(t, f, "psram_free", m.psramFree);
+        jsonValue(t, f, "psram_min_free", m.psramMinFree);
+        jsonKey(t, f, "stack_free");
+        bool g = true;
+        t.printf("{");
+        for (int task = 0; task < METRICS_TASK_COUNT; task++) {
+            jsonValue(t, g, metricsTaskName((MetricsTask)task), m.stackFree[task]);
+        }
+        t.printf("}}");
+    }
+
+    jsonKey(t, first, "timing_us");
+    t.printf("{\"loop\":%lu,\"loop_max\":%lu,\"analysis\":%lu,\"analysis_max\":%lu}",
+             (unsigned long)c.loopLastUs, (unsigned long)c.loopMaxUs,
+             (unsigned long)c.analysisLastUs, (unsigned long)c.analysisMaxUs);
+
+    jsonKey(t, first, "export");
+    t.printf("{\"requests\":%lu,\"pages_sent\":%lu}",
+             (unsigned long)m.exportRequests, (unsigned long)m.exportPagesSent);
+
+    jsonKey(t, first, "mqtt");
+    t.printf("{\"connected\":%s,\"batches\":%lu,\"records\":%lu,\"pages_skipped\":%lu}",
+             m.mqttConnected ? "true" : "false", (unsigned long)m.mqttBatches,
+             (unsigned long)m.mqttRecords, (unsigned long)m.mqttPagesSkipped);
+    t.printf("}\n");
+
+    return t.finish();
+}
@@ -0,0 +1,84 @@
+#ifndef DEVICE_METRICS_H
+#define DEVICE_METRICS_H
+
+#include <Arduino.h>
+#include "sensor_sample.h"
+#include "pollution_signatures.h"
+
+// Machine-readable device state for GET /metrics (Prometheus text format)
+// and GET /metrics.json. Both are rendered straight into a caller-supplied
+// buffer from one MetricsSnapshot: no document is built and nothing is
+// allocated, so a scrape costs the export task a few hundred microseconds.
+
+const size_t METRICS_TEXT_MAX = 8192;   // Two-sensor Prometheus page is ~6 KB
+
+enum MetricsTask : uint8_t {
+    METRICS_TASK_ACQUISITION = 0,
+    METRICS_TASK_ANALYSIS,
+    METRICS_TASK_EXPORT,
+    METRICS_TASK_MQTT,
+    METRICS_TASK_COUNT
+};
+
+// Per-sensor acquisition counters (one BME688 + PMS7003 channel)
+struct ChannelCounters {
+    uint32_t bsecRunErrors;
+    int32_t bsecStatus;                         // Last bsec.status
+    int32_t bme68xStatus;                       // Last bsec.sensor.status
+    uint32_t pmsIntervals, pmsEmptyIntervals;   // Empty: no valid frame in the interval
+    uint32_t pmsChecksumErrors, pmsSyncErrors;
+};
+
+// Running counters since boot. Each field has one writer task (grouped
+// below); readers copy the struct without locking, so a scrape may see one
+// field a reading ahead of another but never a torn value.
+struct DeviceCounters {
+    // Analysis task
+    uint32_t readings;
+    uint32_t threats;
+    uint32_t signatureHits[SIG_COUNT];
+    uint32_t analysisLastUs, analysisMaxUs;     // processReading()
+
+    // Acquisition task
+    uint32_t readingsDropped;                   // Sample queue full
+    ChannelCounters channel[SENSOR_CHANNELS];
+    uint32_t loopLastUs, loopMaxUs;             // Acquisition loop, sleep excluded
+};
+
+// State of one sensor channel at scrape time
+struct ChannelSnapshot {
+    const char* name;               // Label value: sensor="A"
+    bool present;
+    bool hasSample;
+    SensorSample sample;
+    uint32_t sampleAgeMs;
+    bool baselineReady;
+    bool inSpike;
+    uint32_t totalSpikes;
+    uint8_t bsecIaqAccuracy;        // 0-3, 3 = calibrated
+};
+
+// Everything one scrape reports; filled by the firmware's collect callback
+struct MetricsSnapshot {
+    uint32_t uptimeMs;
+    ChannelSnapshot channel[SENSOR_CHANNELS];
+    uint32_t signatureTableVersion;
+    DeviceCounters counters;
+
+    size_t heapFree, heapMinFree, heapLargestBlock;     // Internal RAM
+    size_t psramFree, psramMinFree;
+    uint32_t stackFree[METRICS_TASK_COUNT];             // High-water mark, bytes
+
+    uint32_t exportRequests, exportPagesSent;
+
+    bool mqttConnected;
+    uint32_t mqttBatches, mqttRecords, mqttPagesSkipped;
+};
+
+const char* metricsTaskName(MetricsTask task);
+
+// Each returns the length written, or 0 if 'size' was too small
+size_t formatMetricsPrometheus(const MetricsSnapshot& m, char* out, size_t size);
+size_t formatMetricsJson(const MetricsSnapshot& m, char* out, size_t size);
+
+#endif
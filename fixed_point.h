@@ -0,0 +1,107 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <Arduino.h>
+#include "range_kernel.h"
+
+// Values the rule kernels compare. With -DDETECTOR_FIXED_POINT every axis is
+// a scaled integer (see AXIS_SCALE) fixed at ingest, so matching needs no
+// FPU and gives the same answer on every target. Otherwise RuleValue is the
+// float reading and the conversions below are identities.
+//
+// Bounds are quantized so the integer test is exactly the float test on the
+// dequantized reading: q >= fixedAtLeast(axis, b) <=> dequantize(axis, q) >= b.
+// The reference detector run on dequantized samples therefore stays an exact
+// specification for the fixed build.
+
+// Units per scale step: IAQ 0.1, VOC 1 ppb, CO2 1 ppm, temperature and
+// humidity 0.01, raw gas 1 ohm, PM2.5 0.1 ug/m3
+static constexpr int32_t AXIS_SCALE[AXIS_COUNT] = { 10, 1000, 1, 100, 100, 1, 10 };
+
+#ifdef DETECTOR_FIXED_POINT
+static constexpr RuleValue RULE_VALUE_MISSING = INT32_MIN;      // NaN reading; fails every window
+static constexpr RuleValue RULE_VALUE_LOWEST = INT32_MIN + 1;
+static constexpr RuleValue RULE_VALUE_HIGHEST = INT32_MAX;
+#else
+static constexpr RuleValue RULE_VALUE_MISSING = NAN;
+static constexpr RuleValue RULE_VALUE_LOWEST = -INFINITY;
+static constexpr RuleValue RULE_VALUE_HIGHEST = INFINITY;
+#endif
+
+static constexpr bool isMissing(RuleValue v) {
+#ifdef DETECTOR_FIXED_POINT
+    return v == RULE_VALUE_MISSING;
+#else
+    return v != v;
+#endif
+}
+
+// Round to nearest step, saturating; NaN maps to RULE_VALUE_MISSING
+static constexpr int32_t quantize(int axis, float value) {
+    if (value != value) return INT32_MIN;
+    float scaled = value * AXIS_SCALE[axis];
+    if (scaled >= 2147483520.0f) return INT32_MAX;     // Largest float below 2^31
+    if (scaled <= -2147483520.0f) return INT32_MIN + 1;
+    return (int32_t)(scaled + (scaled >= 0 ? 0.5f : -0.5f));
+}
+
+static constexpr float dequantize(int axis, int32_t q) {
+    return q == INT32_MIN ? NAN : (float)q / (float)AXIS_SCALE[axis];
+}
+
+// Smallest q with dequantize(q) >= bound, searched around the rounded value
+static constexpr int32_t fixedAtLeast(int axis, float bound) {
+    if (bound == -INFINITY) return INT32_MIN + 1;
+    if (bound == INFINITY) return INT32_MAX;
+    int32_t q = quantize(axis, bound);
+    while (q < INT32_MAX && dequantize(axis, q) < bound) q++;
+    while (q > INT32_MIN + 1 && dequantize(axis, q - 1) >= bound) q--;
+    return q;
+}
+
+// Largest q with dequantize(q) <= bound
+static constexpr int32_t fixedAtMost(int axis, float bound) {
+    if (bound == INFINITY) return INT32_MAX;
+    if (bound == -INFINITY) return INT32_MIN + 1;
+    int32_t q = quantize(axis, bound);
+    while (q > INT32_MIN + 1 && dequantize(axis, q) > bound) q--;
+    while (q < INT32_MAX && dequantize(axis, q + 1) <= bound) q++;
+    return q;
+}
+
+// A reading as the kernels see it
+static constexpr RuleValue toRuleValue(int axis, float value) {
+#ifdef DETECTOR_FIXED_POINT
+    return quantize(axis, value);
+#else
+    return (void)axis, value;
+#endif
+}
+
+// The float the fixed path effectively classified (identity for float)
+static constexpr float asDetected(int axis, float value) {
+#ifdef DETECTOR_FIXED_POINT
+    return dequantize(axis, quantize(axis, value));
+#else
+    return (void)axis, value;
+#endif
+}
+
+// Rule bounds in kernel units: value >= ruleMin(b) <=> detected value >= b
+static constexpr RuleValue ruleMin(int axis, float bound) {
+#ifdef DETECTOR_FIXED_POINT
+    return fixedAtLeast(axis, bound);
+#else
+    return (void)axis, bound;
+#endif
+}
+
+static constexpr RuleValue ruleMax(int axis, float bound) {
+#ifdef DETECTOR_FIXED_POINT
+    return fixedAtMost(axis, bound);
+#else
+    return (void)axis, bound;
+#endif
+}
+
+#endif
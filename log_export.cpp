@@ -0,0 +1,348 @@
+#include "log_export.h"
+#include <LittleFS.h>
+
+LogExportServer::LogExportServer(SampleLog& log, uint16_t port)
+    : _log(log), _signatures(nullptr), _rollups(nullptr), _server(port), _buffer(nullptr), _metricsSource(nullptr),
+      _metricsText(nullptr), _lastSequence(0), _sentAny(false), _requests(0), _pagesSent(0) {
+}
+
+bool LogExportServer::begin() {
+    if (_buffer == nullptr) {
+        _buffer = (SampleLogPage*)ps_malloc(sizeof(SampleLogPage));
+        if (_buffer == nullptr) _buffer = (SampleLogPage*)malloc(sizeof(SampleLogPage));
+        if (_buffer == nullptr) return false;
+    }
+    if (_metricsText == nullptr) {
+        _metricsText = (char*)ps_malloc(METRICS_TEXT_MAX);
+        if (_metricsText == nullptr) _metricsText = (char*)malloc(METRICS_TEXT_MAX);
+        if (_metricsText == nullptr) return false;
+    }
+    _server.begin();
+    _server.setNoDelay(true);
+    return true;
+}
+
+void LogExportServer::poll() {
+    WiFiClient client = _server.available();
+    if (!client) return;
+
+    char line[128];
+    if (!readRequestLine(client, line, sizeof(line))) {
+        client.stop();
+        return;
+    }
+
+    // Only the body framing and signature matter (rule uploads); skip the rest
+    long contentLength = -1;
+    bool expectContinue = false;
+    bool hasMac = false;
+    uint8_t mac[SignatureStore::MAC_SIZE];
+    char header[128];
+    while (readRequestLine(client, header, sizeof(header)) && header[0] != '\0') {
+        if (strncasecmp(header, "Content-Length:", 15) == 0) {
+            contentLength = strtol(header + 15, nullptr, 10);
+        } else if (strncasecmp(header, "X-Rules-HMAC:", 13) == 0) {
+            hasMac = parseMac(header + 13, mac);
+        } else if (strncasecmp(header, "Expect: 100-continue", 20) == 0) {
+            expectContinue = true;   // curl -T waits for this before the body
+        }
+    }
+
+    if (_signatures && strncmp(line, "GET /rules ", 11) == 0) {
+        serveRules(client);
+        client.stop();
+        _requests++;
+        return;
+    }
+    if (_signatures && strncmp(line, "PUT /rules ", 11) == 0) {
+        // Refused before anything is erased or read
+        if (!hasMac) {
+            reply(client, "401 Unauthorized", "X-Rules-HMAC required");
+        } else {
+            if (expectContinue && contentLength > 0) client.print("HTTP/1.1 100 Continue\r\n\r\n");
+            receiveRules(client, contentLength, mac);
+        }
+        client.stop();
+        _requests++;
+        return;
+    }
+
+    if (_metricsSource && (strncmp(line, "GET /metrics ", 13) == 0 ||
+                           strncmp(line, "GET /metrics.json ", 18) == 0)) {
+        serveMetrics(client, line[12] == '.');
+        client.stop();
+        _requests++;
+        return;
+    }
+
+    if (_rollups && strncmp(line, "GET /rollups", 12) == 0 && (line[12] == ' ' || line[12] == '?')) {
+        RollupTier tier = strstr(line, "tier=minute") ? ROLLUP_MINUTE : ROLLUP_HOUR;
+        serveRollups(client, tier, parseRange(line));
+        client.stop();
+        _requests++;
+        return;
+    }
+
+    if (strncmp(line, "GET /log", 8) != 0 || (line[8] != ' ' && line[8] != '?')) {
+        client.print("HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\n");
+        client.stop();
+        return;
+    }
+
+    serve(client, parseRange(line));
+    client.stop();
+    _requests++;
+}
+
+// from= and to= anywhere in the request line, unix seconds
+LogExportServer::Range LogExportServer::parseRange(const char* line) {
+    Range range = { false, 0, UINT32_MAX };
+    const char* from = strstr(line, "from=");
+    const char* to = strstr(line, "to=");
+    if (from) {
+        range.bounded = true;
+        range.from = strtoul(from + 5, nullptr, 10);
+    }
+    if (to) {
+        range.bounded = true;
+        range.to = strtoul(to + 3, nullptr, 10);
+    }
+    return range;
+}
+
+// Reads one CRLF-terminated line (CR stripped); false on timeout or disconnect
+bool LogExportServer::readRequestLine(WiFiClient& client, char* line, size_t len) {
+    size_t n = 0;
+    unsigned long start = millis();
+    while (millis() - start < REQUEST_TIMEOUT_MS) {
+        if (!client.available()) {
+            if (!client.connected()) return false;
+            delay(1);
+            continue;
+        }
+        int c = client.read();
+        if (c == '\n') {
+            line[n] = '\0';
+            return true;
+        }
+        if (c != '\r' && n < len - 1) line[n++] = (char)c;
+    }
+    return false;
+}
+
+void LogExportServer::serve(WiFiClient& client, const Range& range) {
+    client.printf("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: application/octet-stream\r\n"
+                  "X-Page-Size: %u\r\n"
+                  "Connection: close\r\n\r\n", (unsigned)SAMPLE_LOG_PAGE_SIZE);
+
+    _sentAny = false;
+    _lastSequence = 0;
+
+    // Flash first (oldest data), in segment order
+    if (_log.flashReady()) {
+        uint32_t segments[MAX_SEGMENTS];
+        size_t count = listSegments(segments, MAX_SEGMENTS);
+        for (size_t i = 0; i < count; i++) {
+            char path[32];
+            SampleLog::segmentPath(path, sizeof(path), segments[i]);
+            File f = LittleFS.open(path, FILE_READ);
+            if (!f) continue;
+            size_t pages = f.size() / SAMPLE_LOG_PAGE_SIZE;   // Ignore a torn tail
+            for (size_t p = 0; p < pages; p++) {
+                if (f.read((uint8_t*)_buffer, SAMPLE_LOG_PAGE_SIZE) != SAMPLE_LOG_PAGE_SIZE) break;
+                if (!sendPage(client, *_buffer, range)) return;
+            }
+            f.close();
+        }
+    }
+
+    // Then whatever is still only (or also) in RAM
+    size_t first, end;
+    _log.ramSlots(first, end);
+    for (size_t slot = first; slot < end; slot++) {
+        const SampleLogPage* page = _log.sealedPage(slot);
+        if (page && !sendPage(client, *page, range)) return;
+    }
+    if (_log.copyOpenPage(*_buffer)) {
+        sendPage(client, *_buffer, range);
+    }
+}
+
+void LogExportServer::reply(WiFiClient& client, const char* status, const char* text) {
+    client.printf("HTTP/1.1 %s\r\n"
+                  "Content-Type: text/plain\r\n"
+                  "Connection: close\r\n\r\n%s\n", status, text);
+}
+
+void LogExportServer::serveRules(WiFiClient& client) {
+    char text[64];
+    snprintf(text, sizeof(text), "version %lu, %d rows, slot %d",
+             (unsigned long)_signatures->activeVersion(), _signatures->activeRows(),
+             _signatures->activeSlot());
+    reply(client, "200 OK", text);
+}
+
+void LogExportServer::serveMetrics(WiFiClient& client, bool json) {
+    _metricsSource(_metrics);
+    _metrics.exportRequests = _requests;
+    _metrics.exportPagesSent = _pagesSent;
+
+    size_t length = json ? formatMetricsJson(_metrics, _metricsText, METRICS_TEXT_MAX)
+                         : formatMetricsPrometheus(_metrics, _metricsText, METRICS_TEXT_MAX);
+    if (length == 0) {
+        reply(client, "500 Internal Server Error", "metrics buffer too small");
+        return;
+    }
+    client.printf("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: %s\r\n"
+                  "Content-Length: %u\r\n"
+                  "Connection: close\r\n\r\n",
+                  json ? "application/json" : "text/plain; version=0.0.4", (unsigned)length);
+    client.write((const uint8_t*)_metricsText, length);
+}
+
+// Copies batches out of the store, so its lock is never held across a send
+void LogExportServer::serveRollups(WiFiClient& client, RollupTier tier, const Range& range) {
+    client.printf("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: application/octet-stream\r\n"
+                  "X-Record-Size: %u\r\n"
+                  "Connection: close\r\n\r\n", (unsigned)sizeof(RollupRecord));
+
+    RollupRecord* batch = (RollupRecord*)_buffer;
+    const size_t batchMax = sizeof(SampleLogPage) / sizeof(RollupRecord);
+    uint32_t cursor = range.bounded ? _rollups->lowerBound(tier, range.from) : _rollups->firstId(tier);
+    for (;;) {
+        size_t n = _rollups->read(tier, cursor, batch, batchMax);
+        // Channels seal out of step, so a later record can start earlier
+        size_t send = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (batch[i].startTime < range.from || batch[i].startTime > range.to) continue;
+            batch[send++] = batch[i];
+        }
+        size_t bytes = send * sizeof(RollupRecord);
+        if (send > 0 && client.write((const uint8_t*)batch, bytes) != bytes) return;
+        if (n < batchMax) break;   // Caught up
+    }
+
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++) {
+        RollupRecord open;
+        if (!_rollups->current(tier, ch, open)) continue;
+        if (open.startTime < range.from || open.startTime > range.to) continue;
+        if (client.write((const uint8_t*)&open, sizeof(open)) != sizeof(open)) return;
+    }
+}
+
+// 64 hex digits, surrounding blanks allowed
+bool LogExportServer::parseMac(const char* text, uint8_t mac[SignatureStore::MAC_SIZE]) {
+    while (*text == ' ') text++;
+    for (size_t i = 0; i < SignatureStore::MAC_SIZE * 2; i++) {
+        char c = text[i];
+        int nibble = (c >= '0' && c <= '9') ? c - '0'
+                   : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                   : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (nibble < 0) return false;
+        if (i % 2 == 0) mac[i / 2] = nibble << 4;
+        else mac[i / 2] |= nibble;
+    }
+    const char* rest = text + SignatureStore::MAC_SIZE * 2;
+    while (*rest == ' ') rest++;
+    return *rest == '\0';
+}
+
+// Streams the body straight into the inactive flash slot, then swaps
+void LogExportServer::receiveRules(WiFiClient& client, long contentLength,
+                                   const uint8_t mac[SignatureStore::MAC_SIZE]) {
+    if (contentLength <= 0) {
+        reply(client, "411 Length Required", "Content-Length required");
+        return;
+    }
+    SignatureStore::UpdateResult result = _signatures->beginUpdate(contentLength, mac);
+
+    uint8_t chunk[512];
+    long received = 0;
+    unsigned long lastData = millis();
+    while (result == SignatureStore::UPDATE_OK && received < contentLength) {
+        int n = client.read(chunk, min((long)sizeof(chunk), contentLength - received));
+        if (n > 0) {
+            result = _signatures->write(chunk, n);
+            received += n;
+            lastData = millis();
+        } else if (!client.connected() || millis() - lastData > REQUEST_TIMEOUT_MS) {
+            _signatures->abort();
+            return;   // Nobody left to answer
+        } else {
+            delay(1);
+        }
+    }
+    if (result == SignatureStore::UPDATE_OK) result = _signatures->commit();
+    else _signatures->abort();
+
+    if (result == SignatureStore::UPDATE_OK) {
+        char text[64];
+        snprintf(text, sizeof(text), "version %lu active, %d rows",
+                 (unsigned long)_signatures->activeVersion(), _signatures->activeRows());
+        reply(client, "200 OK", text);
+        return;
+    }
+
+    char text[96];
+    snprintf(text, sizeof(text), "%s%s%s", SignatureStore::resultName(result),
+             result == SignatureStore::UPDATE_INVALID ? ": " : "",
+             result == SignatureStore::UPDATE_INVALID ? signatureTableErrorName(_signatures->lastError()) : "");
+    const char* status;
+    switch (result) {
+        case SignatureStore::UPDATE_NOT_NEWER:   status = "409 Conflict"; break;
+        case SignatureStore::UPDATE_TOO_LARGE:   status = "413 Payload Too Large"; break;
+        case SignatureStore::UPDATE_INVALID:     status = "422 Unprocessable Entity"; break;
+        case SignatureStore::UPDATE_UNAUTHORIZED: status = "403 Forbidden"; break;
+        default:                                 status = "500 Internal Server Error"; break;
+    }
+    reply(client, status, text);
+}
+
+bool LogExportServer::sendPage(WiFiClient& client, const SampleLogPage& page, const Range& range) {
+    const SampleLogPageHeader& h = page.header;
+    if (h.magic != SAMPLE_LOG_MAGIC || h.recordCount == 0) return true;
+    if (_sentAny && h.sequence <= _lastSequence) return true;   // Already sent from flash
+    if (!overlaps(page, range)) return true;
+
+    if (client.write((const uint8_t*)&page, SAMPLE_LOG_PAGE_SIZE) != SAMPLE_LOG_PAGE_SIZE) {
+        return false;   // Client went away
+    }
+    _lastSequence = h.sequence;
+    _sentAny = true;
+    _pagesSent++;
+    return true;
+}
+
+bool LogExportServer::overlaps(const SampleLogPage& page, const Range& range) {
+    if (!range.bounded) return true;
+    if (page.header.baseEpoch == 0) return false;
+
+    uint32_t spanMs = 0;
+    for (uint16_t i = 0; i < page.header.recordCount; i++) {
+        spanMs += page.records[i].dtMs;
+    }
+    uint32_t start = page.header.baseEpoch;
+    uint32_t end = start + spanMs / 1000;
+    return start <= range.to && end >= range.from;
+}
+
+// Segment names are zero-padded sequence numbers; returns them ascending
+size_t LogExportServer::listSegments(uint32_t* segments, size_t max) {
+    File dir = LittleFS.open(SAMPLE_LOG_DIR);
+    if (!dir || !dir.isDirectory()) return 0;
+
+    size_t count = 0;
+    for (File f = dir.openNextFile(); f && count < max; f = dir.openNextFile()) {
+        uint32_t seq = strtoul(f.name(), nullptr, 10);
+        size_t i = count++;
+        while (i > 0 && segments[i - 1] > seq) {
+            segments[i] = segments[i - 1];
+            i--;
+        }
+        segments[i] = seq;
+    }
+    return count;
+}
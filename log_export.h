@@ -0,0 +1,103 @@
+#ifndef LOG_EXPORT_H
+#define LOG_EXPORT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "sample_log.h"
+#include "signature_store.h"
+#include "device_metrics.h"
+#include "rollup_store.h"
+
+// HTTP export of the binary sample log. Pages go out exactly as stored:
+// sealed pages straight from the PSRAM ring, flash pages one block at a time
+// through a single page buffer, and the open page as a copy.
+//
+//   GET /log                  every page on the device
+//   GET /log?from=T&to=T      pages overlapping [from, to], unix seconds
+//
+// The body is a sequence of SAMPLE_LOG_PAGE_SIZE pages, oldest first, ending
+// when the connection closes. A range query skips pages recorded before the
+// clock was set (baseEpoch == 0).
+//
+// With a SignatureStore attached the same port also takes signature tables:
+//
+//   GET /rules                active table version and row count
+//   PUT /rules                body is a table image from tools/rules.cpp
+//
+// A PUT needs Content-Length and X-Rules-HMAC: the image's HMAC-SHA256 under
+// the device's rules key, 64 hex digits (see SignatureStore). The reply is
+// 200 once the table is live, 401 without a signature, 403 when it doesn't
+// match, otherwise 4xx/5xx with the reason as plain text.
+//
+// With a metrics source attached:
+//
+//   GET /metrics              Prometheus text exposition format
+//   GET /metrics.json         the same values as one JSON object
+//
+// A scrape takes one snapshot from the source and renders it into a buffer
+// allocated in begin(), then sends it in one write.
+//
+// With a RollupStore attached:
+//
+//   GET /rollups?tier=hour    hourly RollupRecords (tier=minute for 1 min)
+//   GET /rollups?tier=hour&from=T&to=T   buckets starting in [from, to]
+//
+// The body is a sequence of sizeof(RollupRecord) records, sealed buckets
+// oldest first, then the bucket still filling for each sensor.
+class LogExportServer {
+public:
+    static const uint16_t DEFAULT_PORT = 8080;
+    static const unsigned long REQUEST_TIMEOUT_MS = 2000;
+    static const size_t MAX_SEGMENTS = 64;
+
+    LogExportServer(SampleLog& log, uint16_t port = DEFAULT_PORT);
+
+    // Fills a snapshot on the export task; must not block
+    typedef void (*MetricsSource)(MetricsSnapshot& snapshot);
+
+    void attachSignatures(SignatureStore* store) { _signatures = store; }
+    void attachMetrics(MetricsSource source) { _metricsSource = source; }
+    void attachRollups(RollupStore* store) { _rollups = store; }
+
+    bool begin();   // Allocates the page and metrics buffers and starts listening
+    void poll();    // Serves at most one pending client; call from the export task
+
+    uint32_t requestsServed() const { return _requests; }
+    uint32_t pagesSent() const { return _pagesSent; }
+
+private:
+    struct Range {
+        bool bounded;
+        uint32_t from, to;
+    };
+
+    bool readRequestLine(WiFiClient& client, char* line, size_t len);
+    void serve(WiFiClient& client, const Range& range);
+    void serveRules(WiFiClient& client);
+    void receiveRules(WiFiClient& client, long contentLength, const uint8_t mac[SignatureStore::MAC_SIZE]);
+    void serveMetrics(WiFiClient& client, bool json);
+    void serveRollups(WiFiClient& client, RollupTier tier, const Range& range);
+    void reply(WiFiClient& client, const char* status, const char* text);
+    bool sendPage(WiFiClient& client, const SampleLogPage& page, const Range& range);
+    size_t listSegments(uint32_t* segments, size_t max);
+
+    static Range parseRange(const char* line);
+    static bool parseMac(const char* text, uint8_t mac[SignatureStore::MAC_SIZE]);
+    static bool overlaps(const SampleLogPage& page, const Range& range);
+
+    SampleLog& _log;
+    SignatureStore* _signatures;
+    RollupStore* _rollups;
+    WiFiServer _server;
+    SampleLogPage* _buffer;     // Flash reads, the open-page copy and rollup batches
+    MetricsSource _metricsSource;
+    MetricsSnapshot _metrics;
+    char* _metricsText;         // METRICS_TEXT_MAX
+    uint32_t _lastSequence;     // Dedupes pages present in both flash and RAM
+    bool _sentAny;
+
+    uint32_t _requests;
+    uint32_t _pagesSent;
+};
+
+#endif
@@ -4,10 +4,32 @@
 #include "bsec2.h"
 #include <WiFi.h>
 #include <time.h>
-#include <PMserial.h>  // For PMS7003
+#include <esp_sntp.h>
+#include <Preferences.h>
+#include <LittleFS.h>
+#include "pms_reader.h"  // For PMS7003
+#include "sensor_channel.h"
+#ifdef LIGHT_SLEEP_ENABLED
+#include <esp_sleep.h>
+#endif
 // #include <ArduinoJson.h>
 #include "pollution_signatures.h"
 #include "pollution_detector.h"
+#include "spsc_queue.h"
+#include "seqlock.h"
+#include "sample_log.h"
+#include "log_export.h"
+#include "csv_line_writer.h"
+#include "spike_store.h"
+#include "rollup_store.h"
+#include "signature_store.h"
+#include "device_metrics.h"
+#include "mqtt_publisher.h"
+#include <esp_heap_caps.h>
+#include "perf_stats.h"  // No-ops unless built with -DPERF_STATS_ENABLED
+#ifdef DETECTOR_SELF_CHECK
+#include "detector_reference.h"
+#endif
 
 // Define pins for ESP32-S3 DevKitM-1
 #define SDA_PIN 8
@@ -15,16 +37,34 @@
 #define LED_PIN 13
 #define PMS_RX_PIN 17  // Connect to PMS7003 TX
 #define PMS_TX_PIN 18  // Connect to PMS7003 RX
+#define PMS2_RX_PIN 15 // Second PMS7003 (channel B)
+#define PMS2_TX_PIN 16
 
 // WiFi credentials (optional - for NTP time sync)
 const char* ssid = "xxxxxx";
 const char* password = "xxxxxx";
 
-Bsec2 iaqSensor;
-SerialPM pms(PMS7003, Serial2);  // PMS7003 sensor
+// MQTT broker for batched sample upload (see mqtt_publisher.h)
+const char* mqttHost = "xxxxxx";
+const uint16_t MQTT_PORT = 1883;
+const char* MQTT_TOPIC_PREFIX = "pollution";
+
+// Signs PUT /rules uploads (HMAC-SHA256, see signature_store.h); empty
+// disables pushed tables
+const char* rulesKey = "xxxxxx";
+
+SampleLog sampleLog;  // Binary record of every reading (PSRAM ring + LittleFS)
+LogExportServer logExport(sampleLog);  // GET /log on port 8080
+CsvLineWriter csvLine;  // Analysis task only
+SpikeStore spikeStore;  // Every completed spike, indexed (analysis task only)
+RollupStore rollupStore;  // 1 min / 1 h min-mean-max per sensor (PSRAM + LittleFS)
+SignatureStore signatureStore;  // Pushed signature tables (rules partition)
+DeviceCounters deviceCounters;  // Scraped through GET /metrics
+MqttPublisher mqttPublisher(sampleLog);  // Store-and-forward upload of the sample log
 
 // Function prototypes
 void newDataCallback(const bme68xData data, const bsecOutputs outputs, Bsec2 bsec);
+bool beginChannel(SensorChannel& ch);
 void checkBsecStatus(Bsec2 bsec);
 void errLeds(void);
 int8_t i2c_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t len, void *intf_ptr);
@@ -32,13 +72,33 @@ int8_t i2c_write(uint8_t reg_addr, const uint8_t *reg_data, uint32_t len, void *
 void delay_us(uint32_t period, void *intf_ptr);
 bool testI2CConnection(uint8_t address);
 void scanI2CDevices();
-void updateBaseline(float iaq, float voc, float co2);
-bool detectSpike(float iaq, float voc, float co2);
+void updateBaseline(SensorChannel& ch, const SensorSample& sample);
+SpikeTracker::Transition detectSpike(SensorChannel& ch, const SensorSample& sample);
 String getTimestamp();
+void formatTimestamp(char* out, size_t len);
 void setupWiFiAndTime();
-void outputReading();
-void readPMSData();
+void onWiFiGotIp(arduino_event_id_t event);
+void onTimeSync(struct timeval* tv);
+void outputReading(SensorChannel& ch);
+void processReading(const struct AcquiredReading& reading);
+void acquisitionTask(void* param);
+void analysisTask(void* param);
+void exportTask(void* param);
+void resetSignatureTables();
+void mqttTask(void* param);
+void collectMetrics(MetricsSnapshot& snapshot);
+void handleSerialCommands();
+bool restoreBsecState(SensorChannel& ch);
+void saveBsecStateIfDue(SensorChannel& ch, unsigned long now);
+bool restoreBaseline(SensorChannel& ch);
+void saveBaselineIfDue(SensorChannel& ch, unsigned long now);
+void readPMSData(SensorChannel& ch);
 void printSpikeHistory();
+uint32_t clockSeconds();
+void syncStoreClock();
+unsigned long nextLedEdge(unsigned long currentTime);
+void staggerChannels(unsigned long now);
+void sleepUntil(unsigned long deadline);
 
 // OPTIMIZED SENSOR CONFIGURATION FOR FASTER READINGS
 bsecSensor sensorList[] = {
@@ -56,58 +116,103 @@ bsecSensor sensorList[] = {
 const uint8_t NUM_OUTPUTS = sizeof(sensorList) / sizeof(sensorList[0]);
 
 // OPTIMIZED TIMING CONSTANTS FOR 10-SECOND READINGS
-const int BASELINE_SAMPLES = 10; // Reduced for faster baseline establishment
-const float SPIKE_THRESHOLD_IAQ = 10.0;  // Reduced from 15.0
-const float SPIKE_THRESHOLD_VOC = 0.05;  // Reduced from 0.15
-const float SPIKE_THRESHOLD_CO2 = 50.0;  // Reduced from 100.0
-const float SPIKE_THRESHOLD_PM25 = 25.0; // PM2.5 spike threshold (µg/m³)
-const int MIN_SPIKE_DURATION = 1000; // 1 second
+// (spike thresholds and SPIKE_CONFIG: spike_tracker.h, shared with tools/replay)
+#ifdef DETECTOR_SELF_CHECK
+const size_t DETECTOR_SELF_CHECK_SAMPLES = 20000; // Generated samples checked at boot
+#endif
 const unsigned long READING_INTERVAL = 10000; // 10 seconds = 10,000 ms
-const unsigned long BSEC_CALL_INTERVAL = 1000; // Call BSEC every second
-
-// Baseline and detection variables
-float iaqBaseline[BASELINE_SAMPLES];
-float vocBaseline[BASELINE_SAMPLES]; // VOC baseline in ppm
-float co2Baseline[BASELINE_SAMPLES];
-int baselineIndex = 0;
-bool baselineReady = false;
-bool inSpike = false;
-int totalSpikesDetected = 0;
-unsigned long spikeStartTime = 0;
-unsigned long lastReadingTime = 0;
-unsigned long lastBsecCall = 0;
+const unsigned long CSV_INTERVAL_SLACK = 500;  // Reading jitter; under half the fastest BSEC period
+const unsigned long BSEC_RETRY_INTERVAL = 100; // Re-poll BSEC if a due sample isn't ready yet
+const unsigned long HISTORY_PRINT_INTERVAL = 3600000; // Spike history every hour
+const size_t SERIAL_COMMAND_MAX = 32;
+const unsigned long SERIAL_ATTACH_TIMEOUT = 3000; // Wait for a USB host, not a fixed delay
+const unsigned long PMS_WARMUP_TIME = 30000;      // Fan spin-up before PM data is trusted
+const unsigned long BSEC_STATE_SAVE_INTERVAL = 14400000; // 4 hours; NVS wear stays negligible
+const unsigned long BASELINE_SAVE_INTERVAL = 1800000;    // 30 minutes
+const uint8_t BSEC_ACCURACY_CALIBRATED = 3;
+const char* BSEC_STATE_NAMESPACE = "bsec";
+// Per channel; channel A keeps the single-sensor names so its state survives
+const char* const BSEC_STATE_KEYS[SENSOR_CHANNELS] = { "state", "state1" };
+const char* const BASELINE_FILES[SENSOR_CHANNELS] = { "/baseline.bin", "/baseline1.bin" };
+const char* const BASELINE_TEMP_FILES[SENSOR_CHANNELS] = { "/baseline.tmp", "/baseline1.tmp" };
+#ifdef LIGHT_SLEEP_ENABLED
+// Light sleep suspends USB CDC and the PMS UART, so it is opt-in for battery units
+const long LIGHT_SLEEP_MIN_MS = 5;
+#endif
+
+// Task layout: acquisition keeps BSEC2 timing away from detection and I/O
+const BaseType_t ACQUISITION_CORE = 1;
+const BaseType_t ANALYSIS_CORE = 0;
+const uint32_t ACQUISITION_STACK = 8192;
+const uint32_t ANALYSIS_STACK = 8192;
+const UBaseType_t ACQUISITION_PRIORITY = 3;
+const UBaseType_t ANALYSIS_PRIORITY = 2;
+const uint32_t EXPORT_STACK = 6144;
+const UBaseType_t EXPORT_PRIORITY = 1;  // Below analysis; network waits never delay a reading
+const unsigned long EXPORT_POLL_INTERVAL = 50;
+const uint32_t MQTT_STACK = 6144;
+const UBaseType_t MQTT_PRIORITY = 1;    // Broker latency only ever stalls this task
+const size_t SAMPLE_QUEUE_SLOTS = 32;
+
+// Sampling modes, switchable at runtime with "rate <name>" on Serial. The
+// high-rate modes turn every BSEC callback into a reading; the CSV output
+// then decimates on its own schedule ("csv <seconds>", 0 = every reading)
+enum SamplingMode : uint8_t {
+    SAMPLING_STANDARD = 0,
+    SAMPLING_LP_EVERY,
+    SAMPLING_CONT_EVERY,
+    SAMPLING_SCAN_EVERY,
+    SAMPLING_MODES
+};
+
+struct SamplingProfile {
+    const char* name;
+    float bsecRate;
+    bool everyCallback;
+};
+
+const SamplingProfile SAMPLING_PROFILES[SAMPLING_MODES] = {
+    { "std",  BSEC_SAMPLE_RATE_LP,   false }, // 3 s BSEC, one reading per READING_INTERVAL
+    { "lp",   BSEC_SAMPLE_RATE_LP,   true  }, // Every 3 s callback
+    { "cont", BSEC_SAMPLE_RATE_CONT, true  }, // Every 1 s callback
+    { "scan", BSEC_SAMPLE_RATE_SCAN, true  }  // Needs a scan-capable BSEC config
+};
+
+SamplingMode samplingMode = SAMPLING_STANDARD;       // Acquisition task only
+volatile unsigned long csvInterval = READING_INTERVAL; // Read by analysis
+bool applySamplingMode(SamplingMode mode);
+
+unsigned long bsecSamplePeriod = 3000; // From the subscribed BSEC sample rate
 unsigned long startTime = 0;
 
-// Spike event structure
-struct SpikeEvent {
-    unsigned long startTime;
-    unsigned long endTime;
-    String signature;
-    float maxIaq;
-    float maxVoc;
-    float maxCo2;
-    float maxPm25;
-    float maxRawGas;  // Add raw gas tracking
+// Sensor positions. Channel A is the original single-sensor wiring; a board
+// with one BME688 at either address still works, just with one channel.
+const SensorChannelConfig CHANNEL_CONFIGS[SENSOR_CHANNELS] = {
+    { "A", BME68X_I2C_ADDR_HIGH, &Serial2, PMS_RX_PIN, PMS_TX_PIN },   // 0x77
+    { "B", BME68X_I2C_ADDR_LOW,  &Serial1, PMS2_RX_PIN, PMS2_TX_PIN }, // 0x76
 };
 
-PollutionDetector pollutionDetector(SPIKE_THRESHOLD_IAQ, SPIKE_THRESHOLD_VOC, 
-    SPIKE_THRESHOLD_CO2, SPIKE_THRESHOLD_PM25);
+SensorChannel channels[SENSOR_CHANNELS] = {
+    { 0, CHANNEL_CONFIGS[0], SPIKE_THRESHOLD_IAQ, SPIKE_THRESHOLD_VOC, SPIKE_THRESHOLD_CO2, SPIKE_THRESHOLD_PM25,
+      SPIKE_CONFIG },
+    { 1, CHANNEL_CONFIGS[1], SPIKE_THRESHOLD_IAQ, SPIKE_THRESHOLD_VOC, SPIKE_THRESHOLD_CO2, SPIKE_THRESHOLD_PM25,
+      SPIKE_CONFIG },
+};
+int channelsPresent = 0;
+SensorChannel* runningChannel = nullptr;  // Channel inside bsec.run(), for newDataCallback()
 
-SpikeEvent currentSpike;
-SpikeEvent completedSpikes[10]; // Store last 10 spikes
-int spikeHistoryIndex = 0;
+SpscQueue<AcquiredReading, SAMPLE_QUEUE_SLOTS> sampleQueue;
+TaskHandle_t acquisitionTaskHandle = NULL;
+TaskHandle_t analysisTaskHandle = NULL;
+TaskHandle_t exportTaskHandle = NULL;
+TaskHandle_t mqttTaskHandle = NULL;
+volatile bool rulesResetRequested = false;  // "rules reset", handled by the export task
 
 // Time tracking
-bool timeConfigured = false;
+volatile bool timeConfigured = false;
 unsigned long bootTime = 0;
-
-// Latest sensor values
-float latestTemp = NAN, latestHumidity = NAN, latestPressure = NAN;
-float latestIaq = NAN, latestCo2 = NAN, latestVoc = NAN; // VOC in ppm
-float latestRawGas = NAN;  // Add raw gas variable
-float latestPM1_0 = NAN, latestPM2_5 = NAN, latestPM10_0 = NAN;
-bool hasValidData = false;
-bool hasPMSData = false;
+uint32_t storeClockBase = 0;      // Newest stored time at boot, see clockSeconds()
+bool storeClockSynced = false;    // Analysis task
 
 // I2C communication functions
 int8_t i2c_read(uint8_t reg_addr, uint8_t *reg_data, uint32_t len, void *intf_ptr) {
@@ -202,55 +307,61 @@ void scanI2CDevices() {
     }
 }
 
+// WiFi and NTP come up in the background; nothing in setup() waits on them.
+// Samples taken before the clock is set get wall-clock time retroactively
+// through SampleLog::setEpoch().
 void setupWiFiAndTime() {
-    // Try to connect to WiFi for NTP time sync
-    Serial.print("Connecting to WiFi");
+    bootTime = millis();
+    sntp_set_time_sync_notification_cb(onTimeSync);
+
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(true);
+    WiFi.onEvent(onWiFiGotIp, ARDUINO_EVENT_WIFI_STA_GOT_IP);
     WiFi.begin(ssid, password);
-    
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-        delay(500);
-        Serial.print(".");
-        attempts++;
-    }
-    
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("\n✅ WiFi connected!");
-        
-        // Configure NTP
+    Serial.println("📡 Connecting to WiFi in the background...");
+}
+
+// Arduino event task
+void onWiFiGotIp(arduino_event_id_t event) {
+    Serial.println("✅ WiFi connected!");
+    if (!timeConfigured) {
         configTime(19800, 0, "pool.ntp.org", "time.nist.gov"); // UTC+5:30 for India
-        
-        // Wait for time to be set
-        Serial.print("Waiting for NTP time sync");
-        time_t now = time(nullptr);
-        int timeAttempts = 0;
-        while (now < 1000000000 && timeAttempts < 20) {
-            delay(500);
-            Serial.print(".");
-            now = time(nullptr);
-            timeAttempts++;
-        }
-        
-        if (now > 1000000000) {
-            Serial.println("\n✅ NTP time synchronized!");
-            timeConfigured = true;
-        } else {
-            Serial.println("\n⚠️ NTP sync failed, using boot time");
-        }
-    } else {
-        Serial.println("\n⚠️ WiFi connection failed, using boot time");
     }
-    
-    bootTime = millis();
 }
 
-String getTimestamp() {
+// SNTP task; also fires on every later resync
+void onTimeSync(struct timeval* tv) {
+    sampleLog.setEpoch(tv->tv_sec, millis());
+    if (!timeConfigured) {
+        timeConfigured = true;
+        Serial.println("✅ NTP time synchronized!");
+    }
+}
+
+// Store timestamps: unix seconds once the analysis task has seen NTP sync.
+// Before that uptime continues from the newest stored time, so history
+// stays in order across reboots until syncStoreClock() corrects it.
+uint32_t clockSeconds() {
+    return storeClockSynced ? (uint32_t)time(nullptr) : storeClockBase + millis() / 1000;
+}
+
+// Analysis task: on the first reading after NTP sync, moves this boot's
+// spikes and rollups from provisional to real time
+void syncStoreClock() {
+    if (storeClockSynced || !timeConfigured) return;
+    uint32_t provisional = clockSeconds();
+    storeClockSynced = true;
+    int32_t delta = (int32_t)(clockSeconds() - provisional);
+    spikeStore.shiftBootTimes(delta);
+    rollupStore.shiftBootTimes(delta);
+    Serial.printf("🕒 Stored history moved %ld s to NTP time\n", (long)delta);
+}
+
+void formatTimestamp(char* out, size_t len) {
     if (timeConfigured) {
         time_t now = time(nullptr);
         struct tm* timeinfo = localtime(&now);
-        char timestamp[32];
-        strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", timeinfo);
-        return String(timestamp);
+        strftime(out, len, "%Y-%m-%d %H:%M:%S", timeinfo);
     } else {
         // Use boot time + elapsed time
         unsigned long elapsed = millis() - bootTime;
@@ -258,61 +369,121 @@ String getTimestamp() {
         unsigned long minutes = seconds / 60;
         unsigned long hours = minutes / 60;
         
-        char timestamp[32];
-        sprintf(timestamp, "Boot+%02lu:%02lu:%02lu", hours, minutes % 60, seconds % 60);
-        return String(timestamp);
-    }
-}
-
-void readPMSData() {
-    switch (pms.read()) {
-        case pms.OK:
-            latestPM1_0 = pms.pm01;
-            latestPM2_5 = pms.pm25;
-            latestPM10_0 = pms.pm10;
-            hasPMSData = true;
-            break;
-        case pms.ERROR_TIMEOUT:
-            Serial.println("PMS7003: Timeout error");
-            break;
-        case pms.ERROR_MSG_HEADER:
-            Serial.println("PMS7003: Invalid header");
-            break;
-        case pms.ERROR_MSG_CKSUM:
-            Serial.println("PMS7003: Checksum error");
-            break;
-        default:
-            Serial.println("PMS7003: Unknown error");
-            break;
+        snprintf(out, len, "Boot+%02lu:%02lu:%02lu", hours, minutes % 60, seconds % 60);
     }
 }
 
+String getTimestamp() {
+    char timestamp[32];
+    formatTimestamp(timestamp, sizeof(timestamp));
+    return String(timestamp);
+}
+
+void readPMSData(SensorChannel& ch) {
+    PERF_SCOPE(PERF_PMS_READ);
+    // Frames are parsed in the background; this only collects the interval
+    PmsInterval interval = ch.pms.takeInterval();
+
+    // Frames during fan spin-up are discarded; PM stays NAN in the readings
+    if ((long)(millis() - ch.pmsWarmupUntil) < 0) return;
+
+    ChannelCounters& counters = deviceCounters.channel[ch.index];
+    counters.pmsIntervals++;
+    counters.pmsChecksumErrors += interval.checksumErrors;
+    counters.pmsSyncErrors += interval.syncErrors;
+    if (interval.frames == 0) counters.pmsEmptyIntervals++;
+
+    if (interval.checksumErrors > 0) {
+        Serial.printf("PMS7003 %s: %u checksum errors\n", ch.config.name, interval.checksumErrors);
+    }
+    if (interval.frames == 0) {
+        Serial.printf("PMS7003 %s: %s\n", ch.config.name,
+                      ch.pms.hasFrame() ? "No frames this interval" : "Timeout error");
+        return;
+    }
+
+    // Interval mean, so spike detection sees the whole 10 s and not one frame
+    ch.staging.sample.pm1_0 = interval.mean[PMS_PM1_0];
+    ch.staging.sample.pm2_5 = interval.mean[PMS_PM2_5];
+    ch.staging.sample.pm10_0 = interval.mean[PMS_PM10_0];
+    ch.staging.sample.timestampMs = millis();
+    if (!ch.hasPMSData) {
+        Serial.printf("✅ PMS7003 %s warmed up, PM data valid\n", ch.config.name);
+    }
+    ch.hasPMSData = true;
+    ch.latest.publish(ch.staging);
+}
+
+// One line of min/mean/max for the fields the report cares about
+static void printRollupSummary(const char* sensor, const char* span, const RollupSummary& r) {
+    Serial.printf("   [%s] %s: IAQ %.0f/%.1f/%.0f, VOC %.2f/%.3f/%.2fppm, CO2 %.0f/%.0f/%.0fppm",
+                  sensor, span, r.minimum.iaq, r.mean.iaq, r.maximum.iaq,
+                  r.minimum.voc, r.mean.voc, r.maximum.voc, r.minimum.co2, r.mean.co2, r.maximum.co2);
+    if (!isnan(r.mean.pm2_5)) {
+        Serial.printf(", PM2.5 %.0f/%.1f/%.0fµg/m³", r.minimum.pm2_5, r.mean.pm2_5, r.maximum.pm2_5);
+    }
+    Serial.printf(" (%lu readings, %.1f%% in spike)\n",
+                  (unsigned long)r.samples, r.samples ? 100.0f * r.spikeSamples / r.samples : 0.0f);
+}
+
 void printSpikeHistory() {
-    Serial.println("\n=== SPIKE HISTORY ===");
-    for (int i = 0; i < min(10, totalSpikesDetected); i++) {
-        int idx = (spikeHistoryIndex - 1 - i + 10) % 10;
-        if (completedSpikes[idx].endTime == 0) continue;
-        
-        unsigned long duration = completedSpikes[idx].endTime - completedSpikes[idx].startTime;
-        Serial.printf("%d. %s - Duration: %.1fs\n", 
-                      i+1, 
-                      completedSpikes[idx].signature.c_str(), 
-                      duration / 1000.0);
+    Serial.printf("\n=== SPIKE HISTORY (%lu stored) ===\n", (unsigned long)spikeStore.size());
+    uint32_t shown = 0;
+    for (uint32_t id = spikeStore.nextId(); id > spikeStore.firstId() && shown < 10; shown++) {
+        const SpikeRecord* spike = spikeStore.get(--id);
+
+        PollutionDetector::DetectionResult detection;
+        SpikeStore::toDetection(*spike, detection);
+        char signature[PollutionDetector::SIGNATURE_TEXT_MAX];
+        PollutionDetector::formatSignature(detection, signature, sizeof(signature));
+        Serial.printf("%lu. [%s] %s - Duration: %.1fs\n", 
+                      (unsigned long)shown + 1, 
+                      CHANNEL_CONFIGS[SpikeStore::channelOf(*spike) % SENSOR_CHANNELS].name,
+                      signature, 
+                      spike->durationMs / 1000.0);
         Serial.printf("   Peak - IAQ: %.1f, VOC: %.3fppm, CO2: %.0fppm, RawGas: %.0fΩ",
-                     completedSpikes[idx].maxIaq,
-                     completedSpikes[idx].maxVoc,
-                     completedSpikes[idx].maxCo2,
-                     completedSpikes[idx].maxRawGas);
-        if (!isnan(completedSpikes[idx].maxPm25)) {
-            Serial.printf(", PM2.5: %.1fµg/m³", completedSpikes[idx].maxPm25);
+                     dequantizeU16(spike->maxIaq, 10.0f),
+                     dequantizeU32(spike->maxVoc, 1000000.0),
+                     dequantizeU16(spike->maxCo2, 1.0f),
+                     dequantizeU32(spike->maxRawGas, 10.0));
+        if (spike->maxPm25 != 0xFFFF) {
+            Serial.printf(", PM2.5: %.1fµg/m³", dequantizeU16(spike->maxPm25, 10.0f));
         }
         Serial.println();
     }
+
+    // Per-signature counts: last 24 h from the signature chains, last hour from the hourly index
+    uint32_t now = clockSeconds();
+    uint32_t dayAgo = now > 86400 ? now - 86400 : 0;
+    for (int sig = 0; sig < SIG_COUNT; sig++) {
+        uint32_t day = spikeStore.countSince(sig, dayAgo);
+        if (day == 0) continue;
+        Serial.printf("   %s: %lu in 24h, %u this hour\n",
+                      PollutionDetector::signatureName((SignatureId)sig),
+                      (unsigned long)day,
+                      spikeStore.hourlyCount(now / 3600, sig));
+    }
+
+    // Long-horizon view from the hourly rollups (min/mean/max)
+    Serial.println("=== AIR QUALITY (min/mean/max) ===");
+    uint32_t weekAgo = now > 7 * 86400 ? now - 7 * 86400 : 0;
+    for (const SensorChannel& ch : channels) {
+        if (!ch.present) continue;
+        RollupSummary summary;
+        if (rollupStore.summarize(ROLLUP_HOUR, ch.index, dayAgo, UINT32_MAX, summary)) {
+            printRollupSummary(ch.config.name, "24h", summary);
+        }
+        if (rollupStore.summarize(ROLLUP_HOUR, ch.index, weekAgo, UINT32_MAX, summary)) {
+            printRollupSummary(ch.config.name, "7d", summary);
+        }
+    }
 }
 
 void setup() {
     Serial.begin(115200);
-    delay(3000);
+    while (!Serial && millis() < SERIAL_ATTACH_TIMEOUT) {
+        delay(10);
+    }
 
     // Initialize pins
     pinMode(LED_PIN, OUTPUT);
@@ -323,6 +494,68 @@ void setup() {
     Serial.println("Location: Kolkata, India");
     Serial.println("=====================================");
 
+    // Binary sample log; CSV on Serial stays the live view
+    if (sampleLog.begin()) {
+        Serial.printf("✅ Sample log ready (%s, next page %lu)\n",
+                      sampleLog.flashReady() ? "flash" : "RAM only",
+                      (unsigned long)sampleLog.nextSequence());
+    } else {
+        Serial.println("⚠️ Sample log disabled: no memory for page ring");
+    }
+    if (spikeStore.begin(sampleLog.flashReady())) {
+        Serial.printf("✅ Spike store ready (%lu events reloaded)\n", (unsigned long)spikeStore.size());
+    } else {
+        Serial.println("⚠️ Spike history disabled: no memory for event store");
+    }
+    if (rollupStore.begin(sampleLog.flashReady())) {
+        Serial.printf("✅ Rollups ready (%lu minutes, %lu hours reloaded)\n",
+                      (unsigned long)(rollupStore.nextId(ROLLUP_MINUTE) - rollupStore.firstId(ROLLUP_MINUTE)),
+                      (unsigned long)(rollupStore.nextId(ROLLUP_HOUR) - rollupStore.firstId(ROLLUP_HOUR)));
+    } else {
+        Serial.println("⚠️ Rollups disabled: no memory for rollup rings");
+    }
+    storeClockBase = max(spikeStore.latestTime(), rollupStore.latestTime());
+
+    // Detection can't run without the built-in table or the baseline windows.
+    // The table comes first so a detector failure below is its windows.
+    if (!PollutionSignatures::begin()) {
+        Serial.println("❌ No memory for the built-in signature table");
+        errLeds();
+    }
+    for (SensorChannel& ch : channels) {
+        if (!ch.detector.begin()) {
+            Serial.printf("❌ Detector %s: no memory for baseline windows\n", ch.config.name);
+            errLeds();
+        }
+    }
+
+    // Warm restart: reuse the saved baseline windows if there are enough
+    for (SensorChannel& ch : channels) {
+        if (restoreBaseline(ch)) {
+            Serial.printf("✅ Baseline %s restored (%d samples)\n", ch.config.name,
+                          ch.detector.baseline().windowCount(BASELINE_IAQ));
+        }
+    }
+
+#ifdef DETECTOR_SELF_CHECK
+    // Debug builds: prove the optimized detector still matches the reference
+    unsigned long selfCheckStart = millis();
+    long divergence = detectorSelfCheck(channels[0].detector, esp_random(), DETECTOR_SELF_CHECK_SAMPLES, Serial);
+    if (divergence < 0) {
+        Serial.printf("✅ Detector self-check passed (%lu samples, %lu ms)\n",
+                      (unsigned long)DETECTOR_SELF_CHECK_SAMPLES, millis() - selfCheckStart);
+    }
+#endif
+
+    // After the self-check, which covers the built-in table only
+    if (signatureStore.begin(rulesKey)) {
+        Serial.printf("✅ Signature table v%lu active (%d rows, %s)\n",
+                      (unsigned long)signatureStore.activeVersion(), signatureStore.activeRows(),
+                      signatureStore.activeSlot() < 0 ? "built-in" : "pushed");
+    } else {
+        Serial.println("ℹ️ No rules partition, built-in signature table only");
+    }
+
     // Setup WiFi and time (optional)
     setupWiFiAndTime();
 
@@ -331,65 +564,37 @@ void setup() {
     Wire.setClock(400000); // 400kHz for faster I2C
     delay(100);
 
-    // Initialize PMS7003 sensor
-    Serial.println("Initializing PMS7003 sensor...");
-    Serial2.begin(9600, SERIAL_8N1, PMS_RX_PIN, PMS_TX_PIN);
-    pms.init();
-    
-    Serial.println("Warming up PMS7003...");
-    for (int i = 30; i > 0; i--) {
-        Serial.printf("%ds remaining...\n", i);
-        delay(1000);
+    // One channel per BME688 that answers; each brings its PMS7003 up too
+    for (SensorChannel& ch : channels) {
+        if (!testI2CConnection(ch.config.i2cAddress)) continue;
+        Serial.printf("✅ Sensor %s: BME688 at 0x%02X\n", ch.config.name, ch.config.i2cAddress);
+        if (beginChannel(ch)) channelsPresent++;
     }
-    Serial.println("✅ PMS7003 initialized!");
-
-    scanI2CDevices();
 
-    // Find BME688 sensor
-    uint8_t bme_addr;
-    bool sensorFound = false;
-    
-    if (testI2CConnection(BME68X_I2C_ADDR_HIGH)) {
-        bme_addr = BME68X_I2C_ADDR_HIGH;
-        sensorFound = true;
-        Serial.println("✅ Using BME688 at address 0x77");
-    } else if (testI2CConnection(BME68X_I2C_ADDR_LOW)) {
-        bme_addr = BME68X_I2C_ADDR_LOW;
-        sensorFound = true;
-        Serial.println("✅ Using BME688 at address 0x76");
-    }
-
-    if (!sensorFound) {
+    if (channelsPresent == 0) {
         Serial.println("❌ BME688 sensor not found!");
+        scanI2CDevices(); // Full bus scan only to diagnose a missing sensor
         errLeds();
     }
 
-    // Initialize BSEC2
-    static uint8_t sensor_addr = bme_addr;
-    
-    Serial.println("Initializing BSEC2 library...");
-    if (!iaqSensor.begin(BME68X_I2C_INTF, i2c_read, i2c_write, delay_us, &sensor_addr)) {
-        Serial.println("❌ BSEC2 sensor initialization failed!");
-        checkBsecStatus(iaqSensor);
-        errLeds();
-    }
-
-    Serial.println("✅ BSEC2 sensor initialized!");
-    
     // Configure for faster sample rate
     Serial.println("Configuring for optimized 10-second readings...");
     
     // Use LP (Low Power) mode with custom sample rate for balance between speed and accuracy
-    float sampleRate = BSEC_SAMPLE_RATE_LP; // 3 seconds internal sampling
-    
-    if (iaqSensor.updateSubscription(sensorList, NUM_OUTPUTS, sampleRate)) {
+    if (applySamplingMode(SAMPLING_STANDARD)) {
         Serial.println("✅ 10-second sensor configuration successful!");
     } else {
         Serial.println("❌ Optimized configuration failed, trying fallback...");
-        checkBsecStatus(iaqSensor);
         
         // Fallback to ULP mode
-        if (iaqSensor.updateSubscription(sensorList, NUM_OUTPUTS, BSEC_SAMPLE_RATE_ULP)) {
+        bool fallback = true;
+        for (SensorChannel& ch : channels) {
+            if (!ch.present) continue;
+            checkBsecStatus(ch.bsec);
+            fallback = ch.bsec.updateSubscription(sensorList, NUM_OUTPUTS, BSEC_SAMPLE_RATE_ULP) && fallback;
+        }
+        if (fallback) {
+            bsecSamplePeriod = (unsigned long)(1000.0f / BSEC_SAMPLE_RATE_ULP);
             Serial.println("✅ Fallback ULP configuration successful!");
         } else {
             Serial.println("❌ All configurations failed!");
@@ -397,284 +602,705 @@ void setup() {
         }
     }
 
-    // Attach callback
-    iaqSensor.attachCallback(newDataCallback);
-
     Serial.println("✅ BSEC2 sensor fully configured!");
     Serial.println("🔥 Building baseline... (10 clean air samples needed)");
     
-    // Initialize baseline arrays
-    for (int i = 0; i < BASELINE_SAMPLES; i++) {
-        iaqBaseline[i] = 0;
-        vocBaseline[i] = 0;
-        co2Baseline[i] = 0;
-    }
-
     // Print available pollution signatures with VOC details
     Serial.println("\n🔍 Available Pollution Signatures (VOC in ppm):");
-    for (int i = 0; i < PollutionSignatures::getNumSignatures(); i++) {
-        const PollutionPattern* pattern = &PollutionSignatures::getSignatures()[i];
-        Serial.printf("  %d. %s - VOC: %.1f-%.1f ppm - %s\n", 
-                     i+1, 
-                     pattern->name.c_str(), 
-                     pattern->minVOC, 
-                     pattern->maxVOC,
-                     pattern->description.c_str());
+    {
+        SignatureLease table;
+        for (int i = 0; i < table->numPatterns; i++) {
+            const PollutionPattern* pattern = &table->patterns[i];
+            Serial.printf("  %d. %s - VOC: %.1f-%.1f ppm - %s\n", 
+                         i+1, 
+                         pattern->name, 
+                         pattern->range[AXIS_VOC].min, 
+                         pattern->range[AXIS_VOC].max,
+                         pattern->description);
+        }
     }
 
     // CSV header - updated with raw_gas_ohms
-    Serial.println("\ntimestamp,temp_c,humidity_%,pressure_hpa,iaq,co2_ppm,voc_ppm,raw_gas_ohms,pm1_0,pm2_5,pm10_0,baseline_ready,spike_detected,signature,spike_duration_sec,total_spikes");
+    Serial.println("\ntimestamp,temp_c,humidity_%,pressure_hpa,iaq,co2_ppm,voc_ppm,raw_gas_ohms,pm1_0,pm2_5,pm10_0,baseline_ready,spike_detected,signature,spike_duration_sec,total_spikes,sensor");
     
     startTime = millis();
-    lastReadingTime = startTime;
-    lastBsecCall = startTime;
+    staggerChannels(startTime);
+
+    // Analysis first so its handle is valid before the first push
+    xTaskCreatePinnedToCore(analysisTask, "analysis", ANALYSIS_STACK, NULL,
+                            ANALYSIS_PRIORITY, &analysisTaskHandle, ANALYSIS_CORE);
+    xTaskCreatePinnedToCore(acquisitionTask, "acquisition", ACQUISITION_STACK, NULL,
+                            ACQUISITION_PRIORITY, &acquisitionTaskHandle, ACQUISITION_CORE);
+
+    if (sampleLog.ready() && logExport.begin()) {
+        if (signatureStore.ready()) logExport.attachSignatures(&signatureStore);
+        logExport.attachMetrics(collectMetrics);
+        if (rollupStore.ready()) logExport.attachRollups(&rollupStore);
+        xTaskCreatePinnedToCore(exportTask, "export", EXPORT_STACK, NULL,
+                                EXPORT_PRIORITY, &exportTaskHandle, ANALYSIS_CORE);
+        Serial.printf("📡 Log export: GET /log, /rollups and /metrics on port %u%s\n", LogExportServer::DEFAULT_PORT,
+                      signatureStore.ready() ? ", signature tables: PUT /rules" : "");
+    }
+
+    if (mqttPublisher.begin(mqttHost, MQTT_PORT, MQTT_TOPIC_PREFIX)) {
+        xTaskCreatePinnedToCore(mqttTask, "mqtt", MQTT_STACK, NULL,
+                                MQTT_PRIORITY, &mqttTaskHandle, ANALYSIS_CORE);
+        Serial.printf("📡 MQTT upload to %s:%u, %u-record batches\n", mqttHost, MQTT_PORT,
+                      MqttPublisher::BATCH_RECORDS);
+    }
 }
 
-void loop() {
-    unsigned long currentTime = millis();
+// BSEC2 and PMS7003 bring-up for one channel whose BME688 answered
+bool beginChannel(SensorChannel& ch) {
+    Serial.printf("Initializing BSEC2 library for sensor %s...\n", ch.config.name);
+    if (!ch.bsec.begin(BME68X_I2C_INTF, i2c_read, i2c_write, delay_us, &ch.i2cAddress)) {
+        Serial.printf("❌ BSEC2 initialization failed for sensor %s!\n", ch.config.name);
+        checkBsecStatus(ch.bsec);
+        return false;
+    }
+    Serial.println("✅ BSEC2 sensor initialized!");
 
-    static unsigned long lastHistoryPrint = 0;
-    if (millis() - lastHistoryPrint > 3600000) { // Every hour
-        printSpikeHistory();
-        lastHistoryPrint = millis();
+    // Resume the previous calibration instead of starting from scratch
+    if (restoreBsecState(ch)) {
+        Serial.println("✅ BSEC2 calibration state restored from NVS");
+    } else {
+        Serial.println("ℹ️ No saved BSEC2 state, calibrating from scratch");
     }
-    
-    // Call BSEC run() every second to ensure it processes data
-    if (currentTime - lastBsecCall >= BSEC_CALL_INTERVAL) {
-        if (!iaqSensor.run()) {
-            checkBsecStatus(iaqSensor);
+    ch.bsec.attachCallback(newDataCallback);
+
+    ch.pms.begin(ch.config.pmsRxPin, ch.config.pmsTxPin);
+    ch.pmsWarmupUntil = millis() + PMS_WARMUP_TIME;
+    Serial.printf("✅ PMS7003 %s initialized! PM data valid in %lus\n", ch.config.name, PMS_WARMUP_TIME / 1000);
+
+    ch.present = true;
+    return true;
+}
+
+// Spread the channels over one BSEC period and one reading interval, so
+// heater cycles, I2C bursts and queue pushes never land together
+void staggerChannels(unsigned long now) {
+    int slot = 0;
+    for (SensorChannel& ch : channels) {
+        if (!ch.present) continue;
+        ch.nextBsecCall = now + slot * bsecSamplePeriod / channelsPresent;
+        ch.lastReadingTime = now + slot * READING_INTERVAL / channelsPresent;
+        slot++;
+    }
+}
+
+// Next LED transition for the current blink pattern
+unsigned long nextLedEdge(unsigned long currentTime) {
+    bool anySpike = false, anyBuilding = false;
+    for (const SensorChannel& ch : channels) {
+        anySpike = anySpike || ch.inSpike;
+        anyBuilding = anyBuilding || (ch.present && !ch.baselineReady);
+    }
+
+    unsigned long period, onTime;
+    if (anySpike) {
+        period = 200; onTime = 100;   // Fast blink during spike
+    } else if (anyBuilding) {
+        period = 2000; onTime = 100;  // Slow blink while baseline builds
+    } else {
+        period = 5000; onTime = 50;   // Quick flash every 5 seconds
+    }
+    unsigned long phase = currentTime % period;
+    digitalWrite(LED_PIN, phase < onTime);
+    return currentTime + (phase < onTime ? onTime - phase : period - phase);
+}
+
+// Block until the deadline; light-sleep when enabled and worthwhile
+void sleepUntil(unsigned long deadline) {
+    long remaining = (long)(deadline - millis());
+    if (remaining <= 0) return;
+#ifdef LIGHT_SLEEP_ENABLED
+    if (remaining >= LIGHT_SLEEP_MIN_MS) {
+        Serial.flush();
+        esp_sleep_enable_timer_wakeup((uint64_t)remaining * 1000ULL);
+        esp_light_sleep_start();
+        return;
+    }
+#endif
+    delay(remaining);
+}
+
+static bool isDue(unsigned long deadline, unsigned long now) {
+    return (long)(now - deadline) >= 0;
+}
+
+// Core ACQUISITION_CORE: BSEC2 timing, PMS reads and the status LED
+void acquisitionTask(void* param) {
+    for (;;) {
+        unsigned long currentTime = millis();
+        unsigned long loopStart = micros();
+
+        bool everyCallback = SAMPLING_PROFILES[samplingMode].everyCallback;
+
+        for (SensorChannel& ch : channels) {
+            if (!ch.present) continue;
+
+            // Run BSEC when its next sample is due; poll briefly if we woke early
+            if (isDue(ch.nextBsecCall, currentTime)) {
+                ChannelCounters& counters = deviceCounters.channel[ch.index];
+                ch.bsecDataReady = false;
+                bool ran;
+                runningChannel = &ch;   // newDataCallback() fires inside run()
+                {
+                    PERF_SCOPE(PERF_BSEC_RUN);
+                    ran = ch.bsec.run();
+                }
+                runningChannel = nullptr;
+                counters.bsecStatus = ch.bsec.status;
+                counters.bme68xStatus = ch.bsec.sensor.status;
+                if (!ran) {
+                    counters.bsecRunErrors++;
+                    checkBsecStatus(ch.bsec);
+                }
+                ch.nextBsecCall = currentTime + (ch.bsecDataReady ? bsecSamplePeriod : BSEC_RETRY_INTERVAL);
+
+                // High-rate modes: every new BSEC output is a reading
+                if (everyCallback && ch.bsecDataReady && ch.hasValidData) {
+                    outputReading(ch);
+                    ch.lastReadingTime = currentTime;
+                }
+            }
+
+            // Check if it's time for the next reading (10 second interval)
+            if (!everyCallback && ch.hasValidData && isDue(ch.lastReadingTime + READING_INTERVAL, currentTime)) {
+                outputReading(ch);
+                ch.lastReadingTime = currentTime;
+            }
         }
-        lastBsecCall = currentTime;
+
+        handleSerialCommands();
+        for (SensorChannel& ch : channels) {
+            if (ch.present) saveBsecStateIfDue(ch, currentTime);
+        }
+
+        // LED status indication, then sleep until the earliest deadline
+        unsigned long deadline = nextLedEdge(millis());
+        deviceCounters.loopLastUs = micros() - loopStart;
+        deviceCounters.loopMaxUs = max(deviceCounters.loopMaxUs, deviceCounters.loopLastUs);
+        for (const SensorChannel& ch : channels) {
+            if (!ch.present) continue;
+            if ((long)(ch.nextBsecCall - deadline) < 0) deadline = ch.nextBsecCall;
+            if (!everyCallback && ch.hasValidData && (long)(ch.lastReadingTime + READING_INTERVAL - deadline) < 0) {
+                deadline = ch.lastReadingTime + READING_INTERVAL;
+            }
+        }
+        sleepUntil(deadline);
     }
-    
-    // Check if it's time for the next reading (10 second interval)
-    if (hasValidData && (currentTime - lastReadingTime >= READING_INTERVAL)) {
-        outputReading();
-        lastReadingTime = currentTime;
+}
+
+// Resubscribe every channel's BSEC at the mode's rate; keeps the current
+// mode on all of them if any fails
+bool applySamplingMode(SamplingMode mode) {
+    const SamplingProfile& profile = SAMPLING_PROFILES[mode];
+    for (SensorChannel& ch : channels) {
+        if (!ch.present || ch.bsec.updateSubscription(sensorList, NUM_OUTPUTS, profile.bsecRate)) continue;
+
+        Serial.printf("❌ Sampling mode '%s' not supported by this BSEC config\n", profile.name);
+        checkBsecStatus(ch.bsec);
+        if (mode != samplingMode) {
+            for (SensorChannel& other : channels) {
+                if (other.present) other.bsec.updateSubscription(sensorList, NUM_OUTPUTS, SAMPLING_PROFILES[samplingMode].bsecRate);
+            }
+        }
+        return false;
     }
-    
-    // LED status indication
-    if (inSpike) {
-        // Fast blink during spike
-        digitalWrite(LED_PIN, currentTime % 200 < 100);
+
+    samplingMode = mode;
+    bsecSamplePeriod = (unsigned long)(1000.0f / profile.bsecRate);
+    staggerChannels(millis());
+    return true;
+}
+
+// Line commands on Serial, polled from the acquisition loop (never blocks)
+void handleSerialCommands() {
+    static char line[SERIAL_COMMAND_MAX];
+    static size_t length = 0;
+
+    while (Serial.available() > 0) {
+        int c = Serial.read();
+        if (c == '\r') continue;
+        if (c != '\n') {
+            if (length < sizeof(line) - 1) line[length++] = (char)c;
+            continue;
+        }
+        line[length] = '\0';
+        length = 0;
+
+        if (strncmp(line, "rate ", 5) == 0) {
+            for (int m = 0; m < SAMPLING_MODES; m++) {
+                if (strcmp(line + 5, SAMPLING_PROFILES[m].name) != 0) continue;
+                if (applySamplingMode((SamplingMode)m)) {
+                    Serial.printf("✅ Sampling mode '%s' (BSEC every %lu ms, %s)\n",
+                                  SAMPLING_PROFILES[m].name, bsecSamplePeriod,
+                                  SAMPLING_PROFILES[m].everyCallback ? "every callback" : "10 s readings");
+                }
+                break;
+            }
+        } else if (strncmp(line, "csv ", 4) == 0) {
+            csvInterval = strtoul(line + 4, nullptr, 10) * 1000UL;
+            Serial.printf("✅ CSV row every %lu ms (spikes always printed)\n", csvInterval);
+        } else if (strcmp(line, "rules reset") == 0) {
+            // Without the export task nothing else touches the store
+            if (exportTaskHandle != NULL) rulesResetRequested = true;
+            else resetSignatureTables();
+        } else if (line[0] != '\0') {
+            Serial.println("Commands: rate std|lp|cont|scan, csv <seconds>, rules reset");
+        }
+    }
+}
+
+// Core ANALYSIS_CORE: detection, spike tracking and all CSV/report output
+void analysisTask(void* param) {
+    unsigned long nextHistoryPrint = millis() + HISTORY_PRINT_INTERVAL;
+    AcquiredReading reading;
+
+    for (;;) {
+        // Woken by the acquisition task after each push
+        long untilHistory = (long)(nextHistoryPrint - millis());
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(untilHistory > 0 ? untilHistory : 0));
+
+        while (sampleQueue.pop(reading)) {
+            unsigned long start = micros();
+            processReading(reading);
+            deviceCounters.analysisLastUs = micros() - start;
+            deviceCounters.analysisMaxUs = max(deviceCounters.analysisMaxUs, deviceCounters.analysisLastUs);
+        }
+        sampleLog.flush(); // Only writes when a page has filled
+
+        for (SensorChannel& ch : channels) saveBaselineIfDue(ch, millis());
+
+        if (isDue(nextHistoryPrint, millis())) { // Every hour
+            printSpikeHistory();
+            PERF_REPORT(Serial);
+            nextHistoryPrint = millis() + HISTORY_PRINT_INTERVAL;
+        }
+    }
+}
+
+// "rules reset": back to the built-in table. Export task, which owns the store.
+void resetSignatureTables() {
+    SignatureStore::UpdateResult result = signatureStore.reset();
+    if (result == SignatureStore::UPDATE_OK) {
+        Serial.printf("✅ Pushed signature tables erased, built-in table v%lu active\n",
+                      (unsigned long)signatureStore.activeVersion());
     } else {
-        // Slow blink if baseline not ready, heartbeat if ready
-        if (!baselineReady) {
-            digitalWrite(LED_PIN, currentTime % 2000 < 100);
-        } else {
-            digitalWrite(LED_PIN, currentTime % 5000 < 50); // Quick flash every 5 seconds
+        Serial.printf("❌ Signature table reset failed: %s\n", SignatureStore::resultName(result));
+    }
+}
+
+// Core ANALYSIS_CORE, lowest priority: serves log downloads over WiFi
+void exportTask(void* param) {
+    for (;;) {
+        // Store updates belong to this task, so the serial command lands here
+        if (rulesResetRequested) {
+            rulesResetRequested = false;
+            resetSignatureTables();
         }
+        logExport.poll();
+        vTaskDelay(pdMS_TO_TICKS(EXPORT_POLL_INTERVAL));
     }
-    
-    delay(50); // Reduced delay for more responsive operation
 }
 
-void outputReading() {
-    if (!hasValidData) return;
+// Core ANALYSIS_CORE, lowest priority: MQTT connects, backlog drain, live batches
+void mqttTask(void* param) {
+    for (;;) {
+        unsigned long wait = mqttPublisher.poll();
+        vTaskDelay(pdMS_TO_TICKS(wait));
+    }
+}
+
+// Export task, once per scrape: reads only published or single-writer state
+void collectMetrics(MetricsSnapshot& m) {
+    unsigned long now = millis();
+    m.uptimeMs = now - startTime;
+    for (const SensorChannel& ch : channels) {
+        ChannelSnapshot& c = m.channel[ch.index];
+        c.name = ch.config.name;
+        c.present = ch.present;
+        c.hasSample = ch.hasValidData;
+        c.sample = ch.latest.read().sample;
+        c.sampleAgeMs = c.hasSample ? now - c.sample.timestampMs : 0;
+        c.baselineReady = ch.baselineReady;
+        c.inSpike = ch.inSpike;
+        c.totalSpikes = ch.totalSpikes;
+        c.bsecIaqAccuracy = ch.iaqAccuracy;
+    }
+    m.signatureTableVersion = signatureStore.activeVersion();
+    m.counters = deviceCounters;
+
+    m.heapFree = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    m.heapMinFree = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    m.heapLargestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    m.psramFree = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    m.psramMinFree = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+
+    const TaskHandle_t tasks[METRICS_TASK_COUNT] = { acquisitionTaskHandle, analysisTaskHandle,
+                                                     exportTaskHandle, mqttTaskHandle };
+    for (int i = 0; i < METRICS_TASK_COUNT; i++) {
+        m.stackFree[i] = tasks[i] ? uxTaskGetStackHighWaterMark(tasks[i]) : 0;   // Bytes on ESP-IDF
+    }
+
+    m.mqttConnected = mqttPublisher.connected();
+    m.mqttBatches = mqttPublisher.batchesPublished();
+    m.mqttRecords = mqttPublisher.recordsPublished();
+    m.mqttPagesSkipped = mqttPublisher.pagesSkipped();
+}
+
+void loop() {
+    // All work happens in the pinned tasks started from setup()
+    vTaskDelete(NULL);
+}
+
+// Acquisition side: snapshot the channel's latest readings and hand them to analysis
+void outputReading(SensorChannel& ch) {
+    if (!ch.hasValidData) return;
     
     // Read PMS data
-    readPMSData();
+    readPMSData(ch);
     
-    // Update baseline and detect spikes
-    updateBaseline(latestIaq, latestVoc, latestCo2);
-    bool currentSpikeDetected = detectSpike(latestIaq, latestVoc, latestCo2);
-    
-    // Detect pollution signature - UPDATED to include rawGas parameter
-auto detection = pollutionDetector.detect(
-    latestIaq, latestVoc, latestCo2, latestTemp, latestHumidity, 
-    latestRawGas, inSpike, latestPM1_0, latestPM2_5, latestPM10_0
-);
+    AcquiredReading reading = ch.latest.read();
+    reading.sample.timestampMs = millis();
+
+    if (!sampleQueue.push(reading)) {
+        deviceCounters.readingsDropped++;
+    } else if (analysisTaskHandle != NULL) {
+        xTaskNotifyGive(analysisTaskHandle);
+    }
+}
+
+// Analysis side: baseline, spike state machine, detection and CSV output
+void processReading(const AcquiredReading& reading) {
+    syncStoreClock();
+    SensorChannel& ch = channels[reading.channel];
+    const SensorSample& sample = reading.sample;
+    unsigned long now = sample.timestampMs;
+
+    // Score spikes against this sensor's baseline, then let the baseline
+    // take the reading unless the spike state holds it; then signatures
+    SpikeTracker::Transition transition;
+    {
+        PERF_SCOPE(PERF_BASELINE_SPIKE);
+        transition = detectSpike(ch, sample);
+        updateBaseline(ch, sample);
+    }
+    PollutionDetector::DetectionResult detection;
+    {
+        PERF_SCOPE(PERF_DETECT);
+        detection = ch.detector.detect(sample, ch.inSpike);
+    }
+    PERF_SAMPLE_HEAP();
+    deviceCounters.readings++;
+    if (detection.signature < SIG_COUNT) deviceCounters.signatureHits[detection.signature]++;
+    if (detection.isThreat) deviceCounters.threats++;
+#ifdef DETECTOR_SELF_CHECK
+    // The reference only describes the built-in table
+    static unsigned long detectorDivergences = 0;
+    if (signatureStore.activeSlot() < 0 && !checkDetection(ch.detector, sample, ch.inSpike, &detection, Serial)) {
+        Serial.printf("   live sample, %lu divergences so far\n", ++detectorDivergences);
+    }
+#endif
 
-    String signature = detection.signature;
+    char signature[PollutionDetector::SIGNATURE_TEXT_MAX];
+    PollutionDetector::formatSignature(detection, signature, sizeof(signature));
     
-    // Handle spike detection logic
-    if (currentSpikeDetected && !inSpike) {
+    // Handle spike state transitions
+    if (transition == SpikeTracker::STARTED) {
         // New spike starting
-        inSpike = true;
-        spikeStartTime = millis();
-        currentSpike.startTime = spikeStartTime;
-        currentSpike.signature = signature;
-        currentSpike.maxIaq = latestIaq;
-        currentSpike.maxVoc = latestVoc;
-        currentSpike.maxCo2 = latestCo2;
-        currentSpike.maxPm25 = latestPM2_5;
-        currentSpike.maxRawGas = latestRawGas;  // Track raw gas max
-        currentSpike.endTime = 0; // Reset end time
+        ch.currentSpike.startTime = ch.spike.startTime();
+        ch.currentSpike.channel = ch.index;
+        ch.currentSpike.detection = detection;
+        ch.currentSpike.maxIaq = sample.iaq;
+        ch.currentSpike.maxVoc = sample.voc;
+        ch.currentSpike.maxCo2 = sample.co2;
+        ch.currentSpike.maxPm25 = sample.pm2_5;
+        ch.currentSpike.maxRawGas = sample.rawGas;  // Track raw gas max
+        ch.currentSpike.endTime = 0; // Reset end time
         
-        Serial.printf("🚨 POLLUTION SPIKE DETECTED! Signature: %s\n", signature.c_str());
+        Serial.printf("🚨 POLLUTION SPIKE DETECTED on sensor %s! Signature: %s\n", ch.config.name, signature);
+        Serial.printf("   Trigger: %s at z=%.1f\n",
+                     SpikeTracker::metricName(ch.spike.trigger()), ch.spike.triggerScore());
         Serial.printf("   VOC: %.3f ppm, CO2: %.0f ppm, IAQ: %.1f, RawGas: %.0fΩ\n", 
-                     latestVoc, latestCo2, latestIaq, latestRawGas);
+                     sample.voc, sample.co2, sample.iaq, sample.rawGas);
         
-        if (hasPMSData && !isnan(latestPM2_5)) {
-            Serial.printf("   PM2.5: %.1f µg/m³\n", latestPM2_5);
+        if (!isnan(sample.pm2_5)) {
+            Serial.printf("   PM2.5: %.1f µg/m³\n", sample.pm2_5);
+        }
+
+        // Skipped if a table swap landed between capture and now
+        SignatureLease table;
+        if (reading.patternIndex >= 0 && reading.tableVersion == table->version) {
+            const PollutionPattern* pattern = &table->patterns[reading.patternIndex];
+            Serial.printf("   Pattern match: %s (%s)\n", pattern->name, pattern->description);
         }
         
-    } else if (!currentSpikeDetected && inSpike) {
-        // Spike ending
-        unsigned long duration = millis() - spikeStartTime;
-        if (duration >= MIN_SPIKE_DURATION) {
-            totalSpikesDetected++;
-            
-            // Record completed spike
-            currentSpike.endTime = millis();
-            completedSpikes[spikeHistoryIndex] = currentSpike;
-            spikeHistoryIndex = (spikeHistoryIndex + 1) % 10;
-            
-            Serial.printf("✅ Spike ended after %lu ms (Total: %d)\n", 
-                         duration, totalSpikesDetected);
-            Serial.printf("   Duration: %.1f seconds\n", duration / 1000.0);
-            Serial.printf("   Peak Values - IAQ: %.1f, VOC: %.3f ppm, CO2: %.0f ppm, RawGas: %.0fΩ",
-                         currentSpike.maxIaq, currentSpike.maxVoc, currentSpike.maxCo2, currentSpike.maxRawGas);
-            if (!isnan(currentSpike.maxPm25)) {
-                Serial.printf(", PM2.5: %.1f µg/m³", currentSpike.maxPm25);
-            }
-            Serial.println();
+    } else if (transition == SpikeTracker::RESUMED) {
+        Serial.printf("🚨 Spike on sensor %s resumed (%s at z=%.1f)\n",
+                     ch.config.name, SpikeTracker::metricName(ch.spike.trigger()), ch.spike.score());
+
+    } else if (transition == SpikeTracker::ENDED) {
+        // Cooldown over without a re-entry: the event is final
+        unsigned long duration = ch.spike.endTime() - ch.spike.startTime();
+        ch.totalSpikes++;
+        
+        // Record completed spike
+        ch.currentSpike.endTime = ch.spike.endTime();
+        spikeStore.add(ch.currentSpike, clockSeconds() - (now - ch.spike.startTime()) / 1000);
+        
+        Serial.printf("✅ Spike on sensor %s ended after %lu ms (Total: %d)\n", 
+                     ch.config.name, duration, ch.totalSpikes);
+        Serial.printf("   Duration: %.1f seconds", duration / 1000.0);
+        if (ch.spike.resumes() > 0) {
+            Serial.printf(", %lu re-entries merged", (unsigned long)ch.spike.resumes());
+        }
+        Serial.println();
+        Serial.printf("   Peak Values - IAQ: %.1f, VOC: %.3f ppm, CO2: %.0f ppm, RawGas: %.0fΩ",
+                     ch.currentSpike.maxIaq, ch.currentSpike.maxVoc, ch.currentSpike.maxCo2, ch.currentSpike.maxRawGas);
+        if (!isnan(ch.currentSpike.maxPm25)) {
+            Serial.printf(", PM2.5: %.1f µg/m³", ch.currentSpike.maxPm25);
         }
-        inSpike = false;
-    } else if (inSpike) {
+        Serial.println();
+    }
+    if (ch.inSpike && transition != SpikeTracker::STARTED) {
         // Update current spike max values
-        currentSpike.maxIaq = max(currentSpike.maxIaq, latestIaq);
-        currentSpike.maxVoc = max(currentSpike.maxVoc, latestVoc);
-        currentSpike.maxCo2 = max(currentSpike.maxCo2, latestCo2);
-        currentSpike.maxRawGas = max(currentSpike.maxRawGas, latestRawGas);  // Update raw gas max
-        if (!isnan(latestPM2_5)) {
-            currentSpike.maxPm25 = max(currentSpike.maxPm25, latestPM2_5);
+        ch.currentSpike.maxIaq = max(ch.currentSpike.maxIaq, sample.iaq);
+        ch.currentSpike.maxVoc = max(ch.currentSpike.maxVoc, sample.voc);
+        ch.currentSpike.maxCo2 = max(ch.currentSpike.maxCo2, sample.co2);
+        ch.currentSpike.maxRawGas = max(ch.currentSpike.maxRawGas, sample.rawGas);  // Update raw gas max
+        if (!isnan(sample.pm2_5)) {
+            ch.currentSpike.maxPm25 = max(ch.currentSpike.maxPm25, sample.pm2_5);
         }
     }
     
-    // CSV output with timestamp - updated to include raw gas
-    String timestamp = getTimestamp();
-    Serial.printf("%s,%.2f,%.2f,%.2f,%.2f,%.0f,%.3f,%.0f,",
-        timestamp.c_str(), latestTemp, latestHumidity, latestPressure, 
-        latestIaq, latestCo2, latestVoc, latestRawGas);
+    // Spike state transitions always get a row
+    bool spikeEdge = transition != SpikeTracker::NONE;
+    uint8_t flags = (ch.spike.over() ? SAMPLE_FLAG_SPIKE : 0)
+                  | (ch.inSpike ? SAMPLE_FLAG_IN_SPIKE : 0)
+                  | (detection.isThreat ? SAMPLE_FLAG_THREAT : 0)
+                  | (ch.baselineReady ? SAMPLE_FLAG_BASELINE_READY : 0)
+                  | sampleFlagsForChannel(ch.index);
+    sampleLog.append(sample, detection.signature, flags);
+    rollupStore.add(sample, detection.signature, flags, clockSeconds());
+
+    // Decimate at high rates; every row during a spike. Readings are stamped
+    // after BSEC and PMS work, so one due on the interval can land a few ms
+    // short of it: the slack keeps "std" at one row per reading.
+    static unsigned long lastCsvRow[SENSOR_CHANNELS] = {};
+    if (!ch.inSpike && !spikeEdge && csvInterval > 0 && lastCsvRow[ch.index] != 0 &&
+        now - lastCsvRow[ch.index] + CSV_INTERVAL_SLACK < csvInterval) {
+        return;
+    }
+    lastCsvRow[ch.index] = now;
+    PERF_SCOPE(PERF_CSV);
+
+    // CSV output with timestamp - one buffer, one write, so rows never
+    // interleave with other log lines
+    char timestamp[32];
+    formatTimestamp(timestamp, sizeof(timestamp));
+    csvLine.reset();
+    csvLine.field(timestamp);
+    csvLine.field(sample.temp, 2);
+    csvLine.field(sample.humidity, 2);
+    csvLine.field(sample.pressure, 2);
+    csvLine.field(sample.iaq, 2);
+    csvLine.field(sample.co2, 0);
+    csvLine.field(sample.voc, 3);
+    csvLine.field(sample.rawGas, 0);
     
     // Add PM data
-    if (hasPMSData && !isnan(latestPM1_0)) {
-        Serial.printf("%.1f,%.1f,%.1f,", latestPM1_0, latestPM2_5, latestPM10_0);
+    if (!isnan(sample.pm1_0)) {
+        csvLine.field(sample.pm1_0, 1);
+        csvLine.field(sample.pm2_5, 1);
+        csvLine.field(sample.pm10_0, 1);
     } else {
-        Serial.print(",,,");  // Empty PM values if no data
+        csvLine.append(",,,");  // Empty PM values if no data
     }
     
+    csvLine.field(ch.baselineReady ? "YES" : "NO");
+    csvLine.field(ch.inSpike ? "YES" : "NO");
+    csvLine.field(signature);
+    
     // Add spike duration if in spike
-    if (inSpike) {
-        unsigned long duration = millis() - spikeStartTime;
-        Serial.printf("%s,%s,%s,%.1f,%d\n",
-            baselineReady ? "YES" : "NO",
-            "YES",
-            signature.c_str(),
-            duration / 1000.0,
-            totalSpikesDetected);
+    if (ch.inSpike) {
+        csvLine.field((now - ch.spike.startTime()) / 1000.0f, 1);
     } else {
-        Serial.printf("%s,%s,%s,,%d\n",
-            baselineReady ? "YES" : "NO",
-            "NO",
-            signature.c_str(),
-            totalSpikesDetected);
+        csvLine.emptyField();
     }
+    csvLine.field((long)ch.totalSpikes);
+    csvLine.last(ch.config.name);
+    csvLine.writeTo(Serial);
 }
 
 void newDataCallback(const bme68xData data, const bsecOutputs outputs, Bsec2 bsec) {
+    PERF_SCOPE(PERF_BSEC_CALLBACK);
     if (!outputs.nOutputs) {
         return;
     }
+    SensorChannel& ch = *runningChannel;
+    ch.bsecDataReady = true;
+    SensorSample& latest = ch.staging.sample;
 
     // Extract sensor values and store as latest readings
     for (uint8_t i = 0; i < outputs.nOutputs; i++) {
         const bsecData output = outputs.output[i];
         switch (output.sensor_id) {
             case BSEC_OUTPUT_RAW_TEMPERATURE:
-                latestTemp = output.signal;
+                latest.temp = output.signal;
                 break;
             case BSEC_OUTPUT_RAW_PRESSURE:
-                latestPressure = output.signal;
+                latest.pressure = output.signal;
                 break;
             case BSEC_OUTPUT_RAW_HUMIDITY:
-                latestHumidity = output.signal;
+                latest.humidity = output.signal;
                 break;
             case BSEC_OUTPUT_RAW_GAS:  // Capture raw gas resistance
-                latestRawGas = output.signal;
+                latest.rawGas = output.signal;
                 break;
             case BSEC_OUTPUT_IAQ:
-                latestIaq = output.signal;
+                latest.iaq = output.signal;
+                ch.iaqAccuracy = output.accuracy;
                 break;
             case BSEC_OUTPUT_CO2_EQUIVALENT:
-                latestCo2 = output.signal;
+                latest.co2 = output.signal;
                 break;
             case BSEC_OUTPUT_BREATH_VOC_EQUIVALENT:
-                latestVoc = output.signal; // VOC in ppm
+                latest.voc = output.signal; // VOC in ppm
                 break;
         }
     }
 
     // Only mark as valid if we have IAQ data
-    if (!isnan(latestIaq) && latestIaq > 0) {
+    if (!isnan(latest.iaq) && latest.iaq > 0) {
         // Set default values for missing data
-        if (isnan(latestVoc)) latestVoc = 0.5;
-        if (isnan(latestCo2)) latestCo2 = 500;
-        if (isnan(latestTemp)) latestTemp = 25;
-        if (isnan(latestHumidity)) latestHumidity = 50;
-        if (isnan(latestPressure)) latestPressure = 1000;
-        if (isnan(latestRawGas)) latestRawGas = 100000;  // Default raw gas value
+        if (isnan(latest.voc)) latest.voc = 0.5;
+        if (isnan(latest.co2)) latest.co2 = 500;
+        if (isnan(latest.temp)) latest.temp = 25;
+        if (isnan(latest.humidity)) latest.humidity = 50;
+        if (isnan(latest.pressure)) latest.pressure = 1000;
+        if (isnan(latest.rawGas)) latest.rawGas = 100000;  // Default raw gas value
         
-        hasValidData = true;
+        ch.hasValidData = true;
+
+        // Full-table classification is allocation-free, so run it per callback
+        {
+            SignatureLease table;
+            ch.staging.patternIndex = table->match(latest);
+            ch.staging.tableVersion = table->version;
+        }
+        latest.timestampMs = millis();
+        ch.latest.publish(ch.staging);
         
         // For first few readings, output immediately to show progress
-        if (!baselineReady && baselineIndex < 3) {
+        int baselineCount = ch.detector.baseline().windowCount(BASELINE_IAQ);
+        if (!ch.baselineReady && baselineCount < 3) {
             String timestamp = getTimestamp();
-            Serial.printf("Initial reading %d: %s - IAQ: %.1f, VOC: %.3f ppm, CO2: %.0f ppm, RawGas: %.0fΩ\n", 
-                         baselineIndex + 1, timestamp.c_str(), latestIaq, latestVoc, latestCo2, latestRawGas);
+            Serial.printf("Initial reading %d (%s): %s - IAQ: %.1f, VOC: %.3f ppm, CO2: %.0f ppm, RawGas: %.0fΩ\n", 
+                         baselineCount + 1, ch.config.name, timestamp.c_str(), latest.iaq, latest.voc, latest.co2, latest.rawGas);
         }
     }
 }
 
-void updateBaseline(float iaq, float voc, float co2) {
-    if (!inSpike && iaq > 0 && !isnan(iaq) && !isnan(voc) && !isnan(co2)) {
-        iaqBaseline[baselineIndex] = iaq;
-        vocBaseline[baselineIndex] = voc; // Store VOC in ppm
-        co2Baseline[baselineIndex] = co2;
+void updateBaseline(SensorChannel& ch, const SensorSample& sample) {
+    ch.detector.updateBaseline(sample, ch.spike.holdsBaseline());
 
-        baselineIndex = (baselineIndex + 1) % BASELINE_SAMPLES;
+    const BaselineService& baseline = ch.detector.baseline();
+    if (!ch.baselineReady && baseline.ready()) {
+        ch.baselineReady = true;
+        Serial.printf("✅ Baseline %s established! Now monitoring for pollution spikes...\n", ch.config.name);
+        Serial.printf("📊 Baseline - IAQ: %.1f, VOC: %.3f ppm, CO2: %.0f ppm\n",
+                      baseline.windowMean(BASELINE_IAQ), baseline.windowMean(BASELINE_VOC),
+                      baseline.windowMean(BASELINE_CO2));
+    }
+}
 
-        if (!baselineReady && baselineIndex == 0) {
-            baselineReady = true;
-            Serial.println("✅ Baseline established! Now monitoring for pollution spikes...");
-            
-            float avgIAQ = 0, avgVOC = 0, avgCO2 = 0;
-            for (int i = 0; i < BASELINE_SAMPLES; i++) {
-                avgIAQ += iaqBaseline[i];
-                avgVOC += vocBaseline[i];
-                avgCO2 += co2Baseline[i];
-            }
-            Serial.printf("📊 Baseline - IAQ: %.1f, VOC: %.3f ppm, CO2: %.0f ppm\n",
-                          avgIAQ/BASELINE_SAMPLES, avgVOC/BASELINE_SAMPLES, avgCO2/BASELINE_SAMPLES);
-        }
+// ===== PERSISTENCE =====
+
+// BSEC state blobs live in NVS, one key per channel; acquisition task only
+// (owns the Bsec2 instances)
+bool restoreBsecState(SensorChannel& ch) {
+    uint8_t state[BSEC_MAX_STATE_BLOB_SIZE];
+    Preferences prefs;
+    if (!prefs.begin(BSEC_STATE_NAMESPACE, true)) return false;
+    const char* key = BSEC_STATE_KEYS[ch.index];
+    size_t length = prefs.getBytesLength(key);
+    bool loaded = length == sizeof(state) && prefs.getBytes(key, state, sizeof(state)) == sizeof(state);
+    prefs.end();
+
+    if (!loaded) return false;
+    if (!ch.bsec.setState(state)) {
+        checkBsecStatus(ch.bsec);
+        return false;
     }
+    return true;
 }
 
-bool detectSpike(float iaq, float voc, float co2) {
-    if (!baselineReady) return false;
-    
-    float avgIAQ = 0, avgVOC = 0, avgCO2 = 0;
-    for (int i = 0; i < BASELINE_SAMPLES; i++) {
-        avgIAQ += iaqBaseline[i];
-        avgVOC += vocBaseline[i]; // VOC baseline in ppm
-        avgCO2 += co2Baseline[i];
-    }
-    avgIAQ /= BASELINE_SAMPLES;
-    avgVOC /= BASELINE_SAMPLES;
-    avgCO2 /= BASELINE_SAMPLES;
-    
-    bool iaqSpike = (iaq - avgIAQ) > SPIKE_THRESHOLD_IAQ;
-    bool vocSpike = (voc - avgVOC) > SPIKE_THRESHOLD_VOC; // VOC spike detection
-    bool co2Spike = (co2 - avgCO2) > SPIKE_THRESHOLD_CO2;
-    
-    // Add PM2.5 spike detection
-    bool pm25Spike = false;
-    if (hasPMSData && !isnan(latestPM2_5)) {
-        pm25Spike = latestPM2_5 > SPIKE_THRESHOLD_PM25;
+// First save as soon as IAQ is calibrated, then every BSEC_STATE_SAVE_INTERVAL
+void saveBsecStateIfDue(SensorChannel& ch, unsigned long now) {
+    static bool saved[SENSOR_CHANNELS] = {};
+    static unsigned long lastSave[SENSOR_CHANNELS] = {};
+
+    if (ch.iaqAccuracy < BSEC_ACCURACY_CALIBRATED) return;
+    if (saved[ch.index] && now - lastSave[ch.index] < BSEC_STATE_SAVE_INTERVAL) return;
+    saved[ch.index] = true;
+    lastSave[ch.index] = now;   // Also on failure: don't retry every loop
+
+    uint8_t state[BSEC_MAX_STATE_BLOB_SIZE];
+    if (!ch.bsec.getState(state)) {
+        checkBsecStatus(ch.bsec);
+        return;
     }
-    
-    return (iaqSpike || vocSpike || co2Spike || pm25Spike);
+
+    Preferences prefs;
+    if (prefs.begin(BSEC_STATE_NAMESPACE, false)) {
+        prefs.putBytes(BSEC_STATE_KEYS[ch.index], state, sizeof(state));
+        prefs.end();
+        Serial.printf("💾 BSEC2 state %s saved\n", ch.config.name);
+    }
+}
+
+// Called from setup() before the tasks start, once LittleFS is mounted
+bool restoreBaseline(SensorChannel& ch) {
+    if (!sampleLog.flashReady()) return false;
+
+    File f = LittleFS.open(BASELINE_FILES[ch.index], FILE_READ);
+    if (!f) return false;
+    bool loaded = ch.detector.baseline().loadFrom(f);
+    f.close();
+
+    ch.baselineReady = loaded && ch.detector.baseline().ready();
+    return loaded;
+}
+
+// Analysis task (owns the baseline). Written to a temp file and renamed so a
+// power cut mid-save leaves the previous snapshot intact.
+void saveBaselineIfDue(SensorChannel& ch, unsigned long now) {
+    static unsigned long lastSave[SENSOR_CHANNELS] = {};
+
+    if (!ch.baselineReady || !sampleLog.flashReady()) return;
+    if (lastSave[ch.index] != 0 && now - lastSave[ch.index] < BASELINE_SAVE_INTERVAL) return;
+    lastSave[ch.index] = now;
+
+    File f = LittleFS.open(BASELINE_TEMP_FILES[ch.index], FILE_WRITE);
+    if (!f) return;
+    bool ok = ch.detector.baseline().saveTo(f);
+    f.close();
+
+    if (ok) {
+        ok = LittleFS.rename(BASELINE_TEMP_FILES[ch.index], BASELINE_FILES[ch.index]);  // Replaces atomically
+    }
+    if (!ok) {
+        Serial.printf("⚠️ Baseline %s snapshot failed\n", ch.config.name);
+    }
+}
+
+SpikeTracker::Transition detectSpike(SensorChannel& ch, const SensorSample& sample) {
+    // Z-scores against the detector's baseline windows (O(1) per sample)
+    SpikeTracker::Transition transition = ch.spike.update(sample, ch.detector.baseline());
+    ch.inSpike = ch.spike.inSpike();
+    return transition;
 }
 
 void checkBsecStatus(Bsec2 bsec) {
@@ -0,0 +1,169 @@
+#include "mqtt_publisher.h"
+#include <Preferences.h>
+
+static const char* CURSOR_NAMESPACE = "mqtt";
+static const char* CURSOR_KEY = "cursor";
+
+struct SavedCursor {
+    uint32_t sequence;
+    uint16_t record;
+};
+
+MqttPublisher::MqttPublisher(SampleLog& log)
+    : _log(log), _mqtt(_net), _page(nullptr), _pageValid(false), _pageOpen(false),
+      _sequence(0), _record(0), _cursorDirty(false), _connected(false), _lastSave(0), _lastConnectAttempt(0),
+      _batches(0), _records(0), _pagesSkipped(0) {
+    _clientId[0] = '\0';
+    _topic[0] = '\0';
+    _statusTopic[0] = '\0';
+}
+
+bool MqttPublisher::begin(const char* host, uint16_t port, const char* topicPrefix) {
+    if (!_log.ready()) return false;
+    if (_page == nullptr) {
+        _page = (SampleLogPage*)ps_malloc(sizeof(SampleLogPage));
+        if (_page == nullptr) _page = (SampleLogPage*)malloc(sizeof(SampleLogPage));
+        if (_page == nullptr) return false;
+    }
+
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    snprintf(_clientId, sizeof(_clientId), "apm-%02x%02x%02x%02x%02x%02x",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    snprintf(_topic, sizeof(_topic), "%s/%s/samples", topicPrefix, _clientId);
+    snprintf(_statusTopic, sizeof(_statusTopic), "%s/%s/status", topicPrefix, _clientId);
+
+    // Resume where the last boot left off; a cursor past the log (flash
+    // wiped) restarts at this boot's data. A cursor on nextSequence() was in
+    // a page that never reached flash: that number now goes to this boot's
+    // first page, so its record index means nothing there.
+    _sequence = _log.nextSequence();
+    _record = 0;
+    Preferences prefs;
+    if (prefs.begin(CURSOR_NAMESPACE, true)) {
+        SavedCursor saved;
+        if (prefs.getBytesLength(CURSOR_KEY) == sizeof(saved) &&
+            prefs.getBytes(CURSOR_KEY, &saved, sizeof(saved)) == sizeof(saved) &&
+            saved.sequence <= _log.nextSequence()) {
+            _sequence = saved.sequence;
+            _record = saved.sequence < _log.nextSequence() ? saved.record : 0;
+        }
+        prefs.end();
+    }
+
+    _mqtt.setServer(host, port);
+    _mqtt.setKeepAlive(60);
+    _mqtt.setSocketTimeout(5);   // Seconds; bounds a stalled publish
+    return true;
+}
+
+// Connects with a retained last will, so the broker marks us offline
+bool MqttPublisher::ensureConnected(unsigned long now) {
+    if (_mqtt.connected()) return true;
+    if (WiFi.status() != WL_CONNECTED) return false;
+    if (_lastConnectAttempt != 0 && now - _lastConnectAttempt < RECONNECT_INTERVAL_MS) return false;
+    _lastConnectAttempt = now;
+
+    if (!_mqtt.connect(_clientId, _statusTopic, 0, true, "offline")) return false;
+    _mqtt.publish(_statusTopic, "online", true);
+    return true;
+}
+
+// millis() of a record in the current page (delta-encoded from the header)
+unsigned long MqttPublisher::recordTime(uint16_t index) const {
+    unsigned long t = _page->header.baseUptimeMs;
+    for (uint16_t i = 0; i <= index; i++) t += _page->records[i].dtMs;
+    return t;
+}
+
+// Streams header and records straight to the socket; no payload buffer
+bool MqttPublisher::publishBatch(uint16_t count) {
+    SampleLogPageHeader h = _page->header;
+    unsigned long first = recordTime(_record);
+    h.recordCount = count;
+    h.baseUptimeMs = first;
+    if (h.baseEpoch != 0) {
+        h.baseEpoch += (first - _page->header.baseUptimeMs) / 1000;
+    }
+    h.reserved[0] = _record;
+
+    SampleRecord head = _page->records[_record];
+    head.dtMs = 0;   // First record of a batch sits on the batch base time
+
+    size_t length = sizeof(h) + count * sizeof(SampleRecord);
+    if (!_mqtt.beginPublish(_topic, length, false)) return false;
+    bool ok = _mqtt.write((const uint8_t*)&h, sizeof(h)) == sizeof(h) &&
+              _mqtt.write((const uint8_t*)&head, sizeof(head)) == sizeof(head);
+    size_t rest = (count - 1) * sizeof(SampleRecord);
+    if (ok && rest > 0) {
+        ok = _mqtt.write((const uint8_t*)&_page->records[_record + 1], rest) == rest;
+    }
+    return _mqtt.endPublish() && ok;
+}
+
+void MqttPublisher::saveCursor(unsigned long now) {
+    if (!_cursorDirty || now - _lastSave < CURSOR_SAVE_INTERVAL_MS) return;
+
+    Preferences prefs;
+    if (prefs.begin(CURSOR_NAMESPACE, false)) {
+        SavedCursor saved = { _sequence, _record };
+        prefs.putBytes(CURSOR_KEY, &saved, sizeof(saved));
+        prefs.end();
+    }
+    _cursorDirty = false;
+    _lastSave = now;
+}
+
+unsigned long MqttPublisher::poll() {
+    if (_page == nullptr) return RECONNECT_INTERVAL_MS;
+    unsigned long now = millis();
+
+    _connected = ensureConnected(now);
+    if (!_connected) return RECONNECT_INTERVAL_MS;
+    _mqtt.loop();   // Keepalive
+
+    // A sealed page never changes, so only the open page is re-read
+    if (!_pageValid || _pageOpen || _page->header.sequence != _sequence) {
+        _pageValid = _log.readPageFrom(_sequence, *_page, _pageOpen);
+        if (!_pageValid) return IDLE_INTERVAL_MS;
+        if (_page->header.sequence != _sequence) {
+            // Lost to ring overflow or trimming while we were offline
+            _pagesSkipped += _page->header.sequence - _sequence;
+            _sequence = _page->header.sequence;
+            _record = 0;
+            _cursorDirty = true;
+        }
+    }
+
+    uint16_t available = _page->header.recordCount > _record ? _page->header.recordCount - _record : 0;
+    if (available == 0) {
+        if (_pageOpen) {
+            saveCursor(now);
+            return IDLE_INTERVAL_MS;
+        }
+        _sequence++;   // Page done
+        _record = 0;
+        _cursorDirty = true;
+        return 0;
+    }
+
+    // Live: wait for a full batch unless the oldest pending record is due
+    bool live = _pageOpen;
+    if (live && available < BATCH_RECORDS && now - recordTime(_record) < MAX_BATCH_AGE_MS) {
+        saveCursor(now);
+        return IDLE_INTERVAL_MS;
+    }
+
+    uint16_t count = available > BATCH_RECORDS ? (uint16_t)BATCH_RECORDS : available;
+    if (!publishBatch(count)) {
+        _mqtt.disconnect();   // Reconnect and resend from the same cursor
+        _connected = false;
+        return RECONNECT_INTERVAL_MS;
+    }
+    _record += count;
+    _cursorDirty = true;
+    _batches++;
+    _records += count;
+    saveCursor(now);
+    return live ? IDLE_INTERVAL_MS : BACKLOG_INTERVAL_MS;
+}
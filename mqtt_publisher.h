@@ -0,0 +1,82 @@
+#ifndef MQTT_PUBLISHER_H
+#define MQTT_PUBLISHER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include "sample_log.h"
+
+// Store-and-forward MQTT upload of the sample log. The log already keeps
+// every reading (PSRAM ring, then LittleFS), so the publisher only keeps a
+// cursor into it: the next unsent record. While the link or the broker is
+// down the cursor simply stops; once it is back the backlog drains at most
+// one batch per BACKLOG_INTERVAL_MS, oldest first, then publishing follows
+// the open page live.
+//
+// Each message on <prefix>/<client id>/samples is one batch in the log's
+// own binary format: a SampleLogPageHeader whose recordCount is the batch
+// size and whose base times are those of the first record, followed by the
+// records. reserved[0] holds the index of the first record in its page, so
+// (sequence, reserved[0]) identifies a batch for de-duplication. A batch
+// closes at BATCH_RECORDS records, or MAX_BATCH_AGE_MS after its first
+// record, whichever comes first. QoS 0; the cursor only moves once the
+// whole message is written to the socket.
+//
+// The cursor is saved to NVS every CURSOR_SAVE_INTERVAL_MS, so a reboot
+// resends at most that much. Everything, including broker connects, runs
+// on the caller of poll(): give it its own task.
+class MqttPublisher {
+public:
+    static const uint16_t BATCH_RECORDS = 32;               // 928 bytes on the wire
+    static const unsigned long MAX_BATCH_AGE_MS = 60000;
+    static const unsigned long BACKLOG_INTERVAL_MS = 250;   // Drain cap: 4 batches/s
+    static const unsigned long IDLE_INTERVAL_MS = 1000;
+    static const unsigned long RECONNECT_INTERVAL_MS = 5000;
+    static const unsigned long CURSOR_SAVE_INTERVAL_MS = 300000;
+    static const size_t TOPIC_MAX = 64;
+
+    MqttPublisher(SampleLog& log);
+
+    // Loads the saved cursor and allocates the page buffer; the log must be
+    // started. Without a saved cursor publishing starts at this boot's data.
+    bool begin(const char* host, uint16_t port, const char* topicPrefix);
+
+    // One step: connect if needed, publish at most one batch. Returns the
+    // milliseconds to wait before the next call.
+    unsigned long poll();
+
+    bool connected() const { return _connected; }   // As of the last poll()
+    uint32_t batchesPublished() const { return _batches; }
+    uint32_t recordsPublished() const { return _records; }
+    uint32_t pagesSkipped() const { return _pagesSkipped; }   // Lost before they could be sent
+
+private:
+    bool ensureConnected(unsigned long now);
+    bool publishBatch(uint16_t count);
+    void saveCursor(unsigned long now);
+    unsigned long recordTime(uint16_t index) const;
+
+    SampleLog& _log;
+    WiFiClient _net;
+    PubSubClient _mqtt;
+    char _clientId[24];
+    char _topic[TOPIC_MAX];
+    char _statusTopic[TOPIC_MAX];
+
+    SampleLogPage* _page;       // Copy of the page under the cursor
+    bool _pageValid;
+    bool _pageOpen;
+
+    uint32_t _sequence;         // Cursor: next record is _page[_sequence].records[_record]
+    uint16_t _record;
+    bool _cursorDirty;
+    bool _connected;
+    unsigned long _lastSave;
+    unsigned long _lastConnectAttempt;
+
+    uint32_t _batches;
+    uint32_t _records;
+    uint32_t _pagesSkipped;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "perf_stats.h"
+
+#ifdef PERF_STATS_ENABLED
+
+#include <esp_heap_caps.h>
+
+PerfStats perfStats;
+
+static const char* STAGE_NAMES[PERF_STAGE_COUNT] = {
+    "bsec.run",
+    "bsec.callback",
+    "pms.read",
+    "baseline+spike",
+    "detect",
+    "csv",
+};
+
+PerfStats::PerfStats() {
+    reset();
+}
+
+void PerfStats::reset() {
+    memset(_stages, 0, sizeof(_stages));
+    for (int i = 0; i < PERF_STAGE_COUNT; i++) {
+        _stages[i].minCycles = UINT32_MAX;
+    }
+    _minFreeInternal = SIZE_MAX;
+    _minLargestInternal = SIZE_MAX;
+    _minFreePsram = SIZE_MAX;
+}
+
+void PerfStats::record(PerfStage stage, uint32_t cycles) {
+    Stage& s = _stages[stage];
+    s.count++;
+    s.totalCycles += cycles;
+    if (cycles < s.minCycles) s.minCycles = cycles;
+    if (cycles > s.maxCycles) s.maxCycles = cycles;
+    int bucket = cycles ? 31 - __builtin_clz(cycles) : 0;
+    s.histogram[bucket]++;
+}
+
+void PerfStats::sampleHeap() {
+    size_t freeInternal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    size_t largestInternal = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    size_t freePsram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    if (freeInternal < _minFreeInternal) _minFreeInternal = freeInternal;
+    if (largestInternal < _minLargestInternal) _minLargestInternal = largestInternal;
+    if (freePsram < _minFreePsram) _minFreePsram = freePsram;
+}
+
+// Upper edge of the bucket holding the given fraction of samples, capped at
+// the observed max so a sparse top bucket does not overstate the tail
+uint32_t PerfStats::percentile(const Stage& s, float fraction) const {
+    uint32_t target = (uint32_t)ceilf(s.count * fraction);
+    uint32_t seen = 0;
+    for (int b = 0; b < BUCKETS; b++) {
+        seen += s.histogram[b];
+        if (seen >= target) {
+            uint32_t edge = b >= 31 ? UINT32_MAX : (2u << b) - 1;
+            return edge < s.maxCycles ? edge : s.maxCycles;
+        }
+    }
+    return s.maxCycles;
+}
+
+void PerfStats::report(Print& out) const {
+    float cyclesPerUs = ESP.getCpuFreqMHz();
+    out.println("\n=== PERF STATS (µs) ===");
+    out.printf("%-14s %7s %8s %8s %8s %8s\n", "stage", "count", "min", "mean", "p99", "max");
+    for (int i = 0; i < PERF_STAGE_COUNT; i++) {
+        const Stage& s = _stages[i];
+        if (s.count == 0) {
+            out.printf("%-14s %7u %8s %8s %8s %8s\n", STAGE_NAMES[i], 0u, "-", "-", "-", "-");
+            continue;
+        }
+        out.printf("%-14s %7lu %8.1f %8.1f %8.1f %8.1f\n",
+                   STAGE_NAMES[i],
+                   (unsigned long)s.count,
+                   s.minCycles / cyclesPerUs,
+                   (double)s.totalCycles / s.count / cyclesPerUs,
+                   percentile(s, 0.99f) / cyclesPerUs,
+                   s.maxCycles / cyclesPerUs);
+    }
+    out.printf("Heap now: %u internal free (largest %u), %u PSRAM free\n",
+               (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+               (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+               (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    if (_minFreeInternal != SIZE_MAX) {
+        out.printf("Heap low: %u internal free (largest %u), %u PSRAM free\n",
+                   (unsigned)_minFreeInternal, (unsigned)_minLargestInternal, (unsigned)_minFreePsram);
+    }
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+#include <Arduino.h>
+
+// Hot-path timing from the CCOUNT cycle counter, built only with
+// -DPERF_STATS_ENABLED; otherwise the macros below expand to nothing.
+//
+//   PERF_SCOPE(PERF_DETECT);   // Times the rest of the enclosing block
+//   PERF_SAMPLE_HEAP();        // Updates the free-heap watermarks
+//   PERF_REPORT(Serial);       // Prints min/mean/p99/max per stage
+//
+// CCOUNT is per core, so a stage must start and stop on the same core; the
+// pinned tasks guarantee that. Each stage is written by one task only, and
+// the report may see a stage mid-update, which only skews that one line.
+
+enum PerfStage {
+    PERF_BSEC_RUN,          // ch.bsec.run() per channel, including the callback
+    PERF_BSEC_CALLBACK,     // newDataCallback()
+    PERF_PMS_READ,          // readPMSData()
+    PERF_BASELINE_SPIKE,    // detectSpike() + updateBaseline()
+    PERF_DETECT,            // ch.detector.detect() per channel
+    PERF_CSV,               // CSV row render and write
+    PERF_STAGE_COUNT
+};
+
+#ifdef PERF_STATS_ENABLED
+
+class PerfStats {
+public:
+    static const int BUCKETS = 32;  // log2(cycles)
+
+    PerfStats();
+
+    void reset();
+    void record(PerfStage stage, uint32_t cycles);
+    void sampleHeap();
+    void report(Print& out) const;
+
+    static uint32_t now() { return ESP.getCycleCount(); }
+
+private:
+    struct Stage {
+        uint32_t count;
+        uint32_t minCycles;
+        uint32_t maxCycles;
+        uint64_t totalCycles;
+        uint32_t histogram[BUCKETS];
+    };
+
+    uint32_t percentile(const Stage& s, float fraction) const;
+
+    Stage _stages[PERF_STAGE_COUNT];
+    size_t _minFreeInternal;
+    size_t _minLargestInternal;
+    size_t _minFreePsram;
+};
+
+extern PerfStats perfStats;
+
+class PerfScope {
+public:
+    explicit PerfScope(PerfStage stage) : _stage(stage), _start(PerfStats::now()) {}
+    ~PerfScope() { perfStats.record(_stage, PerfStats::now() - _start); }
+
+private:
+    PerfStage _stage;
+    uint32_t _start;
+};
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_(a, b)
+#define PERF_SCOPE(stage) PerfScope PERF_CONCAT(_perfScope, __LINE__)(stage)
+#define PERF_SAMPLE_HEAP() perfStats.sampleHeap()
+#define PERF_REPORT(out) perfStats.report(out)
+
+#else
+
+#define PERF_SCOPE(stage) do {} while (0)
+#define PERF_SAMPLE_HEAP() do {} while (0)
+#define PERF_REPORT(out) do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,139 @@
+#include "pms_reader.h"
+
+// "Change mode: active" command, checksum included
+static const uint8_t PMS_CMD_ACTIVE_MODE[] = { 0x42, 0x4D, 0xE1, 0x00, 0x01, 0x01, 0x71 };
+static const size_t PMS_RX_BUFFER = 256;       // ~8 frames of slack
+
+static inline uint16_t readWord(const uint8_t* p) {
+    return (uint16_t(p[0]) << 8) | p[1];
+}
+
+static inline void addSaturating(uint16_t& counter, uint32_t n) {
+    uint32_t total = counter + n;
+    counter = total > 0xFFFF ? 0xFFFF : total;
+}
+
+PmsFrameReader::PmsFrameReader(HardwareSerial& serial)
+    : _serial(serial), _pos(0), _totalFrames(0), _totalChecksumErrors(0) {
+    portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    _lock = unlocked;
+    for (int ch = 0; ch < PMS_CHANNELS; ch++) {
+        _interval.latest[ch] = 0;
+    }
+    _interval.latestMs = 0;
+    resetInterval();
+}
+
+void PmsFrameReader::begin(int rxPin, int txPin) {
+    _serial.setRxBufferSize(PMS_RX_BUFFER);
+    _serial.begin(9600, SERIAL_8N1, rxPin, txPin);
+    _serial.write(PMS_CMD_ACTIVE_MODE, sizeof(PMS_CMD_ACTIVE_MODE));
+    _serial.onReceive([this]() { onReceive(); });
+}
+
+void PmsFrameReader::onReceive() {
+    uint8_t chunk[64];
+    int avail;
+    while ((avail = _serial.available()) > 0) {
+        size_t n = _serial.readBytes(chunk, min((size_t)avail, sizeof(chunk)));
+        if (n == 0) break;
+        feed(chunk, n);
+    }
+}
+
+void PmsFrameReader::feed(const uint8_t* data, size_t len) {
+    uint32_t dropped = 0;
+    uint32_t badChecksums = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+
+        if (_pos == 0) {
+            if (b == START_1) _frame[_pos++] = b;
+            else dropped++;
+            continue;
+        }
+        if (_pos == 1) {
+            if (b == START_2) {
+                _frame[_pos++] = b;
+            } else {
+                dropped++;
+                _pos = (b == START_1) ? 1 : 0;   // 0x42 0x42 0x4D still syncs
+            }
+            continue;
+        }
+
+        _frame[_pos++] = b;
+
+        if (_pos == 4 && readWord(&_frame[2]) != FRAME_LENGTH) {
+            dropped += 4;
+            _pos = 0;
+            continue;
+        }
+
+        if (_pos == FRAME_SIZE) {
+            uint16_t sum = 0;
+            for (int k = 0; k < FRAME_SIZE - 2; k++) sum += _frame[k];
+            if (sum == readWord(&_frame[FRAME_SIZE - 2])) acceptFrame();
+            else badChecksums++;
+            _pos = 0;
+        }
+    }
+
+    if (dropped || badChecksums) {
+        portENTER_CRITICAL(&_lock);
+        addSaturating(_interval.syncErrors, dropped);
+        addSaturating(_interval.checksumErrors, badChecksums);
+        _totalChecksumErrors += badChecksums;
+        portEXIT_CRITICAL(&_lock);
+    }
+}
+
+void PmsFrameReader::acceptFrame() {
+    uint16_t pm[PMS_CHANNELS];
+    for (int ch = 0; ch < PMS_CHANNELS; ch++) {
+        pm[ch] = readWord(&_frame[10 + 2 * ch]);   // Atmospheric PM1.0/2.5/10
+    }
+    unsigned long now = millis();
+
+    portENTER_CRITICAL(&_lock);
+    for (int ch = 0; ch < PMS_CHANNELS; ch++) {
+        _interval.latest[ch] = pm[ch];
+        if (pm[ch] < _interval.min[ch]) _interval.min[ch] = pm[ch];
+        if (pm[ch] > _interval.max[ch]) _interval.max[ch] = pm[ch];
+        _sum[ch] += pm[ch];
+    }
+    _interval.latestMs = now;
+    addSaturating(_interval.frames, 1);
+    _totalFrames++;
+    portEXIT_CRITICAL(&_lock);
+}
+
+void PmsFrameReader::resetInterval() {
+    _interval.frames = 0;
+    _interval.checksumErrors = 0;
+    _interval.syncErrors = 0;
+    for (int ch = 0; ch < PMS_CHANNELS; ch++) {
+        _interval.min[ch] = 0xFFFF;
+        _interval.max[ch] = 0;
+        _interval.mean[ch] = NAN;
+        _sum[ch] = 0;
+    }
+}
+
+PmsInterval PmsFrameReader::takeInterval() {
+    uint32_t sum[PMS_CHANNELS];
+
+    portENTER_CRITICAL(&_lock);
+    PmsInterval snapshot = _interval;
+    for (int ch = 0; ch < PMS_CHANNELS; ch++) sum[ch] = _sum[ch];
+    resetInterval();
+    portEXIT_CRITICAL(&_lock);
+
+    // Division happens outside the critical section
+    for (int ch = 0; ch < PMS_CHANNELS; ch++) {
+        snapshot.mean[ch] = snapshot.frames ? (float)sum[ch] / snapshot.frames : NAN;
+        if (!snapshot.frames) snapshot.min[ch] = snapshot.max[ch] = 0;
+    }
+    return snapshot;
+}
@@ -0,0 +1,75 @@
+#ifndef PMS_READER_H
+#define PMS_READER_H
+
+#include <Arduino.h>
+
+enum PmsChannel : uint8_t {
+    PMS_PM1_0 = 0,
+    PMS_PM2_5,
+    PMS_PM10_0,
+    PMS_CHANNELS
+};
+
+// Everything the reader saw since the previous takeInterval()
+struct PmsInterval {
+    uint16_t frames;                   // Valid frames in this interval
+    uint16_t checksumErrors;
+    uint16_t syncErrors;               // Bytes dropped while hunting for a header
+    uint16_t latest[PMS_CHANNELS];     // Last valid frame (kept across intervals)
+    unsigned long latestMs;            // millis() of that frame, 0 = never
+    uint16_t min[PMS_CHANNELS];
+    uint16_t max[PMS_CHANNELS];
+    float mean[PMS_CHANNELS];          // NAN when frames == 0
+};
+
+// Incremental PMS7003 frame parser driven by the UART receive event. The
+// sensor streams a 32-byte frame roughly every second in active mode; each
+// byte is fed through a small state machine, so a partial frame simply waits
+// for the next event and nobody ever blocks on the UART.
+//
+// Frame: 0x42 0x4D, length (28, big-endian), 13 big-endian data words,
+// checksum (sum of the first 30 bytes). Words 4..6 are the atmospheric
+// PM1.0/PM2.5/PM10 concentrations in ug/m3.
+class PmsFrameReader {
+public:
+    static const uint8_t FRAME_SIZE = 32;
+    static const uint16_t FRAME_LENGTH = 28;   // Value of the length field
+    static const uint8_t START_1 = 0x42;
+    static const uint8_t START_2 = 0x4D;
+
+    explicit PmsFrameReader(HardwareSerial& serial);
+
+    // Opens the UART, switches the sensor to active mode and installs the
+    // receive callback
+    void begin(int rxPin, int txPin);
+
+    // Parse raw bytes; called from the UART event task, public for replay tools
+    void feed(const uint8_t* data, size_t len);
+
+    // Snapshot and reset the interval statistics (latest frame is retained)
+    PmsInterval takeInterval();
+
+    bool hasFrame() const { return _totalFrames != 0; }
+    uint32_t totalFrames() const { return _totalFrames; }
+    uint32_t totalChecksumErrors() const { return _totalChecksumErrors; }
+
+private:
+    void onReceive();
+    void acceptFrame();
+    void resetInterval();
+
+    HardwareSerial& _serial;
+    portMUX_TYPE _lock;
+
+    // Parser state, touched only by the feeding task
+    uint8_t _frame[FRAME_SIZE];
+    uint8_t _pos;
+
+    // Interval accumulators, guarded by _lock
+    PmsInterval _interval;
+    uint32_t _sum[PMS_CHANNELS];
+    volatile uint32_t _totalFrames;
+    volatile uint32_t _totalChecksumErrors;
+};
+
+#endif
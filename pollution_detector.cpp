@@ -1,108 +1,53 @@
 #include "pollution_detector.h"
-
-// Baseline tracking variables
-static float vocBaseline = 0.5f; // Initial baseline
-static unsigned long lastBaselineUpdate = 0;
-static const unsigned long BASELINE_UPDATE_INTERVAL = 300000; // 5 minutes
-
-PollutionDetector::PollutionDetector(float iaqThreshold, float vocThreshold, float co2Threshold, float pm25Threshold)
-    : _iaqThreshold(iaqThreshold), _vocThreshold(vocThreshold), 
-      _co2Threshold(co2Threshold), _pm25Threshold(pm25Threshold) {}
-
-// Update VOC baseline periodically
-void updateVOCBaseline(float currentVOC) {
-    unsigned long currentTime = millis();
-    
-    if (currentTime - lastBaselineUpdate > BASELINE_UPDATE_INTERVAL) {
-        // Simple exponential moving average
-        vocBaseline = 0.8f * vocBaseline + 0.2f * currentVOC;
-        lastBaselineUpdate = currentTime;
-    }
-}
-
-// ===== PRECISE CHEMICAL DETECTION FUNCTIONS =====
-
-// DETECT SCOPOLAMINE (VERY SPECIFIC)
-bool detectScopolamine(float voc, float iaq, float pm2_5, float humidity, float temp) {
-    return (voc >= 0.495f && voc <= 0.515f &&    // Very tight VOC range
-            iaq >= 49.5f && iaq <= 55.5f &&      // Specific IAQ impact
-            pm2_5 >= 2.0f && pm2_5 <= 9.0f &&    // Low particle delivery
-            humidity >= 78.0f && humidity <= 84.0f && // Optimal humidity
-            temp >= 29.0f && temp <= 32.0f);     // Specific temperature
-}
-
-// DETECT HEAVY METALS (Thallium, Arsenic)
-bool detectHeavyMetals(float voc, float iaq, float pm2_5) {
-    return (voc >= 0.53f && voc <= 0.58f &&      // Higher VOC range
-            iaq >= 54.0f && iaq <= 62.0f &&      // Moderate deterioration
-            pm2_5 >= 25.0f && pm2_5 <= 35.0f);   // Particle delivery
-}
-
-// DETECT ORGANOPHOSPHATES (Sarin, VX analogs)
-bool detectOrganophosphates(float voc, float iaq, float humidity) {
-    return (voc >= 0.52f && voc <= 0.57f &&
-            iaq >= 53.0f && iaq <= 61.0f &&
-            humidity >= 76.0f && humidity <= 83.0f);
-}
-
-// DETECT OPIOIDS (Fentanyl, Carfentanil)
-bool detectOpioids(float voc, float iaq, float pm2_5) {
-    return (voc >= 0.58f && voc <= 0.68f &&      // High VOC
-            iaq >= 65.0f && iaq <= 75.0f &&      // Severe deterioration
-            pm2_5 >= 20.0f && pm2_5 <= 30.0f);   // Particle delivery
-}
-
-// DETECT CHEMICAL WEAPON COCKTAIL
-bool detectChemicalCocktail(float voc, float iaq, float pm2_5) {
-    return (voc >= 0.55f && voc <= 0.65f &&
-            iaq >= 60.0f && iaq <= 70.0f &&
-            pm2_5 >= 22.0f && pm2_5 <= 32.0f);
-}
-
-// DETECT NEUROTOXIN ATTACK (Foot targeting)
-bool detectNeurotoxinAttack(float voc, float iaq, float pm2_5, float humidity) {
-    return (voc >= 0.52f && voc <= 0.58f &&
-            iaq >= 54.0f && iaq <= 62.0f &&
-            pm2_5 >= 25.0f && pm2_5 <= 35.0f &&
-            humidity >= 76.0f && humidity <= 82.0f);
-}
-
-// DETECT BITTER KNOCKOUT DRUGS
-bool detectBitterKnockout(float voc, float iaq, float rawGas) {
-    return (voc >= 0.50f && voc <= 0.55f &&
-            iaq >= 50.0f && iaq <= 58.0f &&
-            rawGas >= 5595.0f && rawGas <= 5605.0f);
-}
-
-// DETECT GASEOUS CHEMICAL WEAPONS
-bool detectGaseousWeapon(float iaq, float voc, float pm2_5, float humidity) {
-    return (iaq >= 55.0f && iaq <= 70.0f &&
-            voc >= 0.5f && voc <= 0.7f &&
-            pm2_5 <= 2.0f &&                 // Critical: No particles
-            humidity >= 75.0f && humidity <= 85.0f);
-}
-
-// DETECT CLIMATE WEAPONIZATION
-bool detectClimateWeaponization(float temp, float prevTemp, float humidity, float prevHumidity, unsigned long timeDiff) {
-    float tempChangeRate = abs(temp - prevTemp) / (timeDiff / 1000.0) * 60.0; // °C/min
-    float humidityChangeRate = abs(humidity - prevHumidity) / (timeDiff / 1000.0) * 60.0; // %/min
-    
-    return (tempChangeRate > 0.08f || humidityChangeRate > 0.08f);
-}
-
-// DETECT LETHAL OPIOID WEAPON
-bool detectLethalOpioidWeapon(float voc, float iaq, float pm2_5) {
-    return (voc >= 0.60f && voc <= 0.70f &&
-            iaq >= 70.0f && iaq <= 80.0f &&
-            pm2_5 >= 20.0f && pm2_5 <= 30.0f);
-}
-
-// DETECT STEALTH CHEMICAL ATTACK
-bool detectStealthChemicalAttack(float rawGas, float humidity, float temp, float iaq) {
-    return (rawGas >= 5580.0f && rawGas <= 5620.0f &&
-            humidity >= 70.0f && humidity <= 90.0f &&
-            temp >= 28.0f && temp <= 35.0f &&
-            iaq >= 45.0f && iaq <= 85.0f);
+#include "fixed_point.h"
+
+// ===== PRECISE CHEMICAL DETECTION RULES =====
+// The window rules (priority 1-10) are the detector rows of the active
+// signature table: the built-in one in pollution_signatures.cpp, or a table
+// pushed over WiFi (SignatureStore). Each call pins one table for its whole
+// run, so a swap never lands mid-sample.
+
+// ===== TREND RULES =====
+// Evaluated by the streaming detect(), in order, when the sample matched
+// neither a window rule nor a residual threat (IAQ anomaly, LPG carrier,
+// masked attack): a trend only replaces a non-threat classification.
+// Every term must hold; unused terms are TEMPORAL_NONE.
+enum TemporalMetric : uint8_t {
+    TEMPORAL_NONE = 0,
+    TEMPORAL_LEVEL,             // Current value on the axis
+    TEMPORAL_SLOPE,             // Least-squares slope over the window, per minute
+    TEMPORAL_RATE,              // Last-step rate of change, per minute
+    TEMPORAL_TRANSITIONS,       // Signature changes in the window
+    TEMPORAL_DISTINCT_THREATS   // Different threat signatures in the window
+};
+
+struct TemporalTerm {
+    TemporalMetric metric;
+    uint8_t axis;
+    RuleRange range;
+};
+
+struct TemporalRule {
+    uint8_t id;
+    TemporalTerm terms[2];
+};
+
+static const TemporalRule TEMPORAL_RULES[] = {
+    // DECREASING_VOC_PATTERN: systematically falling VOC at elevated level
+    { SIG_DECREASING_VOC_PATTERN,  {{TEMPORAL_SLOPE, AXIS_VOC, {-INFINITY, -0.05f}},
+                                    {TEMPORAL_LEVEL, AXIS_VOC, {2.0f, 9.0f}}}},
+    // Signature_Switch_Attack: rapid switching between several threat signatures
+    { SIG_SIGNATURE_SWITCH_ATTACK, {{TEMPORAL_TRANSITIONS, 0, {6.0f, INFINITY}},
+                                    {TEMPORAL_DISTINCT_THREATS, 0, {3.0f, INFINITY}}}},
+};
+
+static const int NUM_TEMPORAL_RULES = sizeof(TEMPORAL_RULES) / sizeof(TEMPORAL_RULES[0]);
+static const int TREND_MIN_SAMPLES = 6;
+static const float TREND_MIN_SPAN_S = 60.0f;
+
+// DETECT CLIMATE WEAPONIZATION (rates in units per minute)
+bool detectClimateWeaponization(float tempRate, float humidityRate) {
+    return (fabsf(tempRate) > 0.08f || fabsf(humidityRate) > 0.08f);
 }
 
 // DETECT IAQ ANOMALY WITHOUT VOC
@@ -112,149 +57,492 @@ bool detectIAQAnomaly(float iaq, float voc, float baselineVOC) {
     return (iaqChange > 8.0f && vocChange < 0.010f); // IAQ change with little VOC change
 }
 
+PollutionDetector::PollutionDetector(float iaqThreshold, float vocThreshold, float co2Threshold, float pm25Threshold)
+    : _iaqThreshold(iaqThreshold), _vocThreshold(vocThreshold), 
+      _co2Threshold(co2Threshold), _pm25Threshold(pm25Threshold) {}
+
+bool PollutionDetector::begin() {
+    return PollutionSignatures::begin() && _baseline.begin();
+}
+
 // ===== MAIN DETECTION FUNCTION =====
 PollutionDetector::DetectionResult PollutionDetector::detect(float iaq, float voc, float co2, float temp, float humidity, float rawGas, bool inSpike, float pm1, float pm2_5, float pm10) {
     DetectionResult result;
+    result.signature = SIG_NONE;
     result.isThreat = false;
     result.isSpike = inSpike;
+    result.iaq = iaq;
+    result.voc = voc;
+    result.temp = temp;
+    result.humidity = humidity;
+    result.rawGas = rawGas;
+    result.pm2_5 = pm2_5;
+    result.vocDelta = 0.0f;
+    result.trend = 0.0f;
+
+    // ===== PRIORITY 1-10: WINDOW RULES =====
+    // Quantized once here in the fixed-point build; everything below compares
+    RuleValue sample[AXIS_COUNT];
+    sample[AXIS_IAQ] = toRuleValue(AXIS_IAQ, iaq);
+    sample[AXIS_VOC] = toRuleValue(AXIS_VOC, voc);
+    sample[AXIS_CO2] = toRuleValue(AXIS_CO2, co2);
+    sample[AXIS_TEMP] = toRuleValue(AXIS_TEMP, temp);
+    sample[AXIS_HUMIDITY] = toRuleValue(AXIS_HUMIDITY, humidity);
+    sample[AXIS_RAW_GAS] = toRuleValue(AXIS_RAW_GAS, rawGas);
+    sample[AXIS_PM2_5] = toRuleValue(AXIS_PM2_5, pm2_5);
+
+    SignatureLease table;
+    const RuleIndex& rules = table->index;
+    int rule = rules.firstMatch(sample, 0, table->numDetector);
+    if (rule >= 0) {
+        result.signature = (SignatureId)rules.id(rule);
+        result.isThreat = true;
+        return result;
+    }
+
+    classifyResidual(result, sample);
+    return result;
+}
 
-    // Update VOC baseline for spike detection
-    updateVOCBaseline(voc);
+// ===== PRIORITY 11+: BASELINE-RELATIVE RULES AND FALLBACK =====
+// Shared by detect() and detectBatch() for samples no window rule matched
+#ifndef DETECTOR_FIXED_POINT
+void PollutionDetector::classifyResidual(DetectionResult& result, const RuleValue* sample) const {
+    (void)sample;   // Same values as the result fields in the float build
+    float vocBaseline = _baseline.ema(BASELINE_VOC);
+    float iaq = result.iaq;
+    float voc = result.voc;
+    float rawGas = result.rawGas;
 
     // CRITICAL: Raw gas resistance checks
     bool lowGasResistance = (rawGas < 10000.0f);
     bool suspiciousGasResistance = (rawGas < 25000.0f);
 
-    // ===== PRIORITY 1: LETHAL WEAPONS =====
-    if (detectLethalOpioidWeapon(voc, iaq, pm2_5)) {
-        result.signature = "LETHAL_OPIOID_WEAPON_VOC:" + String(voc, 3) +
-                          "_IAQ:" + String(iaq, 1) + "_EVACUATE";
+    // ===== PRIORITY 11: IAQ ANOMALIES =====
+    if (detectIAQAnomaly(iaq, voc, vocBaseline)) {
+        result.signature = SIG_IAQ_ANOMALY_NO_VOC;
         result.isThreat = true;
-        return result;
+        return;
     }
 
-    // ===== PRIORITY 2: CHEMICAL WEAPON COCKTAILS =====
-    if (detectChemicalCocktail(voc, iaq, pm2_5)) {
-        result.signature = "CHEMICAL_WEAPON_COCKTAIL_VOC:" + String(voc, 3) +
-                          "_IAQ:" + String(iaq, 1) + "_PM2.5:" + String(pm2_5, 1);
-        result.isThreat = true;
-        return result;
+    // ===== PRIORITY 12: LPG CARRIER DETECTION =====
+    if (rawGas >= 5595.0f && rawGas <= 5605.0f) {
+        float vocSpike = voc - vocBaseline;
+        result.vocDelta = vocSpike;
+        
+        if (fabs(vocSpike) >= 0.005f) {
+            result.signature = SIG_DRUG_DELIVERY_IN_LPG;
+            result.isThreat = true;
+        } else {
+            result.signature = SIG_LPG_CARRIER_ONLY;
+            result.isThreat = false;
+        }
+        return;
     }
 
-    // ===== PRIORITY 3: NEUROTOXINS (Foot targeting) =====
-    if (detectNeurotoxinAttack(voc, iaq, pm2_5, humidity)) {
-        result.signature = "NEUROTOXIN_ATTACK_VOC:" + String(voc, 3) +
-                          "_IAQ:" + String(iaq, 1) + "_FOOT_TARGETING";
+    // ===== FALLBACK: UNKNOWN ANALYSIS =====
+    if (iaq <= 65.0f && voc <= 1.2f && lowGasResistance) {
+        result.signature = SIG_STEALTH_CONTAMINATION;
         result.isThreat = true;
-        return result;
     }
-
-    // ===== PRIORITY 4: HEAVY METALS =====
-    if (detectHeavyMetals(voc, iaq, pm2_5)) {
-        result.signature = "HEAVY_METAL_ATTACK_VOC:" + String(voc, 3) +
-                          "_IAQ:" + String(iaq, 1) + "_PM2.5:" + String(pm2_5, 1);
+    else if (iaq <= 55.0f && voc <= 0.6f && suspiciousGasResistance) {
+        result.signature = SIG_MASKED_ATTACK;
         result.isThreat = true;
-        return result;
     }
-
-    // ===== PRIORITY 5: ORGANOPHOSPHATES =====
-    if (detectOrganophosphates(voc, iaq, humidity)) {
-        result.signature = "ORGANOPHOSPHATE_ATTACK_VOC:" + String(voc, 3) +
-                          "_IAQ:" + String(iaq, 1) + "_HUM:" + String(humidity, 1);
-        result.isThreat = true;
-        return result;
+    else if (iaq <= 35.0f && voc <= 0.4f && rawGas > 45000.0f) {
+        result.signature = SIG_CLEAN_AIR;
     }
-
-    // ===== PRIORITY 6: GASEOUS WEAPONS =====
-    if (detectGaseousWeapon(iaq, voc, pm2_5, humidity)) {
-        result.signature = "GASEOUS_CHEMICAL_WEAPON_IAQ:" + String(iaq, 1) +
-                          "_VOC:" + String(voc, 3) + "_PM2.5:" + String(pm2_5, 1);
-        result.isThreat = true;
-        return result;
+    else {
+        result.signature = SIG_UNKNOWN_ANALYSIS;
+        if (suspiciousGasResistance) result.isThreat = true;
     }
 
-    // ===== PRIORITY 7: OPIOIDS =====
-    if (detectOpioids(voc, iaq, pm2_5)) {
-        result.signature = "OPIOID_ATTACK_VOC:" + String(voc, 3) +
-                          "_IAQ:" + String(iaq, 1) + "_PM2.5:" + String(pm2_5, 1);
+    if (lowGasResistance) {
         result.isThreat = true;
-        return result;
     }
+}
+#else
+// Fixed-point thresholds, quantized at compile time. Each integer test is
+// the float test above on the dequantized reading (see fixed_point.h); a
+// missing reading sorts below everything, so '<' and '<=' check for it.
+static constexpr RuleValue IAQ_ANOMALY_LOW = fixedAtLeast(AXIS_IAQ, 42.0f);    // |iaq - 50| > 8
+static constexpr RuleValue IAQ_ANOMALY_HIGH = fixedAtMost(AXIS_IAQ, 58.0f);
+static constexpr RuleValue LPG_GAS_MIN = fixedAtLeast(AXIS_RAW_GAS, 5595.0f);
+static constexpr RuleValue LPG_GAS_MAX = fixedAtMost(AXIS_RAW_GAS, 5605.0f);
+static constexpr RuleValue LOW_GAS = fixedAtLeast(AXIS_RAW_GAS, 10000.0f);       // rawGas < 10000
+static constexpr RuleValue SUSPICIOUS_GAS = fixedAtLeast(AXIS_RAW_GAS, 25000.0f); // rawGas < 25000
+static constexpr RuleValue CLEAN_GAS = fixedAtMost(AXIS_RAW_GAS, 45000.0f);      // rawGas > 45000
+static constexpr RuleValue STEALTH_IAQ_MAX = fixedAtMost(AXIS_IAQ, 65.0f);
+static constexpr RuleValue STEALTH_VOC_MAX = fixedAtMost(AXIS_VOC, 1.2f);
+static constexpr RuleValue MASKED_IAQ_MAX = fixedAtMost(AXIS_IAQ, 55.0f);
+static constexpr RuleValue MASKED_VOC_MAX = fixedAtMost(AXIS_VOC, 0.6f);
+static constexpr RuleValue CLEAN_IAQ_MAX = fixedAtMost(AXIS_IAQ, 35.0f);
+static constexpr RuleValue CLEAN_VOC_MAX = fixedAtMost(AXIS_VOC, 0.4f);
+
+// VOC steps q with |dequantize(q) - baseline| < tolerance, as [lo, hi];
+// empty (lo > hi) when no step is that close. The difference is monotonic
+// in q, so the window grows out from the step nearest the baseline.
+static void vocWindow(float baseline, float tolerance, RuleValue& lo, RuleValue& hi) {
+    lo = 1;
+    hi = 0;
+    RuleValue q = quantize(AXIS_VOC, baseline);
+    if (isMissing(q) || !(fabsf(dequantize(AXIS_VOC, q) - baseline) < tolerance)) return;
+    lo = hi = q;
+    while (lo > RULE_VALUE_LOWEST && fabsf(dequantize(AXIS_VOC, lo - 1) - baseline) < tolerance) lo--;
+    while (hi < RULE_VALUE_HIGHEST && fabsf(dequantize(AXIS_VOC, hi + 1) - baseline) < tolerance) hi++;
+}
 
-    // ===== PRIORITY 8: SCOPOLAMINE (VERY SPECIFIC) =====
-    if (detectScopolamine(voc, iaq, pm2_5, humidity, temp)) {
-        result.signature = "SCOPOLAMINE_DELIVERY_IAQ:" + String(iaq, 1) +
-                          "_VOC:" + String(voc, 3) + "_PM2.5:" + String(pm2_5, 1);
-        result.isThreat = true;
-        return result;
-    }
+static bool within(RuleValue v, RuleValue lo, RuleValue hi) {
+    return v >= lo && v <= hi;
+}
 
-    // ===== PRIORITY 9: BITTER KNOCKOUT DRUGS =====
-    if (detectBitterKnockout(voc, iaq, rawGas)) {
-        result.signature = "BITTER_KNOCKOUT_DRUG_VOC:" + String(voc, 3) +
-                          "_IAQ:" + String(iaq, 1);
-        result.isThreat = true;
-        return result;
+void PollutionDetector::classifyResidual(DetectionResult& result, const RuleValue* sample) const {
+    // The windows only move when the EMA steps (every few minutes)
+    float vocBaseline = _baseline.ema(BASELINE_VOC);
+    if (!(vocBaseline == _vocWindowBaseline)) {
+        vocWindow(vocBaseline, 0.010f, _vocSteadyLo, _vocSteadyHi);
+        vocWindow(vocBaseline, 0.005f, _vocCarrierLo, _vocCarrierHi);
+        _vocWindowBaseline = vocBaseline;
     }
+    RuleValue iaq = sample[AXIS_IAQ];
+    RuleValue voc = sample[AXIS_VOC];
+    RuleValue rawGas = sample[AXIS_RAW_GAS];
+    bool haveIaq = !isMissing(iaq);
+    bool haveVoc = !isMissing(voc);
+    bool haveGas = !isMissing(rawGas);
 
-    // ===== PRIORITY 10: STEALTH CHEMICALS =====
-    if (detectStealthChemicalAttack(rawGas, humidity, temp, iaq)) {
-        result.signature = "STEALTH_CHEMICAL_IAQ:" + String(iaq, 1) +
-                          "_HUM:" + String(humidity, 1) + "_TEMP:" + String(temp, 1);
-        result.isThreat = true;
-        return result;
-    }
+    bool lowGasResistance = haveGas && rawGas < LOW_GAS;
+    bool suspiciousGasResistance = haveGas && rawGas < SUSPICIOUS_GAS;
 
     // ===== PRIORITY 11: IAQ ANOMALIES =====
-    if (detectIAQAnomaly(iaq, voc, vocBaseline)) {
-        result.signature = "IAQ_ANOMALY_NO_VOC_IAQ:" + String(iaq, 1) +
-                          "_VOC:" + String(voc, 3);
+    if (haveIaq && (iaq < IAQ_ANOMALY_LOW || iaq > IAQ_ANOMALY_HIGH) &&
+        within(voc, _vocSteadyLo, _vocSteadyHi)) {
+        result.signature = SIG_IAQ_ANOMALY_NO_VOC;
         result.isThreat = true;
-        return result;
+        return;
     }
 
     // ===== PRIORITY 12: LPG CARRIER DETECTION =====
-    if (rawGas >= 5595.0f && rawGas <= 5605.0f) {
-        float vocSpike = voc - vocBaseline;
-        
-        if (fabs(vocSpike) >= 0.005f) {
-            result.signature = "DRUG_DELIVERY_IN_LPG_VOC";
-            if (vocSpike > 0) result.signature += "+";
-            else result.signature += "-";
-            result.signature += String(fabs(vocSpike), 3) + "ppm";
+    if (within(rawGas, LPG_GAS_MIN, LPG_GAS_MAX)) {
+        result.vocDelta = dequantize(AXIS_VOC, voc) - vocBaseline;   // Reported only
+
+        if (haveVoc && !within(voc, _vocCarrierLo, _vocCarrierHi)) {
+            result.signature = SIG_DRUG_DELIVERY_IN_LPG;
             result.isThreat = true;
-            return result;
         } else {
-            result.signature = "LPG_CARRIER_ONLY_VOC:" + String(voc, 3);
+            result.signature = SIG_LPG_CARRIER_ONLY;
             result.isThreat = false;
-            return result;
         }
+        return;
     }
 
     // ===== FALLBACK: UNKNOWN ANALYSIS =====
-    if (iaq <= 65.0f && voc <= 1.2f && lowGasResistance) {
-        result.signature = "STEALTH_CONTAMINATION_GasRes:" + String(rawGas, 0) + "Ω";
+    if (haveIaq && haveVoc && iaq <= STEALTH_IAQ_MAX && voc <= STEALTH_VOC_MAX && lowGasResistance) {
+        result.signature = SIG_STEALTH_CONTAMINATION;
         result.isThreat = true;
     }
-    else if (iaq <= 55.0f && voc <= 0.6f && suspiciousGasResistance) {
-        result.signature = "MASKED_ATTACK_GasRes:" + String(rawGas, 0) + "Ω";
+    else if (haveIaq && haveVoc && iaq <= MASKED_IAQ_MAX && voc <= MASKED_VOC_MAX && suspiciousGasResistance) {
+        result.signature = SIG_MASKED_ATTACK;
         result.isThreat = true;
     }
-    else if (iaq <= 35.0f && voc <= 0.4f && rawGas > 45000.0f) {
-        result.signature = "Clean_Air_IAQ" + String(iaq, 0) + "_VOC" + String(voc, 2) + "ppm";
+    else if (haveIaq && haveVoc && iaq <= CLEAN_IAQ_MAX && voc <= CLEAN_VOC_MAX && rawGas > CLEAN_GAS) {
+        result.signature = SIG_CLEAN_AIR;
     }
     else {
-        result.signature = "UNKNOWN_ANALYSIS_IAQ" + String(iaq, 0) + "_VOC" + String(voc, 2) + "ppm";
+        result.signature = SIG_UNKNOWN_ANALYSIS;
         if (suspiciousGasResistance) result.isThreat = true;
     }
 
     if (lowGasResistance) {
         result.isThreat = true;
     }
+}
+#endif
+
+// ===== BATCH DETECTION =====
+// Window rules are applied column-wise to blocks of samples: for each rule
+// the per-axis loops are flat compare/AND passes over contiguous arrays,
+// which the compiler can vectorize. Rows no rule matched are then finished
+// by the same residual classifier detect() uses.
+void PollutionDetector::detectBatch(const float* iaq, const float* voc, const float* co2,
+                                    const float* temp, const float* humidity, const float* rawGas,
+                                    const float* pm1, const float* pm2_5, const float* pm10,
+                                    size_t count, SignatureId* out, bool* isThreat) {
+    (void)pm1;
+    (void)pm10;
+    const float* columns[AXIS_COUNT];
+    columns[AXIS_IAQ] = iaq;
+    columns[AXIS_VOC] = voc;
+    columns[AXIS_CO2] = co2;
+    columns[AXIS_TEMP] = temp;
+    columns[AXIS_HUMIDITY] = humidity;
+    columns[AXIS_RAW_GAS] = rawGas;
+    columns[AXIS_PM2_5] = pm2_5;
+
+    SignatureLease table;
+    const RuleIndex& rules = table->index;
+    const int numRules = table->numDetector;
+
+    for (size_t base = 0; base < count; base += BATCH_BLOCK) {
+        size_t n = min((size_t)BATCH_BLOCK, count - base);
+
+        // Gather the block with a fixed trip count so the rule loops below
+        // vectorize even at -O2; tail rows are padded with missing values
+        // (never match). This is also where the fixed-point build quantizes.
+        RuleValue block[AXIS_COUNT][BATCH_BLOCK];
+        for (int a = 0; a < AXIS_COUNT; a++) {
+            for (size_t i = 0; i < BATCH_BLOCK; i++) {
+                block[a][i] = (i < n) ? toRuleValue(a, columns[a][base + i]) : RULE_VALUE_MISSING;
+            }
+        }
+
+        uint8_t matched[BATCH_BLOCK];
+        uint8_t signature[BATCH_BLOCK];
+        for (size_t i = 0; i < BATCH_BLOCK; i++) {
+            matched[i] = 0;
+            signature[i] = SIG_NONE;
+        }
+
+        for (int r = 0; r < numRules; r++) {
+            uint8_t id = rules.id(r);
+            uint8_t care = rules.careAxes(r);
+
+            uint8_t hit[BATCH_BLOCK];
+            for (size_t i = 0; i < BATCH_BLOCK; i++) {
+                hit[i] = !matched[i];
+            }
+            for (int a = 0; a < AXIS_COUNT; a++) {
+                if (!(care & (1 << a))) continue;
+                const RuleValue* col = block[a];
+                const RuleValue lo = rules.minBound(r, (RuleAxis)a);
+                const RuleValue hi = rules.maxBound(r, (RuleAxis)a);
+                for (size_t i = 0; i < BATCH_BLOCK; i++) {
+                    hit[i] &= (uint8_t)((col[i] >= lo) & (col[i] <= hi));
+                }
+            }
+            for (size_t i = 0; i < BATCH_BLOCK; i++) {
+                signature[i] = hit[i] ? id : signature[i];
+                matched[i] |= hit[i];
+            }
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            size_t row = base + i;
+
+            if (matched[i]) {
+                out[row] = (SignatureId)signature[i];
+                if (isThreat) isThreat[row] = true;
+                continue;
+            }
+
+            DetectionResult result;
+            result.signature = SIG_NONE;
+            result.isThreat = false;
+            result.isSpike = false;
+            result.iaq = iaq[row];
+            result.voc = voc[row];
+            result.temp = temp[row];
+            result.humidity = humidity[row];
+            result.rawGas = rawGas[row];
+            result.pm2_5 = pm2_5[row];
+            result.vocDelta = 0.0f;
+            result.trend = 0.0f;
+            RuleValue values[AXIS_COUNT];
+            for (int a = 0; a < AXIS_COUNT; a++) values[a] = block[a][i];
+            classifyResidual(result, values);
+
+            out[row] = result.signature;
+            if (isThreat) isThreat[row] = result.isThreat;
+        }
+    }
+}
+
+// ===== SIGNATURE TEXT FORMATTING =====
 
+// Matches Arduino String(float, decimals): dtostrf() with width decimals + 2
+static void appendFloat(char* buf, size_t size, size_t& len, float value, int decimals) {
+    if (len >= size) return;
+    int n = snprintf(buf + len, size - len, "%*.*f", decimals + 2, decimals, value);
+    if (n > 0) len = min(len + (size_t)n, size - 1);
+}
+
+static void appendText(char* buf, size_t size, size_t& len, const char* text) {
+    if (len >= size) return;
+    int n = snprintf(buf + len, size - len, "%s", text);
+    if (n > 0) len = min(len + (size_t)n, size - 1);
+}
+
+const char* PollutionDetector::signatureName(SignatureId id) {
+    switch (id) {
+        case SIG_LETHAL_OPIOID_WEAPON:     return "LETHAL_OPIOID_WEAPON";
+        case SIG_CHEMICAL_WEAPON_COCKTAIL: return "CHEMICAL_WEAPON_COCKTAIL";
+        case SIG_NEUROTOXIN_ATTACK:        return "NEUROTOXIN_ATTACK";
+        case SIG_HEAVY_METAL_ATTACK:       return "HEAVY_METAL_ATTACK";
+        case SIG_ORGANOPHOSPHATE_ATTACK:   return "ORGANOPHOSPHATE_ATTACK";
+        case SIG_GASEOUS_CHEMICAL_WEAPON:  return "GASEOUS_CHEMICAL_WEAPON";
+        case SIG_OPIOID_ATTACK:            return "OPIOID_ATTACK";
+        case SIG_SCOPOLAMINE_DELIVERY:     return "SCOPOLAMINE_DELIVERY";
+        case SIG_BITTER_KNOCKOUT_DRUG:     return "BITTER_KNOCKOUT_DRUG";
+        case SIG_STEALTH_CHEMICAL:         return "STEALTH_CHEMICAL";
+        case SIG_IAQ_ANOMALY_NO_VOC:       return "IAQ_ANOMALY_NO_VOC";
+        case SIG_DRUG_DELIVERY_IN_LPG:     return "DRUG_DELIVERY_IN_LPG";
+        case SIG_LPG_CARRIER_ONLY:         return "LPG_CARRIER_ONLY";
+        case SIG_STEALTH_CONTAMINATION:    return "STEALTH_CONTAMINATION";
+        case SIG_MASKED_ATTACK:            return "MASKED_ATTACK";
+        case SIG_CLEAN_AIR:                return "Clean_Air";
+        case SIG_UNKNOWN_ANALYSIS:         return "UNKNOWN_ANALYSIS";
+        case SIG_DECREASING_VOC_PATTERN:   return "DECREASING_VOC_PATTERN";
+        case SIG_SIGNATURE_SWITCH_ATTACK:  return "SIGNATURE_SWITCH_ATTACK";
+        case SIG_CLIMATE_WEAPONIZATION:    return "CLIMATE_WEAPONIZATION";
+        default:                           return "NONE";
+    }
+}
+
+size_t PollutionDetector::formatSignature(const DetectionResult& r, char* buf, size_t size) {
+    if (size == 0) return 0;
+    size_t len = 0;
+    buf[0] = '\0';
+
+    switch (r.signature) {
+        case SIG_LETHAL_OPIOID_WEAPON:
+        case SIG_NEUROTOXIN_ATTACK:
+            appendText(buf, size, len, signatureName(r.signature));
+            appendText(buf, size, len, "_VOC:");  appendFloat(buf, size, len, r.voc, 3);
+            appendText(buf, size, len, "_IAQ:");  appendFloat(buf, size, len, r.iaq, 1);
+            appendText(buf, size, len, r.signature == SIG_LETHAL_OPIOID_WEAPON ? "_EVACUATE" : "_FOOT_TARGETING");
+            break;
+        case SIG_CHEMICAL_WEAPON_COCKTAIL:
+        case SIG_HEAVY_METAL_ATTACK:
+        case SIG_OPIOID_ATTACK:
+            appendText(buf, size, len, signatureName(r.signature));
+            appendText(buf, size, len, "_VOC:");  appendFloat(buf, size, len, r.voc, 3);
+            appendText(buf, size, len, "_IAQ:");  appendFloat(buf, size, len, r.iaq, 1);
+            appendText(buf, size, len, "_PM2.5:"); appendFloat(buf, size, len, r.pm2_5, 1);
+            break;
+        case SIG_ORGANOPHOSPHATE_ATTACK:
+            appendText(buf, size, len, "ORGANOPHOSPHATE_ATTACK_VOC:"); appendFloat(buf, size, len, r.voc, 3);
+            appendText(buf, size, len, "_IAQ:");  appendFloat(buf, size, len, r.iaq, 1);
+            appendText(buf, size, len, "_HUM:");  appendFloat(buf, size, len, r.humidity, 1);
+            break;
+        case SIG_GASEOUS_CHEMICAL_WEAPON:
+        case SIG_SCOPOLAMINE_DELIVERY:
+            appendText(buf, size, len, signatureName(r.signature));
+            appendText(buf, size, len, "_IAQ:");  appendFloat(buf, size, len, r.iaq, 1);
+            appendText(buf, size, len, "_VOC:");  appendFloat(buf, size, len, r.voc, 3);
+            appendText(buf, size, len, "_PM2.5:"); appendFloat(buf, size, len, r.pm2_5, 1);
+            break;
+        case SIG_BITTER_KNOCKOUT_DRUG:
+            appendText(buf, size, len, "BITTER_KNOCKOUT_DRUG_VOC:"); appendFloat(buf, size, len, r.voc, 3);
+            appendText(buf, size, len, "_IAQ:");  appendFloat(buf, size, len, r.iaq, 1);
+            break;
+        case SIG_STEALTH_CHEMICAL:
+            appendText(buf, size, len, "STEALTH_CHEMICAL_IAQ:"); appendFloat(buf, size, len, r.iaq, 1);
+            appendText(buf, size, len, "_HUM:");  appendFloat(buf, size, len, r.humidity, 1);
+            appendText(buf, size, len, "_TEMP:"); appendFloat(buf, size, len, r.temp, 1);
+            break;
+        case SIG_IAQ_ANOMALY_NO_VOC:
+            appendText(buf, size, len, "IAQ_ANOMALY_NO_VOC_IAQ:"); appendFloat(buf, size, len, r.iaq, 1);
+            appendText(buf, size, len, "_VOC:");  appendFloat(buf, size, len, r.voc, 3);
+            break;
+        case SIG_DRUG_DELIVERY_IN_LPG:
+            appendText(buf, size, len, r.vocDelta > 0 ? "DRUG_DELIVERY_IN_LPG_VOC+" : "DRUG_DELIVERY_IN_LPG_VOC-");
+            appendFloat(buf, size, len, fabs(r.vocDelta), 3);
+            appendText(buf, size, len, "ppm");
+            break;
+        case SIG_LPG_CARRIER_ONLY:
+            appendText(buf, size, len, "LPG_CARRIER_ONLY_VOC:"); appendFloat(buf, size, len, r.voc, 3);
+            break;
+        case SIG_STEALTH_CONTAMINATION:
+        case SIG_MASKED_ATTACK:
+            appendText(buf, size, len, r.signature == SIG_MASKED_ATTACK ? "MASKED_ATTACK_GasRes:" : "STEALTH_CONTAMINATION_GasRes:");
+            appendFloat(buf, size, len, r.rawGas, 0);
+            appendText(buf, size, len, "Ω");
+            break;
+        case SIG_CLEAN_AIR:
+        case SIG_UNKNOWN_ANALYSIS:
+            appendText(buf, size, len, r.signature == SIG_CLEAN_AIR ? "Clean_Air_IAQ" : "UNKNOWN_ANALYSIS_IAQ");
+            appendFloat(buf, size, len, r.iaq, 0);
+            appendText(buf, size, len, "_VOC");   appendFloat(buf, size, len, r.voc, 2);
+            appendText(buf, size, len, "ppm");
+            break;
+        case SIG_DECREASING_VOC_PATTERN:
+        case SIG_CLIMATE_WEAPONIZATION:
+            appendText(buf, size, len, signatureName(r.signature));
+            appendText(buf, size, len, "_SLOPE:"); appendFloat(buf, size, len, r.trend, 3);
+            appendText(buf, size, len, "/min");
+            break;
+        default:
+            appendText(buf, size, len, signatureName(r.signature));
+            break;
+    }
+    return len;
+}
+
+PollutionDetector::DetectionResult PollutionDetector::detect(const SensorSample& sample, bool inSpike) {
+    DetectionResult result = detect(sample.iaq, sample.voc, sample.co2, sample.temp, sample.humidity,
+                                    sample.rawGas, inSpike, sample.pm1_0, sample.pm2_5, sample.pm10_0);
+
+    // The window tracks the per-sample classification, before trend overrides,
+    // so a trend signature never feeds its own transition count
+    _temporal.push(sample, result.signature, result.isThreat);
+
+    bool windowRule = result.signature >= SIG_LETHAL_OPIOID_WEAPON && result.signature <= SIG_STEALTH_CHEMICAL;
+    if (!windowRule && !result.isThreat) {
+        classifyTemporal(result);
+    }
     return result;
 }
 
+bool PollutionDetector::classifyTemporal(DetectionResult& result) const {
+    const TemporalEngine& t = _temporal;
+    if (t.count() < TREND_MIN_SAMPLES || t.spanSeconds() < TREND_MIN_SPAN_S) return false;
+
+    for (int r = 0; r < NUM_TEMPORAL_RULES; r++) {
+        const TemporalRule& rule = TEMPORAL_RULES[r];
+        bool match = true;
+        float trend = 0.0f;
+        for (const TemporalTerm& term : rule.terms) {
+            float value;
+            switch (term.metric) {
+                case TEMPORAL_NONE:             continue;
+                case TEMPORAL_LEVEL:            value = t.latest((RuleAxis)term.axis); break;
+                case TEMPORAL_SLOPE:            value = trend = t.slope((RuleAxis)term.axis); break;
+                case TEMPORAL_RATE:             value = trend = t.rate((RuleAxis)term.axis); break;
+                case TEMPORAL_TRANSITIONS:      value = t.transitions(); break;
+                case TEMPORAL_DISTINCT_THREATS: value = t.distinctThreats(); break;
+                default:                        value = NAN; break;
+            }
+            // NAN fails every comparison, so missing data never matches
+            if (!(value >= term.range.min && value <= term.range.max)) {
+                match = false;
+                break;
+            }
+        }
+        if (match) {
+            result.signature = (SignatureId)rule.id;
+            result.isThreat = true;
+            result.trend = trend;
+            return true;
+        }
+    }
+
+    // CLIMATE WEAPONIZATION: sustained temperature or humidity swing
+    float tempRate = t.slope(AXIS_TEMP);
+    float humidityRate = t.slope(AXIS_HUMIDITY);
+    if (detectClimateWeaponization(isnan(tempRate) ? 0.0f : tempRate,
+                                   isnan(humidityRate) ? 0.0f : humidityRate)) {
+        result.signature = SIG_CLIMATE_WEAPONIZATION;
+        result.isThreat = true;
+        result.trend = fabs(tempRate) > 0.08f ? tempRate : humidityRate;
+        return true;
+    }
+    return false;
+}
+
+void PollutionDetector::updateBaseline(const SensorSample& sample, bool inSpike) {
+    _baseline.update(sample, inSpike);
+}
+
 bool PollutionDetector::isSpike(float currentValue, float baselineValue, float threshold) const {
     return (currentValue - baselineValue) > threshold;
 }
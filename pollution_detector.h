@@ -3,38 +3,95 @@
 
 #include <Arduino.h>
 #include "pollution_signatures.h"
+#include "rule_index.h"
+#include "baseline_service.h"
+#include "temporal_engine.h"
+#include "sensor_sample.h"
 
 class PollutionDetector {
 public:
-    // Detection results structure
+    // Detection results structure - no heap, text is rendered on demand
     struct DetectionResult {
-        String signature;
+        SignatureId signature;
         bool isThreat;
         bool isSpike;
+        // Values the signature text is built from
+        float iaq, voc, temp, humidity, rawGas, pm2_5;
+        float vocDelta; // VOC minus baseline (LPG branch only)
+        float trend;    // Triggering slope per minute (trend signatures only)
     };
 
+    // Big enough for the longest rendered signature
+    static const size_t SIGNATURE_TEXT_MAX = 96;
+
     // Initialize detector with sensitivity thresholds
     PollutionDetector(float iaqThreshold = 10.0f, 
                      float vocThreshold = 0.05f, 
                      float co2Threshold = 50.0f,
                      float pm25Threshold = 25.0f);
 
+    // Allocates the baseline windows and compiles the built-in signature
+    // table (PSRAM when present). Call before the first sample.
+    bool begin();
+
     // Detect pollution patterns - UPDATED with particulate parameters
     DetectionResult detect(float iaq, float voc, float co2, float temp, 
                           float humidity, float rawGas, bool inSpike,
                           float pm1 = NAN, float pm2_5 = NAN, float pm10 = NAN);
 
+    // Streaming detection: classifies the sample, adds it to the temporal
+    // window, then lets trend rules claim it if it was not already a threat.
+    // Call once per sample, after updateBaseline().
+    DetectionResult detect(const SensorSample& sample, bool inSpike);
+
+    // Classify a buffer of samples given as column arrays. Writes one
+    // SignatureId per row (and optionally isThreat), identical to calling
+    // detect() on each row. pm1/pm10 are unused and may be null.
+    void detectBatch(const float* iaq, const float* voc, const float* co2,
+                     const float* temp, const float* humidity, const float* rawGas,
+                     const float* pm1, const float* pm2_5, const float* pm10,
+                     size_t count, SignatureId* out, bool* isThreat = nullptr);
+
+    // Feed the shared baseline service; call once per sample before detect()
+    void updateBaseline(const SensorSample& sample, bool inSpike);
+    const BaselineService& baseline() const { return _baseline; }
+    BaselineService& baseline() { return _baseline; }  // Snapshot restore only
+    const TemporalEngine& temporal() const { return _temporal; }
+
     // Spike detection
     bool isSpike(float currentValue, float baselineValue, float threshold) const;
 
+    // Render the signature text (same format the old String results used).
+    // Returns the number of characters written, excluding the terminator.
+    static size_t formatSignature(const DetectionResult& result, char* buf, size_t size);
+
+    // Bare signature name without the measured values
+    static const char* signatureName(SignatureId id);
+
     // Update detection thresholds
     void setThresholds(float iaq, float voc, float co2, float pm25);
 
 private:
+    // Rows per column-wise pass in detectBatch()
+    static const int BATCH_BLOCK = 64;
+
+    // Sample in kernel units (toRuleValue()), as the window rules saw it
+    void classifyResidual(DetectionResult& result, const RuleValue* sample) const;
+    bool classifyTemporal(DetectionResult& result) const;
+
     float _iaqThreshold;
     float _vocThreshold;
     float _co2Threshold;
     float _pm25Threshold;
+    BaselineService _baseline;
+    TemporalEngine _temporal;
+
+#ifdef DETECTOR_FIXED_POINT
+    // VOC steps near the EMA baseline, recomputed when the EMA steps
+    mutable float _vocWindowBaseline = NAN;
+    mutable RuleValue _vocSteadyLo = 1, _vocSteadyHi = 0;    // |voc - baseline| < 0.010
+    mutable RuleValue _vocCarrierLo = 1, _vocCarrierHi = 0;  // |voc - baseline| < 0.005
+#endif
 };
 
 #endif
\ No newline at end of file
@@ -1,81 +1,242 @@
 // Enhanced pollution_signatures.cpp with your specific stealth drug patterns
 #include "pollution_signatures.h"
+#include "fixed_point.h"
+#include <new>
+#include <esp_heap_caps.h>
 
 // Enhanced pollution signatures based on your stealth drug delivery observations
-static const PollutionPattern signatures[] = {
+static constexpr PollutionPattern signatures[] = {
+    // name                       signature                     pri  IAQ             VOC               CO2           Temp            Humidity        RawGas              PM2.5
+    // DETECTOR RULES: detect() tests these before its baseline-relative rules
+    {"LETHAL_OPIOID_WEAPON",      SIG_LETHAL_OPIOID_WEAPON,      1, {{70.0f, 80.0f}, {0.60f, 0.70f},   RULE_ANY,     RULE_ANY,       RULE_ANY,       RULE_ANY,           {20.0f, 30.0f}   }, "Lethal opioid weapon: evacuate", true},
+    {"CHEMICAL_WEAPON_COCKTAIL",  SIG_CHEMICAL_WEAPON_COCKTAIL,  2, {{60.0f, 70.0f}, {0.55f, 0.65f},   RULE_ANY,     RULE_ANY,       RULE_ANY,       RULE_ANY,           {22.0f, 32.0f}   }, "Chemical weapon cocktail", true},
+    {"NEUROTOXIN_ATTACK",         SIG_NEUROTOXIN_ATTACK,         3, {{54.0f, 62.0f}, {0.52f, 0.58f},   RULE_ANY,     RULE_ANY,       {76.0f, 82.0f}, RULE_ANY,           {25.0f, 35.0f}   }, "Neurotoxin: foot targeting", true},
+    {"HEAVY_METAL_ATTACK",        SIG_HEAVY_METAL_ATTACK,        4, {{54.0f, 62.0f}, {0.53f, 0.58f},   RULE_ANY,     RULE_ANY,       RULE_ANY,       RULE_ANY,           {25.0f, 35.0f}   }, "Heavy metals (Thallium, Arsenic)", true},
+    {"ORGANOPHOSPHATE_ATTACK",    SIG_ORGANOPHOSPHATE_ATTACK,    5, {{53.0f, 61.0f}, {0.52f, 0.57f},   RULE_ANY,     RULE_ANY,       {76.0f, 83.0f}, RULE_ANY,           RULE_ANY         }, "Organophosphates (Sarin, VX analogs)", true},
+    {"GASEOUS_CHEMICAL_WEAPON",   SIG_GASEOUS_CHEMICAL_WEAPON,   6, {{55.0f, 70.0f}, {0.5f, 0.7f},     RULE_ANY,     RULE_ANY,       {75.0f, 85.0f}, RULE_ANY,           {-INFINITY, 2.0f}}, "Gaseous weapon: no particles", true},
+    {"OPIOID_ATTACK",             SIG_OPIOID_ATTACK,             7, {{65.0f, 75.0f}, {0.58f, 0.68f},   RULE_ANY,     RULE_ANY,       RULE_ANY,       RULE_ANY,           {20.0f, 30.0f}   }, "Opioids (Fentanyl, Carfentanil)", true},
+    {"SCOPOLAMINE_DELIVERY",      SIG_SCOPOLAMINE_DELIVERY,      8, {{49.5f, 55.5f}, {0.495f, 0.515f}, RULE_ANY,     {29.0f, 32.0f}, {78.0f, 84.0f}, RULE_ANY,           {2.0f, 9.0f}     }, "Scopolamine: very specific window", true},
+    {"BITTER_KNOCKOUT_DRUG",      SIG_BITTER_KNOCKOUT_DRUG,      9, {{50.0f, 58.0f}, {0.50f, 0.55f},   RULE_ANY,     RULE_ANY,       RULE_ANY,       {5595.0f, 5605.0f}, RULE_ANY         }, "Bitter knockout drug, LPG gas window", true},
+    {"STEALTH_CHEMICAL",          SIG_STEALTH_CHEMICAL,         10, {{45.0f, 85.0f}, RULE_ANY,         RULE_ANY,     {28.0f, 35.0f}, {70.0f, 90.0f}, {5580.0f, 5620.0f}, RULE_ANY         }, "Stealth chemical: warm, humid, LPG-like gas", true},
+
     // PRIORITY 0: YOUR SPECIFIC STEALTH DRUG PATTERN (Highest priority)
-    {"BITTER_TASTE_STEALTH_DRUG",  0, 180, 200, 2.5f,  8.0f, 1250, 1750, 28.0f, 29.5f, "Bitter taste drug: Decreasing VOC + high humidity", true},
-    {"MICRO_DOSE_DELIVERY",        0, 175, 205, 2.8f,  7.7f, 1200, 1800, 28.0f, 29.0f, "Micro-dosing: Your exact pattern match", true},
-    {"AEROSOL_BITTER_COMPOUND",    0, 180, 200, 3.0f,  6.0f, 1250, 1600, 28.2f, 29.2f, "Aerosolized bitter compound", true},
-    {"STEALTH_SEDATIVE_SPRAY",     0, 182, 198, 2.9f,  5.5f, 1260, 1550, 28.3f, 29.1f, "Stealth sedative aerosol", true},
-    
+    {"BITTER_TASTE_STEALTH_DRUG", SIG_NONE,                      0, {{180, 200},     {2.5f, 8.0f},     {1250, 1750}, {28.0f, 29.5f}, RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Bitter taste drug: Decreasing VOC + high humidity", true},
+    {"MICRO_DOSE_DELIVERY",       SIG_NONE,                      0, {{175, 205},     {2.8f, 7.7f},     {1200, 1800}, {28.0f, 29.0f}, RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Micro-dosing: Your exact pattern match", true},
+    {"AEROSOL_BITTER_COMPOUND",   SIG_NONE,                      0, {{180, 200},     {3.0f, 6.0f},     {1250, 1600}, {28.2f, 29.2f}, RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Aerosolized bitter compound", true},
+    {"STEALTH_SEDATIVE_SPRAY",    SIG_NONE,                      0, {{182, 198},     {2.9f, 5.5f},     {1260, 1550}, {28.3f, 29.1f}, RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Stealth sedative aerosol", true},
+
     // PRIORITY 1: CHEMICAL WARFARE AGENTS (Enhanced with your observations)
-    {"Organophosphate_VX",         1, 150, 400, 0.01f, 0.5f,  350,  700, 20, 40, "VX/Sarin: Low VOC + extreme IAQ", true},
-    {"Carbamate_Attack",           1, 120, 350, 0.05f, 0.8f,  300,  600, 20, 35, "Carbamate: Low VOC + high IAQ", true},
-    {"Pulmonary_Weapon",           1,  50,  90, 0.5f,  1.5f,  500,  900, 15, 25, "Lung-targeting aerosol", true},
-    {"Opioid_Aerosol",             1,  60,  80, 0.01f, 0.3f,  400,  600, 18, 25, "Fentanyl/CA", true},
-    {"Stealth_Maintenance_Dose",   1,  50,  70, 0.3f,  0.7f,  500,  700, 20, 40, "Post-spike low-dose drugs", true},  
-    {"Signature_Switch_Attack",    1,   0,   0, 0,     0,      0,    0,  0,  0, "Rapid signature switching", true},
-    {"Stealth_Drug_Delivery",      1,  45,  55, 0.3f,  0.6f,  450,  550, 20, 40, "Ultra-low VOC knockout drugs", true},
-    {"Chemical_Torture",           1,  70,  90, 0.7f,  1.2f,  700,  900, 20, 40, "Low-dose discomfort cocktail", true},
-    {"Aerosol_Persistence",        2,   0,   0, 0.5f,  1.5f,   0,    0,  0,  0, "Lingering microdroplets", true},
-    {"Bitter_Solvent",             1,  70,  90, 0.8f,  1.5f,  700,  900, 20, 40, "GHB/Benzo bitter taste", true},
-    {"Aerosol_Spray",              1,  60, 100, 1.0f,  3.0f,  800, 1200, 18, 35, "Ultrafine drug particles", true},
-    {"Chemical_Weapon",            1, 100, 300, 0.01f, 0.5f,  400,  800, 15, 30, "Chemical warfare agent", true},
-    {"Tear_Gas",                   1,  80, 200, 0.5f,  2.0f,  500, 1000, 20, 40, "Riot control agent", true},
-    {"Nerve_Gas",                  1, 150, 400, 0.01f, 0.5f,  350,  700, 20, 40, "Nerve agent exposure", true},
-    {"EA_2277",                    1, 130, 170, 1.2f,  1.8f,  900, 1100, 15, 25, "BZ-series incapacitant", true},
-    
+    {"Organophosphate_VX",        SIG_NONE,                      1, {{150, 400},     {0.01f, 0.5f},    {350, 700},   {20, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "VX/Sarin: Low VOC + extreme IAQ", true},
+    {"Carbamate_Attack",          SIG_NONE,                      1, {{120, 350},     {0.05f, 0.8f},    {300, 600},   {20, 35},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Carbamate: Low VOC + high IAQ", true},
+    {"Pulmonary_Weapon",          SIG_NONE,                      1, {{50, 90},       {0.5f, 1.5f},     {500, 900},   {15, 25},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Lung-targeting aerosol", true},
+    {"Opioid_Aerosol",            SIG_NONE,                      1, {{60, 80},       {0.01f, 0.3f},    {400, 600},   {18, 25},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Fentanyl/CA", true},
+    {"Stealth_Maintenance_Dose",  SIG_NONE,                      1, {{50, 70},       {0.3f, 0.7f},     {500, 700},   {20, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Post-spike low-dose drugs", true},
+    {"Signature_Switch_Attack",   SIG_SIGNATURE_SWITCH_ATTACK,   1, {RULE_ANY,       RULE_ANY,         RULE_ANY,     RULE_ANY,       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Rapid signature switching", true},
+    {"Stealth_Drug_Delivery",     SIG_NONE,                      1, {{45, 55},       {0.3f, 0.6f},     {450, 550},   {20, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Ultra-low VOC knockout drugs", true},
+    {"Chemical_Torture",          SIG_NONE,                      1, {{70, 90},       {0.7f, 1.2f},     {700, 900},   {20, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Low-dose discomfort cocktail", true},
+    {"Aerosol_Persistence",       SIG_NONE,                      2, {RULE_ANY,       {0.5f, 1.5f},     RULE_ANY,     RULE_ANY,       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Lingering microdroplets", true},
+    {"Bitter_Solvent",            SIG_NONE,                      1, {{70, 90},       {0.8f, 1.5f},     {700, 900},   {20, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "GHB/Benzo bitter taste", true},
+    {"Aerosol_Spray",             SIG_NONE,                      1, {{60, 100},      {1.0f, 3.0f},     {800, 1200},  {18, 35},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Ultrafine drug particles", true},
+    {"Chemical_Weapon",           SIG_NONE,                      1, {{100, 300},     {0.01f, 0.5f},    {400, 800},   {15, 30},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Chemical warfare agent", true},
+    {"Tear_Gas",                  SIG_NONE,                      1, {{80, 200},      {0.5f, 2.0f},     {500, 1000},  {20, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Riot control agent", true},
+    {"Nerve_Gas",                 SIG_NONE,                      1, {{150, 400},     {0.01f, 0.5f},    {350, 700},   {20, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Nerve agent exposure", true},
+    {"EA_2277",                   SIG_NONE,                      1, {{130, 170},     {1.2f, 1.8f},     {900, 1100},  {15, 25},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "BZ-series incapacitant", true},
+
     // PRIORITY 2: KNOCKOUT/INCAPACITATING AGENTS (Enhanced)
-    {"Chloroform_Knockout",        2,  60, 120, 5.0f, 20.0f,  400,  800, 15, 30, "Chloroform: High VOC + moderate IAQ", true},
-    {"GHB_Evaporation",            2,  50, 100, 3.0f, 15.0f,  500,  900, 20, 35, "GHB: High VOC + sweet signature", true},
-    {"Benzodiazepine_Spike",       2,  55, 110, 2.5f, 12.0f,  450,  850, 18, 32, "Roofies: Medium VOC + temp drop", true},
-    {"Ether_Dousing",              2,  70, 150, 8.0f, 25.0f,  300,  600, 10, 25, "Ether: Extreme VOC + cold spot", true},
-    {"Scopolamine_Dart",           2,  90, 180, 1.5f,  6.0f,  350,  700, 22, 38, "Devil's Breath: Medium VOC", true},
-    {"Mace_Spray",                 2, 100, 200, 0.8f,  3.5f,  400,  750, 20, 40, "Self-defense spray: Sharp VOC spike", true},
-    {"Aerosolized_Drug",           2,  40, 100, 0.1f,  1.5f,  500, 1000, 15, 40, "Aerosolized drug delivery: Low VOC", true},
-    {"Fentanyl_Powder",            2,  80, 160, 0.05f, 0.3f,  600, 1200, 25, 45, "Fentanyl powder: Low VOC + high IAQ", true},
-    {"Synthetic_Cannabinoid",      2,  70, 140, 0.1f,  0.5f,  550, 1100, 20, 40, "Synthetic cannabinoid: Low VOC", true},
-    {"Psychedelic_Spray",          2,  60, 130, 0.2f,  1.0f,  500, 1000, 18, 35, "Psychedelic aerosol: Low-medium VOC", true},
-    {"Inhalant_Exposure",          2,  50, 120, 0.3f,  1.5f,  450,  900, 15, 30, "Inhalant abuse: Low-medium VOC", true},
-    {"Anesthetic_Spray",           2,  40, 100, 0.4f,  2.0f,  500,  950, 20, 35, "Anesthetic gas: Low-medium VOC", true},
-    {"Chemical_Harassment",        2,  30,  80, 0.2f,  1.0f,  400,  800, 15, 30, "Chemical harassment: Low VOC", true},
-    
+    {"Chloroform_Knockout",       SIG_NONE,                      2, {{60, 120},      {5.0f, 20.0f},    {400, 800},   {15, 30},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Chloroform: High VOC + moderate IAQ", true},
+    {"GHB_Evaporation",           SIG_NONE,                      2, {{50, 100},      {3.0f, 15.0f},    {500, 900},   {20, 35},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "GHB: High VOC + sweet signature", true},
+    {"Benzodiazepine_Spike",      SIG_NONE,                      2, {{55, 110},      {2.5f, 12.0f},    {450, 850},   {18, 32},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Roofies: Medium VOC + temp drop", true},
+    {"Ether_Dousing",             SIG_NONE,                      2, {{70, 150},      {8.0f, 25.0f},    {300, 600},   {10, 25},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Ether: Extreme VOC + cold spot", true},
+    {"Scopolamine_Dart",          SIG_NONE,                      2, {{90, 180},      {1.5f, 6.0f},     {350, 700},   {22, 38},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Devil's Breath: Medium VOC", true},
+    {"Mace_Spray",                SIG_NONE,                      2, {{100, 200},     {0.8f, 3.5f},     {400, 750},   {20, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Self-defense spray: Sharp VOC spike", true},
+    {"Aerosolized_Drug",          SIG_NONE,                      2, {{40, 100},      {0.1f, 1.5f},     {500, 1000},  {15, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Aerosolized drug delivery: Low VOC", true},
+    {"Fentanyl_Powder",           SIG_NONE,                      2, {{80, 160},      {0.05f, 0.3f},    {600, 1200},  {25, 45},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Fentanyl powder: Low VOC + high IAQ", true},
+    {"Synthetic_Cannabinoid",     SIG_NONE,                      2, {{70, 140},      {0.1f, 0.5f},     {550, 1100},  {20, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Synthetic cannabinoid: Low VOC", true},
+    {"Psychedelic_Spray",         SIG_NONE,                      2, {{60, 130},      {0.2f, 1.0f},     {500, 1000},  {18, 35},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Psychedelic aerosol: Low-medium VOC", true},
+    {"Inhalant_Exposure",         SIG_NONE,                      2, {{50, 120},      {0.3f, 1.5f},     {450, 900},   {15, 30},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Inhalant abuse: Low-medium VOC", true},
+    {"Anesthetic_Spray",          SIG_NONE,                      2, {{40, 100},      {0.4f, 2.0f},     {500, 950},   {20, 35},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Anesthetic gas: Low-medium VOC", true},
+    {"Chemical_Harassment",       SIG_NONE,                      2, {{30, 80},       {0.2f, 1.0f},     {400, 800},   {15, 30},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Chemical harassment: Low VOC", true},
+
     // PRIORITY 3: STEALTH DELIVERY PATTERNS (New category based on your data)
-    {"HIGH_HUMIDITY_DELIVERY",     3, 175, 220, 2.0f,  8.0f, 1200, 1800, 27, 30, "High humidity aerosol delivery", true},
-    {"CONSISTENT_GAS_RESISTANCE",  3, 170, 210, 2.5f,  8.5f, 1220, 1750, 28, 29, "Artificial gas resistance signature", true},
-    {"TEMP_CONTROLLED_RELEASE",    3, 180, 200, 3.0f,  7.0f, 1250, 1600, 28.2f, 28.8f, "Temperature-controlled drug release", true},
-    {"DECREASING_VOC_PATTERN",     3, 175, 205, 2.0f,  9.0f, 1200, 1800, 27, 30, "Systematically decreasing VOC", true},
-    
+    {"HIGH_HUMIDITY_DELIVERY",    SIG_NONE,                      3, {{175, 220},     {2.0f, 8.0f},     {1200, 1800}, {27, 30},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "High humidity aerosol delivery", true},
+    {"CONSISTENT_GAS_RESISTANCE", SIG_NONE,                      3, {{170, 210},     {2.5f, 8.5f},     {1220, 1750}, {28, 29},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Artificial gas resistance signature", true},
+    {"TEMP_CONTROLLED_RELEASE",   SIG_NONE,                      3, {{180, 200},     {3.0f, 7.0f},     {1250, 1600}, {28.2f, 28.8f}, RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Temperature-controlled drug release", true},
+    {"DECREASING_VOC_PATTERN",    SIG_NONE,                      3, {{175, 205},     {2.0f, 9.0f},     {1200, 1800}, {27, 30},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Systematically decreasing VOC", true},
+
     // PRIORITY 4: INDUSTRIAL/CHEMICAL SOURCES
-    {"Heavy_Industrial",           4,  80, 200, 2.0f,  8.0f,  400,  800, 15, 40, "Heavy industry: Medium-high VOC", false},
-    {"Chemical_Plant",             4,  70, 150, 1.5f,  6.0f,  350,  700, 18, 38, "Chemical plant: Medium VOC", false},
-    {"KEROSENE_STOVE",             4,  60, 140, 10.0f,50.0f,  800, 2000, 25, 45, "Kerosene masking", false},
-    {"INCENSE_SMOKE",              4,  50, 120, 8.0f, 40.0f,  600, 1800, 22, 42, "Incense masking", false},
-    {"MOTOR_EXHAUST",              4,  70, 150, 15.0f,60.0f,  900, 2500, 30, 50, "Engine exhaust masking", false},
-    {"SOLVENT_DUMP",               4,  80, 200, 8.0f, 30.0f,  500, 1200, 18, 40, "Intentional solvent release", true},
-    
+    {"Heavy_Industrial",          SIG_NONE,                      4, {{80, 200},      {2.0f, 8.0f},     {400, 800},   {15, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Heavy industry: Medium-high VOC", false},
+    {"Chemical_Plant",            SIG_NONE,                      4, {{70, 150},      {1.5f, 6.0f},     {350, 700},   {18, 38},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Chemical plant: Medium VOC", false},
+    {"KEROSENE_STOVE",            SIG_NONE,                      4, {{60, 140},      {10.0f, 50.0f},   {800, 2000},  {25, 45},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Kerosene masking", false},
+    {"INCENSE_SMOKE",             SIG_NONE,                      4, {{50, 120},      {8.0f, 40.0f},    {600, 1800},  {22, 42},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Incense masking", false},
+    {"MOTOR_EXHAUST",             SIG_NONE,                      4, {{70, 150},      {15.0f, 60.0f},   {900, 2500},  {30, 50},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Engine exhaust masking", false},
+    {"SOLVENT_DUMP",              SIG_NONE,                      4, {{80, 200},      {8.0f, 30.0f},    {500, 1200},  {18, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Intentional solvent release", true},
+
     // PRIORITY 5: COMMON URBAN POLLUTION (Lowest priority)
-    {"Clean_Air",                  5,   0,  50, 0.0f,  0.5f,  400,  600, 20, 30, "Clean air: Low VOC + low CO2", false},
-    {"Moderate_Air",               5,  50, 100, 0.5f,  1.0f,  600,  800, 22, 35, "Moderate air: Medium VOC + CO2", false},
-    {"Unhealthy_Air",              5, 100, 150, 1.0f,  2.0f,  800, 1000, 25, 40, "Unhealthy air: High VOC + CO2", false},
-    {"Industrial_Pollution",       5, 150, 250, 2.0f,  5.0f,  900, 1200, 28, 45, "Industrial: High VOC + CO2", false},
-    {"Vehicle_Exhaust",            5, 200, 300, 3.0f,  6.0f, 1000, 1500, 30, 50, "Vehicle exhaust: Very high VOC + CO2", false},
-    {"Household_Pesticides",       5,  60, 180, 1.0f,  3.0f,  700, 1200, 22, 42, "Household pesticides: Medium-high VOC + CO2", false},
-    {"Construction_Dust",          5, 100, 200, 1.5f,  3.5f,  700, 1300, 25, 45, "Construction: Medium-high VOC + CO2", false},
-    {"Household_Cleaners",         5,  50, 150, 0.5f,  2.5f,  600, 1100, 20, 40, "Household cleaners: Medium VOC + CO2", false},
-    {"Cigarette_Smoke",            5,  80, 180, 1.0f,  4.0f,  700, 1300, 22, 42, "Cigarette smoke: Medium-high VOC + CO2", false},
-    {"Cooking_Fumes",              5,  60, 160, 0.8f,  3.0f,  650, 1200, 20, 38, "Cooking: Medium VOC + CO2", false},
-    {"Traffic_Mimicry",            5,  40, 100, 0.5f,  2.0f,  600, 1200, 25, 45, "Traffic: Low-medium VOC + high CO2", false},
-    {"Gas_Stove",                  5,  70, 150, 1.5f,  4.0f,  700, 1300, 22, 40, "Gas stove: Medium VOC + CO2", false},
-    {"Paint_Vapors",               5,  50, 120, 0.5f,  2.0f,  600, 1100, 20, 35, "Paint: Low-medium VOC + CO2", false},
-    {"Diesel_Exhaust",             5,  60, 120, 0.8f,  3.0f,  800, 1400, 28, 50, "Diesel: Medium VOC + very high CO2", false}
+    {"Clean_Air",                 SIG_NONE,                      5, {{0, 50},        {0.0f, 0.5f},     {400, 600},   {20, 30},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Clean air: Low VOC + low CO2", false},
+    {"Moderate_Air",              SIG_NONE,                      5, {{50, 100},      {0.5f, 1.0f},     {600, 800},   {22, 35},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Moderate air: Medium VOC + CO2", false},
+    {"Unhealthy_Air",             SIG_NONE,                      5, {{100, 150},     {1.0f, 2.0f},     {800, 1000},  {25, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Unhealthy air: High VOC + CO2", false},
+    {"Industrial_Pollution",      SIG_NONE,                      5, {{150, 250},     {2.0f, 5.0f},     {900, 1200},  {28, 45},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Industrial: High VOC + CO2", false},
+    {"Vehicle_Exhaust",           SIG_NONE,                      5, {{200, 300},     {3.0f, 6.0f},     {1000, 1500}, {30, 50},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Vehicle exhaust: Very high VOC + CO2", false},
+    {"Household_Pesticides",      SIG_NONE,                      5, {{60, 180},      {1.0f, 3.0f},     {700, 1200},  {22, 42},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Household pesticides: Medium-high VOC + CO2", false},
+    {"Construction_Dust",         SIG_NONE,                      5, {{100, 200},     {1.5f, 3.5f},     {700, 1300},  {25, 45},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Construction: Medium-high VOC + CO2", false},
+    {"Household_Cleaners",        SIG_NONE,                      5, {{50, 150},      {0.5f, 2.5f},     {600, 1100},  {20, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Household cleaners: Medium VOC + CO2", false},
+    {"Cigarette_Smoke",           SIG_NONE,                      5, {{80, 180},      {1.0f, 4.0f},     {700, 1300},  {22, 42},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Cigarette smoke: Medium-high VOC + CO2", false},
+    {"Cooking_Fumes",             SIG_NONE,                      5, {{60, 160},      {0.8f, 3.0f},     {650, 1200},  {20, 38},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Cooking: Medium VOC + CO2", false},
+    {"Traffic_Mimicry",           SIG_NONE,                      5, {{40, 100},      {0.5f, 2.0f},     {600, 1200},  {25, 45},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Traffic: Low-medium VOC + high CO2", false},
+    {"Gas_Stove",                 SIG_NONE,                      5, {{70, 150},      {1.5f, 4.0f},     {700, 1300},  {22, 40},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Gas stove: Medium VOC + CO2", false},
+    {"Paint_Vapors",              SIG_NONE,                      5, {{50, 120},      {0.5f, 2.0f},     {600, 1100},  {20, 35},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Paint: Low-medium VOC + CO2", false},
+    {"Diesel_Exhaust",            SIG_NONE,                      5, {{60, 120},      {0.8f, 3.0f},     {800, 1400},  {28, 50},       RULE_ANY,       RULE_ANY,           RULE_ANY         }, "Diesel: Medium VOC + very high CO2", false}
 };
 
+static constexpr int NUM_SIGNATURES = sizeof(signatures) / sizeof(signatures[0]);
+
+// ===== COMPILED MATCHING ENGINE =====
+// detect() rules first in priority order, then the context patterns
+// stable-sorted by priority, so the lowest matching index in either range
+// is the best-priority row. Trend rows are not window rules and stay out.
+static constexpr bool isDetectorSignature(uint8_t id) {
+    return id >= SIG_LETHAL_OPIOID_WEAPON && id <= SIG_STEALTH_CHEMICAL;
+}
+
+static void appendByPriority(const PollutionPattern* rows, int numRows,
+                             WindowRule* rules, int& count, bool detector) {
+    int first = count;
+    for (int i = 0; i < numRows; i++) {
+        const PollutionPattern& p = rows[i];
+        if (detector ? !isDetectorSignature(p.signature) : p.signature != SIG_NONE) continue;
+
+        // Insertion sort keeps table order within a priority level
+        int j = count++;
+        while (j > first && rows[rules[j - 1].id].priority > p.priority) {
+            rules[j] = rules[j - 1];
+            j--;
+        }
+        rules[j].id = (uint8_t)i;
+        for (int a = 0; a < AXIS_COUNT; a++) {
+            rules[j].range[a] = p.range[a];
+        }
+    }
+}
+
+bool SignatureSet::compile(const PollutionPattern* rows, int count, uint32_t tableVersion) {
+    static WindowRule rules[RuleIndex::MAX_RULES];
+    if (count > RuleIndex::MAX_RULES) return false;
+
+    int n = 0;
+    appendByPriority(rows, count, rules, n, true);
+    int detector = n;
+    appendByPriority(rows, count, rules, n, false);
+
+    // Detector ids report the signature, context ids stay table rows
+    for (int k = 0; k < detector; k++) {
+        rules[k].id = rows[rules[k].id].signature;
+    }
+    if (!index.build(rules, n)) return false;
+
+    numDetector = detector;
+    patterns = rows;
+    numPatterns = count;
+    version = tableVersion;
+    return true;
+}
+
+SignatureSet* SignatureSet::create() {
+    void* set = heap_caps_aligned_alloc(alignof(SignatureSet), sizeof(SignatureSet), MALLOC_CAP_SPIRAM);
+    if (set == nullptr) {   // No PSRAM
+        set = heap_caps_aligned_alloc(alignof(SignatureSet), sizeof(SignatureSet),
+                                      MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    return set ? new (set) SignatureSet() : nullptr;
+}
+
+void SignatureSet::destroy(SignatureSet* set) {
+    if (set == nullptr) return;
+    set->~SignatureSet();
+    heap_caps_free(set);
+}
+
+int SignatureSet::match(const SensorSample& sample) const {
+    RuleValue values[AXIS_COUNT];
+    values[AXIS_IAQ] = toRuleValue(AXIS_IAQ, sample.iaq);
+    values[AXIS_VOC] = toRuleValue(AXIS_VOC, sample.voc);
+    values[AXIS_CO2] = toRuleValue(AXIS_CO2, sample.co2);
+    values[AXIS_TEMP] = toRuleValue(AXIS_TEMP, sample.temp);
+    values[AXIS_HUMIDITY] = toRuleValue(AXIS_HUMIDITY, sample.humidity);
+    values[AXIS_RAW_GAS] = toRuleValue(AXIS_RAW_GAS, sample.rawGas);
+    values[AXIS_PM2_5] = toRuleValue(AXIS_PM2_5, sample.pm2_5);
+
+    int rule = index.firstMatch(values, numDetector, index.numRules());
+    return rule >= 0 ? index.id(rule) : -1;
+}
+
+static_assert(NUM_SIGNATURES <= RuleIndex::MAX_RULES, "Signature table exceeds RuleIndex capacity");
+
+// Every finite built-in bound must sit exactly on the fixed-point grid, so
+// the fixed build classifies with the same thresholds the table states
+static constexpr bool onFixedGrid(const PollutionPattern* rows, int count) {
+    for (int i = 0; i < count; i++) {
+        for (int a = 0; a < AXIS_COUNT; a++) {
+            const RuleRange& r = rows[i].range[a];
+            if (!isinf(r.min) && dequantize(a, quantize(a, r.min)) != r.min) return false;
+            if (!isinf(r.max) && dequantize(a, quantize(a, r.max)) != r.max) return false;
+        }
+    }
+    return true;
+}
+static_assert(onFixedGrid(signatures, NUM_SIGNATURES), "Built-in bound finer than AXIS_SCALE");
+
+// Allocated and compiled by begin(); active until a pushed table is published
+static SignatureSet* builtinSet = nullptr;
+static std::atomic<const SignatureSet*> activeSet(nullptr);
+
+// The index is ~52 KB: PSRAM when present, like SignatureStore's slots
+bool PollutionSignatures::begin() {
+    if (builtinSet != nullptr) return true;
+    SignatureSet* compiled = SignatureSet::create();
+    if (compiled == nullptr) return false;
+    if (!compiled->compile(signatures, NUM_SIGNATURES, 0)) {
+        SignatureSet::destroy(compiled);
+        return false;
+    }
+    builtinSet = compiled;
+    activeSet.store(compiled);
+    return true;
+}
+
 const PollutionPattern* PollutionSignatures::getSignatures() {
     return signatures;
 }
 
 int PollutionSignatures::getNumSignatures() {
-    return sizeof(signatures) / sizeof(signatures[0]);
-}
\ No newline at end of file
+    return NUM_SIGNATURES;
+}
+
+const SignatureSet& PollutionSignatures::builtin() {
+    return *builtinSet;
+}
+
+// Count first, then confirm the set is still active: a writer that swapped
+// it out either sees the count or this reader retries with the new set.
+const SignatureSet* PollutionSignatures::acquire() {
+    for (;;) {
+        const SignatureSet* set = activeSet.load();
+        set->users.fetch_add(1);
+        if (activeSet.load() == set) return set;
+        set->users.fetch_sub(1);
+    }
+}
+
+void PollutionSignatures::release(const SignatureSet* set) {
+    set->users.fetch_sub(1);
+}
+
+void PollutionSignatures::publish(const SignatureSet* set) {
+    activeSet.store(set);
+}
+
+void PollutionSignatures::waitUntilIdle(const SignatureSet* set) {
+    // Leases span one detect() or one reading; this returns within a tick
+    while (set->users.load() != 0) {
+        delay(1);
+    }
+}
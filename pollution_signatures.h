@@ -3,23 +3,104 @@
 #define POLLUTION_SIGNATURES_H
 
 #include <Arduino.h>
+#include <atomic>
+#include "rule_index.h"
+#include "sensor_sample.h"
 
+// Compact signature identifiers produced by PollutionDetector::detect()
+enum SignatureId : uint8_t {
+    SIG_NONE = 0,
+    SIG_LETHAL_OPIOID_WEAPON,
+    SIG_CHEMICAL_WEAPON_COCKTAIL,
+    SIG_NEUROTOXIN_ATTACK,
+    SIG_HEAVY_METAL_ATTACK,
+    SIG_ORGANOPHOSPHATE_ATTACK,
+    SIG_GASEOUS_CHEMICAL_WEAPON,
+    SIG_OPIOID_ATTACK,
+    SIG_SCOPOLAMINE_DELIVERY,
+    SIG_BITTER_KNOCKOUT_DRUG,
+    SIG_STEALTH_CHEMICAL,
+    SIG_IAQ_ANOMALY_NO_VOC,
+    SIG_DRUG_DELIVERY_IN_LPG,
+    SIG_LPG_CARRIER_ONLY,
+    SIG_STEALTH_CONTAMINATION,
+    SIG_MASKED_ATTACK,
+    SIG_CLEAN_AIR,
+    SIG_UNKNOWN_ANALYSIS,
+    // Trend signatures (streaming detect() only); appended so logged ids stay stable
+    SIG_DECREASING_VOC_PATTERN,
+    SIG_SIGNATURE_SWITCH_ATTACK,
+    SIG_CLIMATE_WEAPONIZATION,
+    SIG_COUNT
+};
+
+// Plain aggregate so the table lives in flash (names/descriptions are literals).
+// Ranges are indexed by RuleAxis; RULE_ANY marks an axis the row ignores.
+// The signature id says which engine uses the row:
+//  - SIG_NONE: context pattern, reported by match()
+//  - a window signature (LETHAL_OPIOID_WEAPON..STEALTH_CHEMICAL): a detect()
+//    rule, ahead of the baseline-relative rules
+//  - a trend signature: listed for reference only, the temporal rules in
+//    pollution_detector.cpp decide it
 struct PollutionPattern {
-    String name;
-    int priority;
-    float minIAQ, maxIAQ;
-    float minVOC, maxVOC; // VOC range in ppm
-    float minCO2, maxCO2;
-    float minTemp, maxTemp;
-    String description;
+    const char* name;
+    uint8_t signature;
+    int priority;               // Lower wins; table order breaks ties
+    RuleRange range[AXIS_COUNT];
+    const char* description;
     bool isThreat;
 };
 
+// One compiled signature table. The built-in table is compiled by
+// PollutionSignatures::begin(); tables pushed over WiFi are compiled by SignatureStore into sets
+// it allocated up front, then published. Every window row goes into one
+// index: detect() rules occupy [0, numDetector) in priority order with
+// id() = their SignatureId, context patterns follow with id() = their row.
+struct SignatureSet {
+    RuleIndex index;
+    int numDetector;
+    const PollutionPattern* patterns;  // Not copied; must outlive the set
+    int numPatterns;
+    uint32_t version;                  // 0 = built-in table
+    mutable std::atomic<int> users;    // Open leases; rebuilt only at zero
+
+    SignatureSet() : numDetector(0), patterns(nullptr), numPatterns(0), version(0), users(0) {}
+
+    // Heap sets, PSRAM when present: ps_malloc() would under-align the
+    // range tables the kernel loads 32 bytes at a time. nullptr when out
+    // of memory; release with destroy().
+    static SignatureSet* create();
+    static void destroy(SignatureSet* set);
+
+    // Not reentrant (shared scratch): call from one task at a time
+    bool compile(const PollutionPattern* rows, int count, uint32_t tableVersion);
+
+    // Best-priority context pattern: index into patterns, or -1
+    int match(const SensorSample& sample) const;
+};
+
 class PollutionSignatures {
 public:
+    // The table compiled into the firmware
     static const PollutionPattern* getSignatures();
     static int getNumSignatures();
-    
+
+    // Compiles the built-in table and makes it active. Call once before the
+    // first acquire(); builtin() is valid after it succeeds.
+    static bool begin();
+    static const SignatureSet& builtin();
+
+    // Pins the active table without blocking; pair with release(). Prefer
+    // SignatureLease. A set stays valid while anyone holds it.
+    static const SignatureSet* acquire();
+    static void release(const SignatureSet* set);
+
+    // Swaps the active table; readers move over at their next acquire()
+    static void publish(const SignatureSet* set);
+
+    // Waits until no lease holds set; it must no longer be active
+    static void waitUntilIdle(const SignatureSet* set);
+
     // Optional: Keep this method if you want it, but it's not used in the new detector
     static String detectPollutionSignature(float iaq, float voc, float co2, float temp, float humidity, bool inSpike) {
         // Simple fallback implementation
@@ -27,4 +108,19 @@ public:
     }
 };
 
+// Scoped acquire()/release() of the active signature table
+class SignatureLease {
+public:
+    SignatureLease() : _set(PollutionSignatures::acquire()) {}
+    ~SignatureLease() { PollutionSignatures::release(_set); }
+    SignatureLease(const SignatureLease&) = delete;
+    SignatureLease& operator=(const SignatureLease&) = delete;
+
+    const SignatureSet& operator*() const { return *_set; }
+    const SignatureSet* operator->() const { return _set; }
+
+private:
+    const SignatureSet* _set;
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "range_kernel.h"
+#include "fixed_point.h"
+
+// Vector paths use ordered compares, so a NaN sample value fails every
+// window - the same result as the scalar '>= && <=' tests. The ESP32-S3 PIE
+// unit only provides integer SIMD (and no compiler intrinsics), so Xtensa
+// builds take the branch-free scalar path. The fixed-point build is always
+// scalar: integer compares are single-cycle even without an FPU, and a
+// missing reading is below every window's minimum.
+#if defined(DETECTOR_FIXED_POINT)
+#define RANGE_KERNEL_FIXED 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define RANGE_KERNEL_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define RANGE_KERNEL_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RANGE_KERNEL_NEON 1
+#endif
+
+void rangeTableClear(RangeTable& table) {
+    for (int a = 0; a < AXIS_COUNT; a++) {
+        for (int i = 0; i < RangeTable::LANES; i++) {
+            table.min[a][i] = RULE_VALUE_HIGHEST;
+            table.max[a][i] = RULE_VALUE_LOWEST;
+        }
+        for (int w = 0; w < RangeTable::WORDS; w++) {
+            table.care[a][w] = 0;
+        }
+    }
+}
+
+// Bit i set where min[i] <= value <= max[i], for 32 consecutive lanes
+static inline uint32_t inRange32(const RuleValue* mn, const RuleValue* mx, RuleValue value) {
+    uint32_t bits = 0;
+#if defined(RANGE_KERNEL_AVX2)
+    __m256 v = _mm256_set1_ps(value);
+    for (int i = 0; i < 32; i += 8) {
+        __m256 ge = _mm256_cmp_ps(v, _mm256_load_ps(mn + i), _CMP_GE_OQ);
+        __m256 le = _mm256_cmp_ps(v, _mm256_load_ps(mx + i), _CMP_LE_OQ);
+        bits |= (uint32_t)_mm256_movemask_ps(_mm256_and_ps(ge, le)) << i;
+    }
+#elif defined(RANGE_KERNEL_SSE2)
+    __m128 v = _mm_set1_ps(value);
+    for (int i = 0; i < 32; i += 4) {
+        __m128 ge = _mm_cmpge_ps(v, _mm_load_ps(mn + i));
+        __m128 le = _mm_cmple_ps(v, _mm_load_ps(mx + i));
+        bits |= (uint32_t)_mm_movemask_ps(_mm_and_ps(ge, le)) << i;
+    }
+#elif defined(RANGE_KERNEL_NEON)
+    static const uint32_t laneBits[4] = {1, 2, 4, 8};
+    const uint32x4_t weights = vld1q_u32(laneBits);
+    float32x4_t v = vdupq_n_f32(value);
+    for (int i = 0; i < 32; i += 4) {
+        uint32x4_t ge = vcgeq_f32(v, vld1q_f32(mn + i));
+        uint32x4_t le = vcleq_f32(v, vld1q_f32(mx + i));
+        uint32x4_t lanes = vandq_u32(vandq_u32(ge, le), weights);
+#if defined(__aarch64__)
+        uint32_t nibble = vaddvq_u32(lanes);
+#else
+        uint32x2_t pair = vadd_u32(vget_low_u32(lanes), vget_high_u32(lanes));
+        uint32_t nibble = vget_lane_u32(vpadd_u32(pair, pair), 0);
+#endif
+        bits |= nibble << i;
+    }
+#else
+    for (int i = 0; i < 32; i++) {
+        bits |= (uint32_t)((value >= mn[i]) & (value <= mx[i])) << i;
+    }
+#endif
+    return bits;
+}
+
+uint32_t rangeKernelMatch(const RangeTable& table, int word, const RuleValue* sample, uint32_t candidates) {
+    uint32_t result = candidates;
+    int offset = word * 32;
+    for (int a = 0; a < AXIS_COUNT && result; a++) {
+        uint32_t care = table.care[a][word];
+        if (!(care & result)) continue; // No live candidate tests this axis
+        uint32_t inside = inRange32(&table.min[a][offset], &table.max[a][offset], sample[a]);
+        result &= inside | ~care;
+    }
+    return result;
+}
+
+const char* rangeKernelName() {
+#if defined(RANGE_KERNEL_FIXED)
+    return "fixed-point";
+#elif defined(RANGE_KERNEL_AVX2)
+    return "AVX2";
+#elif defined(RANGE_KERNEL_SSE2)
+    return "SSE2";
+#elif defined(RANGE_KERNEL_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
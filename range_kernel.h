@@ -0,0 +1,55 @@
+#ifndef RANGE_KERNEL_H
+#define RANGE_KERNEL_H
+
+#include <Arduino.h>
+
+#ifndef RULE_INDEX_MAX_RULES
+#define RULE_INDEX_MAX_RULES 256
+#endif
+#define RULE_MASK_WORDS ((RULE_INDEX_MAX_RULES + 31) / 32)
+
+// Sensor axes a window rule can test
+enum RuleAxis : uint8_t {
+    AXIS_IAQ = 0,
+    AXIS_VOC,
+    AXIS_CO2,
+    AXIS_TEMP,
+    AXIS_HUMIDITY,
+    AXIS_RAW_GAS,
+    AXIS_PM2_5,
+    AXIS_COUNT
+};
+
+// Kernel value type: scaled integer in the fixed-point build (fixed_point.h
+// has the scales and conversions), the float reading otherwise
+#ifdef DETECTOR_FIXED_POINT
+typedef int32_t RuleValue;
+#else
+typedef float RuleValue;
+#endif
+
+// Struct-of-arrays rule windows for the range-test kernel. Rule i occupies
+// lane i of every per-axis array; bit i of care[axis][i / 32] says whether
+// the rule tests that axis at all. Unused lanes hold an empty window.
+struct RangeTable {
+    static const int WORDS = RULE_MASK_WORDS;
+    static const int LANES = WORDS * 32;
+
+    alignas(32) RuleValue min[AXIS_COUNT][LANES];
+    alignas(32) RuleValue max[AXIS_COUNT][LANES];
+    uint32_t care[AXIS_COUNT][WORDS];
+};
+
+// Resets every lane to an empty window that no sample can match
+void rangeTableClear(RangeTable& table);
+
+// Tests one sample (indexed by RuleAxis) against the 32 rules of a mask
+// word. Only lanes set in 'candidates' matter; the result has bit i set if
+// rule word * 32 + i lies inside its window on every axis it cares about.
+// Bit order is table order, i.e. the lowest set bit is the best priority.
+uint32_t rangeKernelMatch(const RangeTable& table, int word, const RuleValue* sample, uint32_t candidates);
+
+// Name of the compiled-in kernel implementation, for diagnostics
+const char* rangeKernelName();
+
+#endif
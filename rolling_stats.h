@@ -0,0 +1,67 @@
+#ifndef ROLLING_STATS_H
+#define ROLLING_STATS_H
+
+#include <Arduino.h>
+
+// Fixed-window rolling statistics with O(1) updates. Keeps the last N
+// samples in a ring and maintains mean and variance incrementally (windowed
+// Welford), so the cost per sample does not depend on the window length.
+// Accumulators are double to keep drift negligible over weeks of uptime.
+template <typename T, int N>
+class RollingStats {
+public:
+    RollingStats() { reset(); }
+
+    void reset() {
+        _head = 0;
+        _count = 0;
+        _mean = 0.0;
+        _m2 = 0.0;
+        for (int i = 0; i < N; i++) {
+            _values[i] = T();
+        }
+    }
+
+    void push(T value) {
+        double x = (double)value;
+        if (_count < N) {
+            // Growing window: plain Welford step
+            _count++;
+            double delta = x - _mean;
+            _mean += delta / _count;
+            _m2 += delta * (x - _mean);
+        } else {
+            // Full window: replace the oldest sample
+            double old = (double)_values[_head];
+            double oldMean = _mean;
+            _mean += (x - old) / N;
+            _m2 += (x - old) * (x - _mean + old - oldMean);
+            if (_m2 < 0.0) _m2 = 0.0;
+        }
+        _values[_head] = value;
+        _head = (_head + 1) % N;
+    }
+
+    int count() const { return _count; }
+    bool full() const { return _count == N; }
+    static int capacity() { return N; }
+
+    float mean() const { return (float)_mean; }
+    float variance() const { return _count > 0 ? (float)(_m2 / _count) : 0.0f; }
+    float stddev() const { return sqrtf(variance()); }
+
+    // Most recent sample, or T() if empty
+    T latest() const { return _count > 0 ? _values[(_head + N - 1) % N] : T(); }
+
+    // Raw ring access for persistence (index 0 = oldest sample)
+    T at(int i) const { return _values[(_head + N - _count + i) % N]; }
+
+private:
+    T _values[N];
+    int _head;
+    int _count;
+    double _mean;
+    double _m2;
+};
+
+#endif
@@ -0,0 +1,328 @@
+#include "rollup_store.h"
+#include <LittleFS.h>
+
+static const char* const ROLLUP_FILES[ROLLUP_TIERS] = { "/rollup_m.bin", "/rollup_h.bin" };
+static const char* const ROLLUP_OLD_FILES[ROLLUP_TIERS] = { "/rollup_m.old", "/rollup_h.old" };
+
+// SensorSample values in SampleRecord order
+static float SensorSample::* const SAMPLE_FIELDS[] = {
+    &SensorSample::temp, &SensorSample::humidity, &SensorSample::pressure,
+    &SensorSample::iaq, &SensorSample::co2, &SensorSample::voc, &SensorSample::rawGas,
+    &SensorSample::pm1_0, &SensorSample::pm2_5, &SensorSample::pm10_0
+};
+
+RollupStore::RollupStore() : _mutex(nullptr), _latestTime(0), _flashReady(false) {
+    for (int t = 0; t < ROLLUP_TIERS; t++) {
+        _tiers[t].records = nullptr;
+        _tiers[t].nextId = 0;
+        _tiers[t].fileRecords = 0;
+        _tiers[t].bootFirstId = 0;
+        _tiers[t].bootFileRecord = 0;
+        _tiers[t].bootOldRecord = NO_RECORD;
+        for (int ch = 0; ch < SENSOR_CHANNELS; ch++) clear(_tiers[t].open[ch], 0);
+    }
+}
+
+bool RollupStore::begin(bool flashReady) {
+    for (int t = 0; t < ROLLUP_TIERS; t++) {
+        if (_tiers[t].records != nullptr) continue;
+        size_t bytes = capacity((RollupTier)t) * sizeof(RollupRecord);
+        _tiers[t].records = (RollupRecord*)ps_malloc(bytes);
+        if (_tiers[t].records == nullptr) _tiers[t].records = (RollupRecord*)malloc(bytes);  // No PSRAM
+        if (_tiers[t].records == nullptr) return false;
+    }
+    if (_mutex == nullptr) _mutex = xSemaphoreCreateMutex();
+
+    _flashReady = flashReady;
+    if (_flashReady) {
+        for (int t = 0; t < ROLLUP_TIERS; t++) loadFromFlash((RollupTier)t);
+    }
+    for (int t = 0; t < ROLLUP_TIERS; t++) {
+        _tiers[t].bootFirstId = _tiers[t].nextId;
+        _tiers[t].bootFileRecord = _tiers[t].fileRecords;
+        _tiers[t].bootOldRecord = NO_RECORD;
+    }
+    return true;
+}
+
+void RollupStore::add(const SensorSample& sample, uint8_t signature, uint8_t flags, uint32_t time) {
+    if (!ready()) return;
+    uint8_t channel = sampleFlagsChannel(flags);
+    if (channel >= SENSOR_CHANNELS) return;
+
+    for (int t = 0; t < ROLLUP_TIERS; t++) {
+        RollupTier tier = (RollupTier)t;
+        uint32_t start = time - time % bucketSeconds(tier);
+        Accumulator& a = _tiers[t].open[channel];
+
+        // Any bucket change seals. The sealed record and the fresh bucket swap in under one lock, so
+        // a query never counts the bucket twice.
+        bool sealed = a.samples > 0 && start != a.start;
+        RollupRecord record;
+        if (sealed) seal(tier, channel, a, record);
+
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        if (sealed) {
+            Tier& s = _tiers[t];
+            s.records[s.nextId % capacity(tier)] = record;
+            s.nextId++;
+        }
+        if (sealed || a.samples == 0) clear(a, start);
+        fold(a, sample, signature, flags);
+        xSemaphoreGive(_mutex);
+
+        if (sealed && _flashReady) appendToFlash(tier, record);
+    }
+}
+
+// ===== ACCUMULATORS =====
+
+void RollupStore::clear(Accumulator& a, uint32_t start) {
+    memset(&a, 0, sizeof(a));
+    a.start = start;
+    for (int f = 0; f < FIELDS; f++) {
+        a.minimum[f] = NAN;
+        a.maximum[f] = NAN;
+    }
+}
+
+void RollupStore::fold(Accumulator& a, const SensorSample& sample, uint8_t signature, uint8_t flags) {
+    a.samples++;
+    if (flags & SAMPLE_FLAG_IN_SPIKE) a.spikeSamples++;
+    if (flags & SAMPLE_FLAG_THREAT) a.threatSamples++;
+    a.flags |= flags;
+    if (signature < SIG_COUNT) a.signatures[signature]++;
+
+    for (int f = 0; f < FIELDS; f++) {
+        float v = sample.*SAMPLE_FIELDS[f];
+        if (isnan(v)) continue;
+        if (a.count[f] == 0 || v < a.minimum[f]) a.minimum[f] = v;
+        if (a.count[f] == 0 || v > a.maximum[f]) a.maximum[f] = v;
+        a.sum[f] += v;
+        a.count[f]++;
+    }
+}
+
+// Sealed bucket back into an accumulator; its mean stands for all its readings
+void RollupStore::foldRecord(Accumulator& a, const RollupRecord& r) {
+    SensorSample lo, mean, hi;
+    SampleLog::decode(r.minimum, 0, lo);
+    SampleLog::decode(r.mean, 0, mean);
+    SampleLog::decode(r.maximum, 0, hi);
+
+    a.samples += r.samples;
+    a.spikeSamples += r.spikeSamples;
+    a.threatSamples += r.threatSamples;
+    a.flags |= r.mean.flags;
+    if (r.mean.signature < SIG_COUNT) a.signatures[r.mean.signature] += r.samples;
+
+    for (int f = 0; f < FIELDS; f++) {
+        float m = mean.*SAMPLE_FIELDS[f];
+        if (isnan(m)) continue;
+        float l = lo.*SAMPLE_FIELDS[f], h = hi.*SAMPLE_FIELDS[f];
+        if (a.count[f] == 0 || l < a.minimum[f]) a.minimum[f] = l;
+        if (a.count[f] == 0 || h > a.maximum[f]) a.maximum[f] = h;
+        a.sum[f] += (double)m * r.samples;
+        a.count[f] += r.samples;
+    }
+}
+
+uint8_t RollupStore::dominantSignature(const Accumulator& a) {
+    uint8_t best = 0;
+    for (int sig = 1; sig < SIG_COUNT; sig++) {
+        if (a.signatures[sig] > a.signatures[best]) best = sig;
+    }
+    return best;
+}
+
+void RollupStore::seal(RollupTier tier, uint8_t channel, const Accumulator& a, RollupRecord& out) {
+    SensorSample lo, mean, hi;
+    for (int f = 0; f < FIELDS; f++) {
+        lo.*SAMPLE_FIELDS[f] = a.minimum[f];
+        hi.*SAMPLE_FIELDS[f] = a.maximum[f];
+        mean.*SAMPLE_FIELDS[f] = a.count[f] > 0 ? (float)(a.sum[f] / a.count[f]) : NAN;
+    }
+    out.startTime = a.start;
+    out.samples = a.samples < 0xFFFF ? a.samples : 0xFFFF;
+    out.spikeSamples = a.spikeSamples < 0xFFFF ? a.spikeSamples : 0xFFFF;
+    out.threatSamples = a.threatSamples < 0xFFFF ? a.threatSamples : 0xFFFF;
+    out.tier = tier;
+    out.channel = channel;
+    SampleLog::encode(lo, 0, a.flags, 0, out.minimum);
+    SampleLog::encode(mean, dominantSignature(a), a.flags, 0, out.mean);
+    SampleLog::encode(hi, 0, a.flags, 0, out.maximum);
+}
+
+// ===== QUERIES =====
+
+uint32_t RollupStore::firstId(RollupTier tier) const {
+    uint32_t next = _tiers[tier].nextId;
+    return next > capacity(tier) ? next - capacity(tier) : 0;
+}
+
+uint32_t RollupStore::lowerBound(RollupTier tier, uint32_t time) {
+    const Tier& t = _tiers[tier];
+    if (t.records == nullptr) return 0;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    uint32_t id = firstId(tier);
+    while (id < t.nextId && t.records[id % capacity(tier)].startTime < time) id++;
+    xSemaphoreGive(_mutex);
+    return id;
+}
+
+size_t RollupStore::read(RollupTier tier, uint32_t& cursor, RollupRecord* out, size_t max) {
+    const Tier& t = _tiers[tier];
+    if (t.records == nullptr) return 0;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if (cursor < firstId(tier)) cursor = firstId(tier);   // Overwritten since the caller looked
+    size_t n = 0;
+    for (; cursor < t.nextId && n < max; cursor++) {
+        out[n++] = t.records[cursor % capacity(tier)];
+    }
+    xSemaphoreGive(_mutex);
+    return n;
+}
+
+bool RollupStore::current(RollupTier tier, uint8_t channel, RollupRecord& out) {
+    if (_tiers[tier].records == nullptr || channel >= SENSOR_CHANNELS) return false;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    const Accumulator& a = _tiers[tier].open[channel];
+    bool any = a.samples > 0;
+    if (any) seal(tier, channel, a, out);
+    xSemaphoreGive(_mutex);
+    return any;
+}
+
+bool RollupStore::summarize(RollupTier tier, uint8_t channel, uint32_t from, uint32_t to, RollupSummary& out) {
+    const Tier& t = _tiers[tier];
+    if (t.records == nullptr || channel >= SENSOR_CHANNELS) return false;
+
+    Accumulator sum;
+    clear(sum, from);
+    uint32_t records = 0;
+    uint32_t first = lowerBound(tier, from);
+
+    // RAM only, so the scan runs under the mutex: at most one ring. Every
+    // record is checked against the range, since the ring is not sorted.
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    for (uint32_t id = max(first, firstId(tier)); id < t.nextId; id++) {
+        const RollupRecord& r = t.records[id % capacity(tier)];
+        if (r.channel != channel || r.startTime < from || r.startTime >= to) continue;
+        foldRecord(sum, r);
+        records++;
+    }
+    const Accumulator& open = t.open[channel];
+    if (open.samples > 0 && open.start >= from && open.start < to) {
+        RollupRecord r;
+        seal(tier, channel, open, r);
+        foldRecord(sum, r);
+        records++;
+    }
+    xSemaphoreGive(_mutex);
+
+    if (records == 0) return false;
+    out.records = records;
+    out.samples = sum.samples;
+    out.spikeSamples = sum.spikeSamples;
+    out.threatSamples = sum.threatSamples;
+    out.signature = dominantSignature(sum);
+    out.minimum.timestampMs = out.mean.timestampMs = out.maximum.timestampMs = 0;
+    for (int f = 0; f < FIELDS; f++) {
+        out.minimum.*SAMPLE_FIELDS[f] = sum.minimum[f];
+        out.maximum.*SAMPLE_FIELDS[f] = sum.maximum[f];
+        out.mean.*SAMPLE_FIELDS[f] = sum.count[f] > 0 ? (float)(sum.sum[f] / sum.count[f]) : NAN;
+    }
+    return true;
+}
+
+// ===== STORAGE =====
+
+// Rotates to the .old file once the current one holds a full ring
+bool RollupStore::appendToFlash(RollupTier tier, const RollupRecord& record) {
+    Tier& t = _tiers[tier];
+    if (t.fileRecords >= capacity(tier)) {
+        LittleFS.remove(ROLLUP_OLD_FILES[tier]);
+        LittleFS.rename(ROLLUP_FILES[tier], ROLLUP_OLD_FILES[tier]);
+        t.bootOldRecord = t.bootFileRecord;
+        t.bootFileRecord = 0;
+        t.fileRecords = 0;
+    }
+
+    File f = LittleFS.open(ROLLUP_FILES[tier], FILE_APPEND);
+    if (!f) return false;
+    size_t n = f.write((const uint8_t*)&record, sizeof(record));
+    f.close();
+    if (n != sizeof(record)) return false;
+    t.fileRecords++;
+    return true;
+}
+
+// Replays .old then the current file into the ring; the ring keeps the
+// newest capacity() of them
+void RollupStore::loadFromFlash(RollupTier tier) {
+    Tier& t = _tiers[tier];
+    const char* paths[] = { ROLLUP_OLD_FILES[tier], ROLLUP_FILES[tier] };
+    for (int i = 0; i < 2; i++) {
+        File f = LittleFS.open(paths[i], FILE_READ);
+        if (!f) continue;
+        uint32_t stored = f.size() / sizeof(RollupRecord);   // Ignore a torn tail
+        uint32_t skip = stored > capacity(tier) ? stored - capacity(tier) : 0;
+        f.seek(skip * sizeof(RollupRecord));
+
+        RollupRecord r;
+        for (uint32_t n = skip; n < stored && f.read((uint8_t*)&r, sizeof(r)) == sizeof(r); n++) {
+            if (r.tier != tier || r.channel >= SENSOR_CHANNELS) continue;
+            t.records[t.nextId % capacity(tier)] = r;
+            t.nextId++;
+            _latestTime = max(_latestTime, r.startTime + bucketSeconds(tier));
+        }
+        bool torn = f.size() % sizeof(RollupRecord) != 0;
+        f.close();
+        // A torn tail would misalign every later append: rotate it away
+        if (i == 1) t.fileRecords = torn ? capacity(tier) : stored;
+    }
+}
+
+static uint32_t shiftBucket(uint32_t start, int32_t delta, uint32_t bucket) {
+    uint32_t moved = start + delta;
+    return moved - moved % bucket;
+}
+
+void RollupStore::shiftBootTimes(int32_t delta) {
+    if (!ready() || delta == 0) return;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    for (int i = 0; i < ROLLUP_TIERS; i++) {
+        RollupTier tier = (RollupTier)i;
+        Tier& t = _tiers[i];
+        for (uint32_t id = max(t.bootFirstId, firstId(tier)); id < t.nextId; id++) {
+            RollupRecord& r = t.records[id % capacity(tier)];
+            r.startTime = shiftBucket(r.startTime, delta, bucketSeconds(tier));
+        }
+        for (Accumulator& a : t.open) {
+            if (a.samples > 0) a.start = shiftBucket(a.start, delta, bucketSeconds(tier));
+        }
+    }
+    xSemaphoreGive(_mutex);
+
+    if (!_flashReady) return;
+    for (int i = 0; i < ROLLUP_TIERS; i++) {
+        const Tier& t = _tiers[i];
+        uint32_t bucket = bucketSeconds((RollupTier)i);
+        if (t.bootOldRecord != NO_RECORD) shiftFile(ROLLUP_OLD_FILES[i], t.bootOldRecord, delta, bucket);
+        shiftFile(ROLLUP_FILES[i], t.bootFileRecord, delta, bucket);
+    }
+}
+
+// Rewrites the start of every record from 'fromRecord' to the end in place
+void RollupStore::shiftFile(const char* path, uint32_t fromRecord, int32_t delta, uint32_t bucket) {
+    File f = LittleFS.open(path, "r+");
+    if (!f) return;
+    uint32_t stored = f.size() / sizeof(RollupRecord);
+    RollupRecord r;
+    for (uint32_t i = fromRecord; i < stored; i++) {
+        if (!f.seek(i * sizeof(RollupRecord)) || f.read((uint8_t*)&r, sizeof(r)) != sizeof(r)) break;
+        r.startTime = shiftBucket(r.startTime, delta, bucket);
+        if (!f.seek(i * sizeof(RollupRecord)) || f.write((const uint8_t*)&r, sizeof(r)) != sizeof(r)) break;
+    }
+    f.close();
+}
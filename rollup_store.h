@@ -0,0 +1,140 @@
+#ifndef ROLLUP_STORE_H
+#define ROLLUP_STORE_H
+
+#include <Arduino.h>
+#include "sample_log.h"
+#include "pollution_signatures.h"
+
+// ===== RECORD FORMAT =====
+// One bucket of one sensor channel, 96 bytes. Minimum, mean and maximum of
+// every field are SampleRecords in the log's own encoding, so
+// SampleLog::decode() reads them. Their dtMs is unused; mean.signature is
+// the most frequent signature in the bucket and every flags byte is the OR
+// over the bucket (channel bits included).
+struct RollupRecord {
+    uint32_t startTime;      // Bucket start, unix seconds (see clockSeconds())
+    uint16_t samples;        // Readings folded in
+    uint16_t spikeSamples;   // ... with SAMPLE_FLAG_IN_SPIKE
+    uint16_t threatSamples;  // ... with SAMPLE_FLAG_THREAT
+    uint8_t tier;            // RollupTier
+    uint8_t channel;
+    SampleRecord minimum, mean, maximum;
+};
+static_assert(sizeof(RollupRecord) == 96, "RollupRecord layout changed");
+
+enum RollupTier : uint8_t {
+    ROLLUP_MINUTE = 0,
+    ROLLUP_HOUR,
+    ROLLUP_TIERS
+};
+
+// Merge of a range of buckets, decoded
+struct RollupSummary {
+    uint32_t records;
+    uint32_t samples, spikeSamples, threatSamples;
+    SensorSample minimum, mean, maximum;   // timestampMs unused; NAN for fields never seen
+    uint8_t signature;                     // Most frequent over the range
+};
+
+// ===== STORE =====
+// Incrementally maintained 1 min and 1 h rollups over every reading; the raw
+// tier is the SampleLog. Each reading updates one open bucket per tier and
+// channel in O(1); a bucket is sealed into its tier's PSRAM ring and
+// appended to flash when the first reading of a later bucket arrives, so
+// buckets without readings leave no record. A reboot starts the open
+// buckets afresh: a bucket can then appear twice, and summarize() merges it.
+//
+// Each tier is one file on LittleFS; at capacity() records it becomes the
+// .old file and a new one starts, so flash holds between one and two rings'
+// worth. Records are only rewritten to take the clock being set (see
+// shiftBootTimes()). Both files are reloaded at boot.
+//
+// add() belongs to the analysis task. Queries work from any task: they copy
+// under a mutex that is never held across I/O.
+class RollupStore {
+public:
+    static const uint32_t MINUTE_CAPACITY = 1440 * SENSOR_CHANNELS;      // One day, 276 KB
+    static const uint32_t HOUR_CAPACITY = 24 * 31 * SENSOR_CHANNELS;     // 31 days, 143 KB
+    static const uint32_t NO_RECORD = 0xFFFFFFFF;
+
+    RollupStore();
+
+    bool begin(bool flashReady);
+
+    // Same arguments as SampleLog::append(), plus clockSeconds()
+    void add(const SensorSample& sample, uint8_t signature, uint8_t flags, uint32_t time);
+
+    bool ready() const { return _tiers[ROLLUP_HOUR].records != nullptr; }
+
+    static uint32_t bucketSeconds(RollupTier tier) { return tier == ROLLUP_HOUR ? 3600 : 60; }
+    static uint32_t capacity(RollupTier tier) { return tier == ROLLUP_HOUR ? HOUR_CAPACITY : MINUTE_CAPACITY; }
+
+    // Ids increase forever per tier; the newest capacity() stay in RAM
+    uint32_t firstId(RollupTier tier) const;
+    uint32_t nextId(RollupTier tier) const { return _tiers[tier].nextId; }
+
+    // First sealed record with startTime >= 'time' (nextId() if none).
+    // Channels seal out of step, so later records are not all >= 'time'.
+    uint32_t lowerBound(RollupTier tier, uint32_t time);
+
+    // Newest bucket end among the records loaded at boot (0 if none)
+    uint32_t latestTime() const { return _latestTime; }
+
+    // Moves the buckets started since boot by 'delta' seconds (realigned),
+    // in RAM and on flash: their times were provisional until the clock was
+    // set. Analysis task, like add().
+    void shiftBootTimes(int32_t delta);
+
+    // Copies up to 'max' sealed records starting at id 'cursor' and moves
+    // the cursor past them (and past any overwritten meanwhile)
+    size_t read(RollupTier tier, uint32_t& cursor, RollupRecord* out, size_t max);
+
+    // The bucket still being filled for a channel; false if it has no readings
+    bool current(RollupTier tier, uint8_t channel, RollupRecord& out);
+
+    // One channel's sealed records and open bucket with startTime in
+    // [from, to), merged: min of minima, max of maxima, means weighted by
+    // readings. False when nothing falls in the range.
+    bool summarize(RollupTier tier, uint8_t channel, uint32_t from, uint32_t to, RollupSummary& out);
+
+private:
+    static const int FIELDS = 10;   // SensorSample values, in SampleRecord order
+
+    // Open bucket of one tier and channel, or a summary being built
+    struct Accumulator {
+        uint32_t start;
+        uint32_t samples, spikeSamples, threatSamples;
+        uint8_t flags;
+        uint32_t count[FIELDS];      // Readings behind each field's sum (NAN skipped)
+        float minimum[FIELDS], maximum[FIELDS];
+        double sum[FIELDS];
+        uint32_t signatures[SIG_COUNT];
+    };
+
+    struct Tier {
+        RollupRecord* records;
+        uint32_t nextId;
+        uint32_t fileRecords;        // In the current file
+        uint32_t bootFirstId;        // First record sealed since boot
+        uint32_t bootFileRecord;     // Its position in the current file...
+        uint32_t bootOldRecord;      // ... or in .old after a rotation (NO_RECORD: none there)
+        Accumulator open[SENSOR_CHANNELS];
+    };
+
+    static void clear(Accumulator& a, uint32_t start);
+    static void fold(Accumulator& a, const SensorSample& sample, uint8_t signature, uint8_t flags);
+    static void foldRecord(Accumulator& a, const RollupRecord& record);
+    static uint8_t dominantSignature(const Accumulator& a);
+    static void seal(RollupTier tier, uint8_t channel, const Accumulator& a, RollupRecord& out);
+
+    bool appendToFlash(RollupTier tier, const RollupRecord& record);
+    void loadFromFlash(RollupTier tier);
+    static void shiftFile(const char* path, uint32_t fromRecord, int32_t delta, uint32_t bucket);
+
+    Tier _tiers[ROLLUP_TIERS];
+    SemaphoreHandle_t _mutex;
+    uint32_t _latestTime;
+    bool _flashReady;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "rule_index.h"
+#include "fixed_point.h"
+
+static bool isDontCare(const RuleRange& r) {
+    return isinf(r.min) && r.min < 0 && isinf(r.max) && r.max > 0;
+}
+
+// An infinite float bound, or its saturated fixed-point form
+static bool isUnbounded(RuleValue v) {
+    return v == RULE_VALUE_LOWEST || v == RULE_VALUE_HIGHEST;
+}
+
+RuleIndex::RuleIndex() : _numRules(0) {
+    _voc.numBounds = 0;
+    _iaq.numBounds = 0;
+}
+
+bool RuleIndex::build(const WindowRule* rules, int count) {
+    if (count < 0 || count > MAX_RULES) {
+        return false;
+    }
+
+    _numRules = count;
+    rangeTableClear(_table);
+    for (int i = 0; i < count; i++) {
+        _ids[i] = rules[i].id;
+        _careAxes[i] = 0;
+        for (int a = 0; a < AXIS_COUNT; a++) {
+            _table.min[a][i] = ruleMin(a, rules[i].range[a].min);
+            _table.max[a][i] = ruleMax(a, rules[i].range[a].max);
+            if (!isDontCare(rules[i].range[a])) {
+                _careAxes[i] |= (1 << a);
+                _table.care[a][i / 32] |= (1UL << (i % 32));
+            }
+        }
+    }
+
+    buildAxis(_voc, AXIS_VOC);
+    buildAxis(_iaq, AXIS_IAQ);
+    return true;
+}
+
+void RuleIndex::buildAxis(AxisIndex& axis, RuleAxis which) {
+    // Collect every finite bound, then sort and de-duplicate
+    int n = 0;
+    for (int i = 0; i < _numRules; i++) {
+        RuleValue lo = _table.min[which][i];
+        RuleValue hi = _table.max[which][i];
+        if (!isUnbounded(lo)) axis.bounds[n++] = lo;
+        if (!isUnbounded(hi)) axis.bounds[n++] = hi;
+    }
+    for (int i = 1; i < n; i++) {
+        RuleValue v = axis.bounds[i];
+        int j = i;
+        while (j > 0 && axis.bounds[j - 1] > v) {
+            axis.bounds[j] = axis.bounds[j - 1];
+            j--;
+        }
+        axis.bounds[j] = v;
+    }
+    int unique = 0;
+    for (int i = 0; i < n; i++) {
+        if (unique == 0 || axis.bounds[unique - 1] != axis.bounds[i]) {
+            axis.bounds[unique++] = axis.bounds[i];
+        }
+    }
+    axis.numBounds = unique;
+
+    // Bucket k covers [bounds[k-1], bounds[k]); the ends are open to infinity
+    for (int k = 0; k <= unique; k++) {
+        RuleValue lo = (k == 0) ? RULE_VALUE_LOWEST : axis.bounds[k - 1];
+        RuleValue hi = (k == unique) ? RULE_VALUE_HIGHEST : axis.bounds[k];
+        for (int w = 0; w < MASK_WORDS; w++) {
+            axis.masks[k][w] = 0;
+        }
+        for (int i = 0; i < _numRules; i++) {
+            if (_table.min[which][i] < hi && _table.max[which][i] >= lo) {
+                axis.masks[k][i / 32] |= (1UL << (i % 32));
+            }
+        }
+    }
+}
+
+int RuleIndex::bucketOf(const AxisIndex& axis, RuleValue value) {
+    // Number of bounds <= value (NaN lands in the last bucket, a missing
+    // fixed-point value in the first; full evaluation rejects either for
+    // any rule that tests this axis)
+    int lo = 0, hi = axis.numBounds;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (value < axis.bounds[mid]) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+int RuleIndex::firstMatch(const RuleValue* sample, int begin, int end) const {
+    if (begin >= end) return -1;
+    const uint32_t* vocMask = _voc.masks[bucketOf(_voc, sample[AXIS_VOC])];
+    const uint32_t* iaqMask = _iaq.masks[bucketOf(_iaq, sample[AXIS_IAQ])];
+    int firstWord = begin / 32;
+    int lastWord = (end - 1) / 32;
+
+    for (int w = firstWord; w <= lastWord; w++) {
+        uint32_t candidates = vocMask[w] & iaqMask[w];
+        if (w == firstWord) candidates &= 0xFFFFFFFFu << (begin % 32);
+        if (w == lastWord && end % 32) candidates &= (1u << (end % 32)) - 1;
+        if (!candidates) continue;
+        uint32_t hits = rangeKernelMatch(_table, w, sample, candidates);
+        if (hits) {
+            return w * 32 + __builtin_ctz(hits);
+        }
+    }
+    return -1;
+}
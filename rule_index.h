@@ -0,0 +1,66 @@
+#ifndef RULE_INDEX_H
+#define RULE_INDEX_H
+
+#include <Arduino.h>
+#include "range_kernel.h"
+
+// Closed interval [min, max]; both infinite means "don't care"
+struct RuleRange {
+    float min, max;
+};
+
+#define RULE_ANY { -INFINITY, INFINITY }
+
+// A rule matches when every axis it cares about lies inside its range
+struct WindowRule {
+    uint8_t id;
+    RuleRange range[AXIS_COUNT];
+};
+
+// Interval index over the VOC and IAQ axes. Each axis is cut into
+// elementary buckets at every rule bound, and each bucket holds a bitmask of
+// the rules whose range overlaps it. A lookup is two binary searches and a
+// mask AND; the surviving candidates are then range-tested 32 at a time by
+// rangeKernelMatch(), and the lowest set bit (= highest priority) wins.
+class RuleIndex {
+public:
+    static const int MAX_RULES = RULE_INDEX_MAX_RULES;
+    static const int MASK_WORDS = RULE_MASK_WORDS;
+
+    RuleIndex();
+
+    // Rules must be given in priority order. Returns false if there are too many.
+    // Bounds are converted to kernel units (ruleMin/ruleMax in fixed_point.h).
+    bool build(const WindowRule* rules, int count);
+
+    // Sample is indexed by RuleAxis, in kernel units (toRuleValue()). Returns the first matching rule index, or -1.
+    int firstMatch(const RuleValue* sample) const { return firstMatch(sample, 0, _numRules); }
+
+    // Same, among rules [begin, end) only
+    int firstMatch(const RuleValue* sample, int begin, int end) const;
+
+    int numRules() const { return _numRules; }
+    uint8_t id(int index) const { return _ids[index]; }
+    uint8_t careAxes(int index) const { return _careAxes[index]; }
+    RuleValue minBound(int index, RuleAxis axis) const { return _table.min[axis][index]; }
+    RuleValue maxBound(int index, RuleAxis axis) const { return _table.max[axis][index]; }
+
+private:
+    struct AxisIndex {
+        RuleValue bounds[2 * MAX_RULES];             // Sorted, unique
+        int numBounds;
+        uint32_t masks[2 * MAX_RULES + 1][MASK_WORDS]; // Bucket k: [bounds[k-1], bounds[k])
+    };
+
+    void buildAxis(AxisIndex& axis, RuleAxis which);
+    static int bucketOf(const AxisIndex& axis, RuleValue value);
+
+    RangeTable _table;
+    uint8_t _ids[MAX_RULES];
+    uint8_t _careAxes[MAX_RULES]; // Bit per RuleAxis the rule actually tests
+    int _numRules;
+    AxisIndex _voc;
+    AxisIndex _iaq;
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include "sample_log.h"
+#include <LittleFS.h>
+
+// ===== ENCODING =====
+
+void SampleLog::encode(const SensorSample& sample, uint8_t signature, uint8_t flags,
+                       uint16_t dtMs, SampleRecord& out) {
+    out.dtMs = dtMs;
+    out.temp = quantizeI16(sample.temp, 100.0f);
+    out.humidity = quantizeU16(sample.humidity, 100.0f);
+    out.pressure = quantizeU16(sample.pressure, 0.5f);
+    out.iaq = quantizeU16(sample.iaq, 10.0f);
+    out.co2 = quantizeU16(sample.co2, 1.0f);
+    out.voc = quantizeU32(sample.voc, 1000000.0);
+    out.rawGas = quantizeU32(sample.rawGas, 10.0);
+    out.pm1_0 = quantizeU16(sample.pm1_0, 10.0f);
+    out.pm2_5 = quantizeU16(sample.pm2_5, 10.0f);
+    out.pm10_0 = quantizeU16(sample.pm10_0, 10.0f);
+    out.signature = signature;
+    out.flags = flags;
+}
+
+void SampleLog::decode(const SampleRecord& record, unsigned long timestampMs, SensorSample& out) {
+    out.timestampMs = timestampMs;
+    out.temp = dequantizeI16(record.temp, 100.0f);
+    out.humidity = dequantizeU16(record.humidity, 100.0f);
+    out.pressure = dequantizeU16(record.pressure, 0.5f);
+    out.iaq = dequantizeU16(record.iaq, 10.0f);
+    out.co2 = dequantizeU16(record.co2, 1.0f);
+    out.voc = dequantizeU32(record.voc, 1000000.0);
+    out.rawGas = dequantizeU32(record.rawGas, 10.0);
+    out.pm1_0 = dequantizeU16(record.pm1_0, 10.0f);
+    out.pm2_5 = dequantizeU16(record.pm2_5, 10.0f);
+    out.pm10_0 = dequantizeU16(record.pm10_0, 10.0f);
+}
+
+// ===== RING =====
+
+SampleLog::SampleLog()
+    : _ring(nullptr), _mutex(nullptr), _openSlot(0), _flushSlot(0), _pageOpen(false), _lastTimestamp(0),
+      _fsReady(false), _bootId(0), _nextSequence(0), _segmentSequence(0), _segmentPages(0),
+      _epochOffset(0), _recordsWritten(0), _pagesFlushed(0), _pagesDropped(0) {
+}
+
+bool SampleLog::begin() {
+    if (_ring == nullptr) {
+        size_t bytes = RING_PAGES * sizeof(SampleLogPage);
+        _ring = (SampleLogPage*)ps_malloc(bytes);
+        if (_ring == nullptr) _ring = (SampleLogPage*)malloc(bytes);  // No PSRAM fitted
+        if (_ring == nullptr) return false;
+        memset(_ring, 0, bytes);
+        _mutex = xSemaphoreCreateMutex();
+    }
+    _bootId = esp_random();
+
+    _fsReady = LittleFS.begin(true);
+    if (_fsReady) {
+        LittleFS.mkdir(SAMPLE_LOG_DIR);
+        scanSegments();
+    }
+    // Start a fresh segment every boot so files never mix boot ids mid-way
+    _segmentSequence = _nextSequence;
+    _segmentPages = 0;
+    return true;
+}
+
+void SampleLog::openPage(unsigned long timestampMs) {
+    // Ring full of unflushed pages (flash missing or too slow): drop the oldest
+    if (_openSlot - _flushSlot >= RING_PAGES) {
+        _flushSlot++;
+        _pagesDropped++;
+    }
+
+    SampleLogPage& p = page(_openSlot);
+    memset(&p, 0, sizeof(p));
+    p.header.magic = SAMPLE_LOG_MAGIC;
+    p.header.version = SAMPLE_LOG_VERSION;
+    p.header.sequence = _nextSequence++;
+    p.header.bootId = _bootId;
+    p.header.baseUptimeMs = timestampMs;
+    p.header.baseEpoch = _epochOffset ? _epochOffset + timestampMs / 1000 : 0;
+    _pageOpen = true;
+    _lastTimestamp = timestampMs;
+}
+
+void SampleLog::sealPage() {
+    _openSlot++;
+    _pageOpen = false;
+}
+
+void SampleLog::append(const SensorSample& sample, uint8_t signature, uint8_t flags) {
+    if (_ring == nullptr) return;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    unsigned long dt = sample.timestampMs - _lastTimestamp;
+    if (_pageOpen && dt > 0xFFFF) sealPage();   // Gap too long for a 16-bit delta
+    if (!_pageOpen) {
+        openPage(sample.timestampMs);
+        dt = 0;
+    }
+
+    SampleLogPage& p = page(_openSlot);
+    encode(sample, signature, flags, (uint16_t)dt, p.records[p.header.recordCount++]);
+    _lastTimestamp = sample.timestampMs;
+    _recordsWritten++;
+
+    if (p.header.recordCount == SAMPLE_LOG_RECORDS_PER_PAGE) sealPage();
+    xSemaphoreGive(_mutex);
+}
+
+void SampleLog::setEpoch(uint32_t epochNow, unsigned long uptimeNow) {
+    if (_ring == nullptr) return;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _epochOffset = epochNow - uptimeNow / 1000;
+
+    // Pages still in RAM predate the clock; give them wall-clock time too
+    size_t end = _pageOpen ? _openSlot + 1 : _openSlot;
+    for (size_t slot = _flushSlot; slot < end; slot++) {
+        SampleLogPageHeader& h = page(slot).header;
+        if (h.baseEpoch == 0 && h.bootId == _bootId) {
+            h.baseEpoch = _epochOffset + h.baseUptimeMs / 1000;
+        }
+    }
+    xSemaphoreGive(_mutex);
+}
+
+// ===== EXPORT =====
+
+void SampleLog::ramSlots(size_t& first, size_t& end) {
+    first = end = 0;
+    if (_ring == nullptr) return;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    end = _openSlot;
+    first = _openSlot >= RING_PAGES - 1 ? _openSlot - (RING_PAGES - 1) : 0;
+    xSemaphoreGive(_mutex);
+}
+
+// Keeps one page of margin: the slot after the open page is the next one
+// recycled, so a caller streaming a page has a full page-fill of time
+const SampleLogPage* SampleLog::sealedPage(size_t slot) {
+    if (_ring == nullptr) return nullptr;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    bool live = slot < _openSlot && _openSlot - slot < RING_PAGES - 1;
+    xSemaphoreGive(_mutex);
+
+    const SampleLogPage& p = page(slot);
+    return live && p.header.magic == SAMPLE_LOG_MAGIC ? &p : nullptr;
+}
+
+bool SampleLog::copyOpenPage(SampleLogPage& out) {
+    if (_ring == nullptr) return false;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    bool open = _pageOpen;
+    if (open) {
+        const SampleLogPage& p = page(_openSlot);
+        memcpy(&out.header, &p.header, sizeof(p.header));
+        memcpy(out.records, p.records, p.header.recordCount * sizeof(SampleRecord));
+    }
+    xSemaphoreGive(_mutex);
+
+    if (open) {
+        memset(&out.records[out.header.recordCount], 0,
+               sizeof(out) - sizeof(out.header) - out.header.recordCount * sizeof(SampleRecord));
+    }
+    return open;
+}
+
+bool SampleLog::readPageFrom(uint32_t sequence, SampleLogPage& out, bool& open) {
+    if (_ring == nullptr) return false;
+
+    // Oldest page the ring can still hand out (same margin as sealedPage())
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    size_t first = _openSlot >= RING_PAGES - 2 ? _openSlot - (RING_PAGES - 2) : 0;
+    size_t end = _pageOpen ? _openSlot + 1 : _openSlot;
+    while (first < end && page(first).header.magic != SAMPLE_LOG_MAGIC) first++;
+    uint32_t ramOldest = first < end ? page(first).header.sequence : _nextSequence;
+    bool found = false;
+    if (sequence >= ramOldest || !_fsReady) {
+        for (size_t slot = first; slot < end; slot++) {
+            const SampleLogPage& p = page(slot);
+            if (p.header.sequence < sequence) continue;
+            memcpy(&out.header, &p.header, sizeof(p.header));
+            memcpy(out.records, p.records, p.header.recordCount * sizeof(SampleRecord));
+            open = _pageOpen && slot == _openSlot;
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(_mutex);
+    if (found || sequence >= ramOldest) return found;
+
+    // Older than anything in RAM: the segment files, no lock needed
+    open = false;
+    if (readFlashPageFrom(sequence, ramOldest, out)) return true;
+    return readPageFrom(ramOldest, out, open);
+}
+
+// ===== FLASH =====
+
+void SampleLog::segmentPath(char* buf, size_t len, uint32_t firstSequence) {
+    snprintf(buf, len, "%s/%08lu.seg", SAMPLE_LOG_DIR, (unsigned long)firstSequence);
+}
+
+size_t SampleLog::flush() {
+    if (!_fsReady) return 0;
+
+    size_t written = 0;
+    while (_flushSlot < _openSlot) {
+        if (!writePage(page(_flushSlot))) break;   // Retry on the next flush
+        _flushSlot++;
+        _pagesFlushed++;
+        written++;
+    }
+    return written;
+}
+
+bool SampleLog::writePage(const SampleLogPage& p) {
+    if (_segmentPages >= PAGES_PER_SEGMENT) {
+        _segmentSequence = p.header.sequence;
+        _segmentPages = 0;
+    }
+
+    while (LittleFS.usedBytes() + SAMPLE_LOG_PAGE_SIZE > LittleFS.totalBytes() * FS_HIGH_WATER) {
+        if (!trimOldestSegment()) break;
+    }
+
+    char path[32];
+    segmentPath(path, sizeof(path), _segmentSequence);
+    File f = LittleFS.open(path, FILE_APPEND);
+    if (!f) return false;
+    size_t n = f.write((const uint8_t*)&p, sizeof(p));
+    f.close();
+    if (n != sizeof(p)) return false;
+
+    _segmentPages++;
+    return true;
+}
+
+// Segment files are named by the sequence of their first page, so the
+// lexically smallest name is the oldest and the largest holds the newest page
+void SampleLog::scanSegments() {
+    File dir = LittleFS.open(SAMPLE_LOG_DIR);
+    if (!dir || !dir.isDirectory()) return;
+
+    uint32_t newest = 0;
+    size_t newestSize = 0;
+    bool found = false;
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+        uint32_t seq = strtoul(f.name(), nullptr, 10);
+        if (!found || seq >= newest) {
+            newest = seq;
+            newestSize = f.size();
+            found = true;
+        }
+    }
+    if (!found) return;
+
+    // Continue after the last complete page of the newest segment
+    _nextSequence = newest;
+    size_t pages = newestSize / SAMPLE_LOG_PAGE_SIZE;
+    if (pages > 0) {
+        char path[32];
+        segmentPath(path, sizeof(path), newest);
+        File f = LittleFS.open(path, FILE_READ);
+        SampleLogPageHeader h;
+        if (f && f.seek((pages - 1) * SAMPLE_LOG_PAGE_SIZE) &&
+            f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == SAMPLE_LOG_MAGIC) {
+            _nextSequence = h.sequence + 1;
+        } else {
+            _nextSequence = newest + pages;
+        }
+    }
+}
+
+// Oldest flash page in [sequence, before). Segments are named by their first
+// page, so it is in the last segment starting at or below 'sequence' or is
+// the first page of the segment after it.
+bool SampleLog::readFlashPageFrom(uint32_t sequence, uint32_t before, SampleLogPage& out) {
+    File dir = LittleFS.open(SAMPLE_LOG_DIR);
+    if (!dir || !dir.isDirectory()) return false;
+
+    bool haveBelow = false, haveAbove = false;
+    uint32_t below = 0, above = 0;
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+        uint32_t seq = strtoul(f.name(), nullptr, 10);
+        if (seq <= sequence) {
+            if (!haveBelow || seq > below) below = seq;
+            haveBelow = true;
+        } else if (!haveAbove || seq < above) {
+            above = seq;
+            haveAbove = true;
+        }
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 0 ? !haveBelow : !haveAbove) continue;
+        char path[32];
+        segmentPath(path, sizeof(path), pass == 0 ? below : above);
+        File f = LittleFS.open(path, FILE_READ);
+        if (!f) continue;
+        size_t pages = f.size() / SAMPLE_LOG_PAGE_SIZE;
+        for (size_t i = 0; i < pages; i++) {
+            SampleLogPageHeader h;
+            if (!f.seek(i * SAMPLE_LOG_PAGE_SIZE) || f.read((uint8_t*)&h, sizeof(h)) != sizeof(h)) break;
+            if (h.magic != SAMPLE_LOG_MAGIC || h.sequence < sequence) continue;
+            if (h.sequence >= before) return false;
+            bool ok = f.seek(i * SAMPLE_LOG_PAGE_SIZE) &&
+                      f.read((uint8_t*)&out, SAMPLE_LOG_PAGE_SIZE) == SAMPLE_LOG_PAGE_SIZE;
+            f.close();
+            return ok;
+        }
+        f.close();
+    }
+    return false;
+}
+
+bool SampleLog::trimOldestSegment() {
+    File dir = LittleFS.open(SAMPLE_LOG_DIR);
+    if (!dir || !dir.isDirectory()) return false;
+
+    uint32_t oldest = 0;
+    bool found = false;
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+        uint32_t seq = strtoul(f.name(), nullptr, 10);
+        if (seq == _segmentSequence) continue;   // Never the segment being written
+        if (!found || seq < oldest) {
+            oldest = seq;
+            found = true;
+        }
+    }
+    if (!found) return false;
+
+    char path[32];
+    segmentPath(path, sizeof(path), oldest);
+    return LittleFS.remove(path);
+}
@@ -0,0 +1,199 @@
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include <Arduino.h>
+#include "sensor_sample.h"
+
+// ===== RECORD FORMAT =====
+// One sample in 28 bytes (the CSV line is ~130). Values are fixed-point with
+// the scales below; the all-ones pattern (INT16_MIN for temperature) marks a
+// missing value so NAN survives the round trip. VOC and raw gas are 32-bit:
+// the detector's windows are a few ppb and a few ohms wide, so a record has
+// to resolve finer than that to be re-classified faithfully.
+struct SampleRecord {
+    uint16_t dtMs;          // Since the previous record in the page (0 for the first)
+    int16_t  temp;          // degC * 100
+    uint16_t humidity;      // %RH * 100
+    uint16_t pressure;      // Pa / 2
+    uint16_t iaq;           // IAQ * 10
+    uint16_t co2;           // ppm
+    uint32_t voc;           // ppm * 1000000
+    uint32_t rawGas;        // ohm * 10
+    uint16_t pm1_0;         // ug/m3 * 10
+    uint16_t pm2_5;
+    uint16_t pm10_0;
+    uint8_t  signature;     // PollutionDetector::SignatureId
+    uint8_t  flags;         // SAMPLE_FLAG_*
+};
+static_assert(sizeof(SampleRecord) == 28, "SampleRecord layout changed");
+
+enum SampleFlags : uint8_t {
+    SAMPLE_FLAG_SPIKE          = 0x01,  // Spike score at enterZ on this sample, before debouncing
+    SAMPLE_FLAG_IN_SPIKE       = 0x02,  // Inside a spike event
+    SAMPLE_FLAG_THREAT         = 0x04,  // Signature classified as a threat
+    SAMPLE_FLAG_BASELINE_READY = 0x08,
+    SAMPLE_FLAG_CHANNEL_MASK   = 0x30   // Sensor channel, see sampleFlagsChannel()
+};
+
+const uint8_t SAMPLE_FLAG_CHANNEL_SHIFT = 4;
+
+inline uint8_t sampleFlagsForChannel(uint8_t channel) {
+    return (channel << SAMPLE_FLAG_CHANNEL_SHIFT) & SAMPLE_FLAG_CHANNEL_MASK;
+}
+
+// Logs written before multi-sensor support read as channel 0
+inline uint8_t sampleFlagsChannel(uint8_t flags) {
+    return (flags & SAMPLE_FLAG_CHANNEL_MASK) >> SAMPLE_FLAG_CHANNEL_SHIFT;
+}
+
+// Unsigned fixed-point with 0xFFFF as the missing marker; shared with other
+// compact records (spike store)
+inline uint16_t quantizeU16(float value, float scale) {
+    if (isnan(value)) return 0xFFFF;
+    float q = value * scale + 0.5f;
+    if (q <= 0.0f) return 0;
+    if (q >= 65534.0f) return 65534;
+    return (uint16_t)q;
+}
+
+inline float dequantizeU16(uint16_t value, float scale) {
+    return value == 0xFFFF ? NAN : value / scale;
+}
+
+// 32-bit variant, 0xFFFFFFFF missing; double so MΩ values keep their last digit
+inline uint32_t quantizeU32(float value, double scale) {
+    if (isnan(value)) return 0xFFFFFFFF;
+    double q = value * scale + 0.5;
+    if (q <= 0.0) return 0;
+    if (q >= 4294967294.0) return 0xFFFFFFFE;
+    return (uint32_t)q;
+}
+
+inline float dequantizeU32(uint32_t value, double scale) {
+    return value == 0xFFFFFFFF ? NAN : (float)(value / scale);
+}
+
+// Signed variant; INT16_MIN is the missing marker
+inline int16_t quantizeI16(float value, float scale) {
+    if (isnan(value)) return INT16_MIN;
+    float q = constrain(value * scale, -32767.0f, 32767.0f);
+    return (int16_t)lroundf(q);
+}
+
+inline float dequantizeI16(int16_t value, float scale) {
+    return value == INT16_MIN ? NAN : value / scale;
+}
+
+// ===== PAGE FORMAT =====
+// Records are grouped into flash-block-sized pages. The header anchors the
+// delta-encoded timestamps: record i was taken at baseUptimeMs + sum(dtMs[0..i]).
+struct SampleLogPageHeader {
+    uint32_t magic;         // SAMPLE_LOG_MAGIC
+    uint16_t version;
+    uint16_t recordCount;
+    uint32_t sequence;      // Monotonic page number, survives reboots
+    uint32_t bootId;        // Changes every boot; uptimes only compare within one
+    uint32_t baseUptimeMs;  // millis() of the first record
+    uint32_t baseEpoch;     // Unix time of the first record, 0 if clock not set
+    uint32_t reserved[2];
+};
+static_assert(sizeof(SampleLogPageHeader) == 32, "SampleLogPageHeader layout changed");
+
+const uint32_t SAMPLE_LOG_MAGIC = 0x474C5053;  // "SPLG"
+const uint16_t SAMPLE_LOG_VERSION = 1;
+const size_t SAMPLE_LOG_PAGE_SIZE = 4096;      // One LittleFS block
+const char* const SAMPLE_LOG_DIR = "/log";     // Segment files: <first sequence>.seg
+const size_t SAMPLE_LOG_RECORDS_PER_PAGE =
+    (SAMPLE_LOG_PAGE_SIZE - sizeof(SampleLogPageHeader)) / sizeof(SampleRecord);
+
+struct SampleLogPage {
+    SampleLogPageHeader header;
+    SampleRecord records[SAMPLE_LOG_RECORDS_PER_PAGE];
+    uint8_t padding[SAMPLE_LOG_PAGE_SIZE - sizeof(SampleLogPageHeader)
+                    - SAMPLE_LOG_RECORDS_PER_PAGE * sizeof(SampleRecord)];
+};
+static_assert(sizeof(SampleLogPage) == SAMPLE_LOG_PAGE_SIZE, "Page must fill one block");
+
+// ===== LOG =====
+// Appends go into a PSRAM ring of pages; full pages are written to segment
+// files under /log on LittleFS. When the filesystem fills up the oldest
+// segment is deleted, so flash always holds the most recent days of data.
+//
+// append() and flush() belong to the analysis task. Flushing is separate so
+// the caller decides when a ~4 KB flash write is acceptable. Readers on other
+// tasks (the export server) go through the export accessors, which share a
+// mutex with the writer that is never held across I/O.
+class SampleLog {
+public:
+    static const size_t RING_PAGES = 32;              // 128 KB of PSRAM
+    static const size_t PAGES_PER_SEGMENT = 64;       // 256 KB files
+    static constexpr float FS_HIGH_WATER = 0.90f;     // Trim oldest segment above this
+
+    SampleLog();
+
+    // Allocates the ring and mounts LittleFS (formatting a blank partition)
+    bool begin();
+
+    void append(const SensorSample& sample, uint8_t signature, uint8_t flags);
+
+    // Write all sealed pages to flash; returns pages written
+    size_t flush();
+
+    // Anchor page timestamps to wall-clock time once NTP is available (any task)
+    void setEpoch(uint32_t epochNow, unsigned long uptimeNow);
+
+    static void encode(const SensorSample& sample, uint8_t signature, uint8_t flags,
+                       uint16_t dtMs, SampleRecord& out);
+    static void decode(const SampleRecord& record, unsigned long timestampMs, SensorSample& out);
+    static void segmentPath(char* buf, size_t len, uint32_t firstSequence);
+
+    // ===== EXPORT (any task) =====
+    // Ring slots that may still hold pages: [first, end). A sealed page can be
+    // streamed straight from the ring while sealedPage() returns it; the open
+    // page is still changing and must be copied out.
+    void ramSlots(size_t& first, size_t& end);
+    const SampleLogPage* sealedPage(size_t slot);
+    bool copyOpenPage(SampleLogPage& out);
+
+    // Copies the oldest page with header.sequence >= 'sequence', from RAM
+    // when it is still there, else from flash. 'open' is set when the copy
+    // is of the page still receiving appends. False when no page that new
+    // exists yet. Pages lost to ring overflow or flash trimming are skipped.
+    bool readPageFrom(uint32_t sequence, SampleLogPage& out, bool& open);
+
+    bool ready() const { return _ring != nullptr; }
+    bool flashReady() const { return _fsReady; }
+    uint32_t nextSequence() const { return _nextSequence; }
+    uint32_t recordsWritten() const { return _recordsWritten; }
+    uint32_t pagesFlushed() const { return _pagesFlushed; }
+    uint32_t pagesDropped() const { return _pagesDropped; }
+
+private:
+    SampleLogPage& page(size_t slot) { return _ring[slot % RING_PAGES]; }
+    void openPage(unsigned long timestampMs);
+    void sealPage();
+    bool writePage(const SampleLogPage& p);
+    void scanSegments();
+    bool readFlashPageFrom(uint32_t sequence, uint32_t before, SampleLogPage& out);
+    bool trimOldestSegment();
+
+    SampleLogPage* _ring;
+    SemaphoreHandle_t _mutex;
+    size_t _openSlot;          // Page receiving appends
+    size_t _flushSlot;         // Oldest sealed page not yet on flash
+    bool _pageOpen;
+    unsigned long _lastTimestamp;
+
+    bool _fsReady;
+    uint32_t _bootId;
+    uint32_t _nextSequence;
+    uint32_t _segmentSequence;  // First page of the segment being appended
+    size_t _segmentPages;
+    uint32_t _epochOffset;      // epoch - uptime seconds, 0 = unknown
+
+    uint32_t _recordsWritten;
+    uint32_t _pagesFlushed;
+    uint32_t _pagesDropped;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SENSOR_CHANNEL_H
+#define SENSOR_CHANNEL_H
+
+#include <Arduino.h>
+#include "bsec2.h"
+#include "pms_reader.h"
+#include "seqlock.h"
+#include "pollution_detector.h"
+#include "spike_store.h"
+#include "spike_tracker.h"
+
+// One reading handed from the acquisition task to the analysis task
+struct AcquiredReading {
+    SensorSample sample;
+    int patternIndex;      // Signature table match at capture time
+    uint32_t tableVersion; // Table that patternIndex refers to
+    uint8_t channel;       // Index into the channel table
+};
+
+// Wiring of one sensor position
+struct SensorChannelConfig {
+    const char* name;           // Label in CSV rows, logs and metrics
+    uint8_t i2cAddress;         // BME688 (SDO selects 0x76/0x77)
+    HardwareSerial* pmsSerial;  // PMS7003 UART
+    int pmsRxPin, pmsTxPin;
+};
+
+// One BME688 + PMS7003 pair with its own BSEC instance, baseline and spike
+// state. Every channel runs the same signature table; only the state that
+// depends on what one sensor has seen is per channel.
+//
+// Acquisition fields belong to the acquisition task and detection fields to
+// the analysis task; the volatile flags are read across tasks (LED, metrics).
+struct SensorChannel {
+    SensorChannel(uint8_t channelIndex, const SensorChannelConfig& channelConfig,
+                  float iaqThreshold, float vocThreshold, float co2Threshold, float pm25Threshold,
+                  const SpikeConfig& spikeConfig)
+        : index(channelIndex), config(channelConfig), present(false),
+          i2cAddress(channelConfig.i2cAddress), pms(*channelConfig.pmsSerial),
+          nextBsecCall(0), lastReadingTime(0), bsecDataReady(false), iaqAccuracy(0),
+          pmsWarmupUntil(0), hasValidData(false), hasPMSData(false),
+          staging{ { 0, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN }, -1, 0, channelIndex },
+          detector(iaqThreshold, vocThreshold, co2Threshold, pm25Threshold),
+          spike(spikeConfig), baselineReady(false), inSpike(false), currentSpike(), totalSpikes(0) {}
+
+    const uint8_t index;
+    const SensorChannelConfig& config;
+
+    // ===== ACQUISITION =====
+    bool present;                  // BME688 found and BSEC2 running
+    uint8_t i2cAddress;            // intf_ptr of i2c_read()/i2c_write()
+    Bsec2 bsec;
+    PmsFrameReader pms;
+    unsigned long nextBsecCall;
+    unsigned long lastReadingTime;
+    volatile bool bsecDataReady;   // Set by newDataCallback() during run()
+    uint8_t iaqAccuracy;           // 0-3 from the IAQ output; 3 = calibrated
+    unsigned long pmsWarmupUntil;  // PM stays NAN until then
+    bool hasValidData;
+    bool hasPMSData;
+
+    // Latest values: assembled field by field in 'staging', then published
+    // whole so other tasks never see a torn reading
+    AcquiredReading staging;
+    Seqlock<AcquiredReading> latest;
+
+    // ===== DETECTION =====
+    PollutionDetector detector;    // This sensor's baseline and trend history
+    SpikeTracker spike;
+    volatile bool baselineReady;
+    volatile bool inSpike;         // spike.inSpike(), for other tasks
+    SpikeEvent currentSpike;
+    int totalSpikes;
+};
+
+#endif
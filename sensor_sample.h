@@ -0,0 +1,18 @@
+#ifndef SENSOR_SAMPLE_H
+#define SENSOR_SAMPLE_H
+
+#include <Arduino.h>
+
+// BME688 + PMS7003 pairs one controller drives (see sensor_channel.h)
+const int SENSOR_CHANNELS = 2;
+
+// One complete multi-sensor reading (BME688 via BSEC2 + PMS7003)
+struct SensorSample {
+    unsigned long timestampMs; // millis() when captured
+    float temp, humidity, pressure;
+    float iaq, co2, voc;       // VOC in ppm
+    float rawGas;              // Gas resistance in ohms
+    float pm1_0, pm2_5, pm10_0; // NAN when no PMS data
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <string.h>
+
+// Single-writer sequence lock for publishing a small POD struct to readers on
+// other tasks/cores. The writer bumps the sequence to odd, copies, then bumps
+// it to even; a reader retries if the sequence was odd or changed while it
+// copied. Readers never block the writer and nobody takes a mutex.
+template <typename T>
+class Seqlock {
+public:
+    Seqlock() : _seq(0), _value() {}
+
+    // Writer side (one task only)
+    void publish(const T& value) {
+        uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&_value, &value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_release);
+        _seq.store(seq + 2, std::memory_order_relaxed);
+    }
+
+    // Reader side: spins only while a write is in flight (a few hundred ns)
+    T read() const {
+        T copy;
+        uint32_t before, after;
+        do {
+            before = _seq.load(std::memory_order_acquire);
+            memcpy(&copy, &_value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = _seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        return copy;
+    }
+
+    // Number of completed publishes
+    uint32_t version() const { return _seq.load(std::memory_order_acquire) / 2; }
+
+private:
+    std::atomic<uint32_t> _seq;
+    T _value;
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include "signature_store.h"
+#include <Preferences.h>
+
+const char* const SignatureStore::PARTITION_LABEL = "rules";
+
+static const size_t ERASE_SECTOR = 4096;
+
+// HMAC of each slot's accepted image; a slot without one never loads
+static const char* MAC_NAMESPACE = "rules";
+static const char* const MAC_KEYS[SignatureStore::SLOTS] = { "mac0", "mac1" };
+
+SignatureStore::SignatureStore()
+    : _partition(nullptr), _mapped(nullptr), _mapHandle(0), _active(-1), _target(-1),
+      _expected(0), _written(0), _keyLength(0), _lastError(TABLE_OK), _updates(0) {
+    mbedtls_md_init(&_hmac);
+    for (int i = 0; i < SLOTS; i++) {
+        _slots[i].set = nullptr;
+        _slots[i].rows = nullptr;
+    }
+}
+
+bool SignatureStore::begin(const char* key) {
+    if (_mapped != nullptr) return true;
+
+    _keyLength = key ? min(strlen(key), KEY_MAX) : 0;
+    if (_keyLength > 0) memcpy(_key, key, _keyLength);
+    if (_keyLength > 0 &&
+        mbedtls_md_setup(&_hmac, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1) != 0) {
+        _keyLength = 0;
+    }
+
+    _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                          (esp_partition_subtype_t)PARTITION_SUBTYPE,
+                                          PARTITION_LABEL);
+    if (_partition == nullptr || _partition->size < SLOTS * SLOT_SIZE) return false;
+
+    // Both sets and their row storage up front (PSRAM when present)
+    for (int i = 0; i < SLOTS; i++) {
+        if (_slots[i].set == nullptr) _slots[i].set = SignatureSet::create();
+        size_t rowBytes = RuleIndex::MAX_RULES * sizeof(PollutionPattern);
+        if (_slots[i].rows == nullptr) _slots[i].rows = (PollutionPattern*)ps_malloc(rowBytes);
+        if (_slots[i].rows == nullptr) _slots[i].rows = (PollutionPattern*)malloc(rowBytes);
+        if (_slots[i].set == nullptr || _slots[i].rows == nullptr) return false;
+    }
+
+    const void* mapped;
+    if (esp_partition_mmap(_partition, 0, SLOTS * SLOT_SIZE, SPI_FLASH_MMAP_DATA,
+                           &mapped, &_mapHandle) != ESP_OK) {
+        return false;
+    }
+    _mapped = (const uint8_t*)mapped;
+
+    // Newest valid slot that was signed when it went in wins
+    int best = -1;
+    uint32_t bestVersion = 0;
+    Preferences prefs;
+    bool haveMacs = _keyLength > 0 && prefs.begin(MAC_NAMESPACE, true);
+    for (int i = 0; i < SLOTS; i++) {
+        if (!haveMacs || prefs.getBytes(MAC_KEYS[i], _mac, MAC_SIZE) != MAC_SIZE) continue;
+        if (validateSignatureTable(slotImage(i), SLOT_SIZE) != TABLE_OK || !signatureMatches(i)) continue;
+        const SignatureTableHeader* h = (const SignatureTableHeader*)slotImage(i);
+        if (best < 0 || h->version > bestVersion) {
+            best = i;
+            bestVersion = h->version;
+        }
+    }
+    if (haveMacs) prefs.end();
+    if (best >= 0 && load(best)) {
+        PollutionSignatures::publish(_slots[best].set);
+        _active = best;
+    }
+    return true;
+}
+
+// Parses and compiles a slot into its own set; the set must be idle
+bool SignatureStore::load(int slot) {
+    Slot& s = _slots[slot];
+    int count;
+    uint32_t version;
+    _lastError = readSignatureTable(slotImage(slot), SLOT_SIZE, s.rows, RuleIndex::MAX_RULES,
+                                    count, version);
+    if (_lastError != TABLE_OK) return false;
+    if (!s.set->compile(s.rows, count, version)) {
+        _lastError = TABLE_TOO_MANY_ROWS;
+        return false;
+    }
+    return true;
+}
+
+// Sector by sector: each erase stalls flash access on both cores, so give
+// the acquisition task a tick between them instead of one long stall
+bool SignatureStore::eraseSlot(int slot) {
+    size_t offset = slot * SLOT_SIZE;
+    for (size_t done = 0; done < SLOT_SIZE; done += ERASE_SECTOR) {
+        if (esp_partition_erase_range(_partition, offset + done, ERASE_SECTOR) != ESP_OK) return false;
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+SignatureStore::UpdateResult SignatureStore::beginUpdate(size_t size, const uint8_t mac[MAC_SIZE]) {
+    if (_mapped == nullptr) return UPDATE_NOT_READY;
+    if (_keyLength == 0) return UPDATE_UNAUTHORIZED;
+    if (size > SLOT_SIZE) return UPDATE_TOO_LARGE;
+
+    _target = (_active == 0) ? 1 : 0;
+    _expected = size;
+    _written = 0;
+    memcpy(_mac, mac, MAC_SIZE);
+
+    // A reader may still hold the target set from before the last swap
+    PollutionSignatures::waitUntilIdle(_slots[_target].set);
+    if (!eraseSlot(_target)) {
+        _target = -1;
+        return UPDATE_FLASH_ERROR;
+    }
+    return UPDATE_OK;
+}
+
+SignatureStore::UpdateResult SignatureStore::write(const uint8_t* data, size_t length) {
+    if (_target < 0) return UPDATE_NOT_READY;
+    if (_written + length > _expected) {
+        _target = -1;
+        return UPDATE_TOO_LARGE;
+    }
+    if (esp_partition_write(_partition, _target * SLOT_SIZE + _written, data, length) != ESP_OK) {
+        _target = -1;
+        return UPDATE_FLASH_ERROR;
+    }
+    _written += length;
+    return UPDATE_OK;
+}
+
+SignatureStore::UpdateResult SignatureStore::commit() {
+    if (_target < 0) return UPDATE_NOT_READY;
+    int slot = _target;
+    _target = -1;
+
+    // The mapping reads the fresh flash contents (writes flush the cache)
+    _lastError = validateSignatureTable(slotImage(slot), _written);
+    if (_lastError != TABLE_OK) return UPDATE_INVALID;
+
+    // Unsigned images are erased, not just ignored
+    if (!signatureMatches(slot)) {
+        eraseSlot(slot);
+        return UPDATE_UNAUTHORIZED;
+    }
+
+    const SignatureTableHeader* h = (const SignatureTableHeader*)slotImage(slot);
+    if (h->version <= activeVersion()) return UPDATE_NOT_NEWER;
+
+    if (!load(slot)) return UPDATE_INVALID;
+
+    // Recorded before the swap, so a reboot picks the table that went live
+    Preferences prefs;
+    if (!prefs.begin(MAC_NAMESPACE, false)) return UPDATE_FLASH_ERROR;
+    bool saved = prefs.putBytes(MAC_KEYS[slot], _mac, MAC_SIZE) == MAC_SIZE;
+    prefs.end();
+    if (!saved) return UPDATE_FLASH_ERROR;
+
+    PollutionSignatures::publish(_slots[slot].set);
+    _active = slot;
+    _updates++;
+    return UPDATE_OK;
+}
+
+// HMAC of a validated slot's image (header and payload) against _mac; the
+// comparison takes the same time wherever the first difference is
+bool SignatureStore::signatureMatches(int slot) {
+    const SignatureTableHeader* h = (const SignatureTableHeader*)slotImage(slot);
+    uint8_t mac[MAC_SIZE];
+    if (mbedtls_md_hmac_starts(&_hmac, _key, _keyLength) != 0 ||
+        mbedtls_md_hmac_update(&_hmac, slotImage(slot), sizeof(*h) + h->payloadSize) != 0 ||
+        mbedtls_md_hmac_finish(&_hmac, mac) != 0) {
+        return false;
+    }
+    uint8_t diff = 0;
+    for (size_t i = 0; i < MAC_SIZE; i++) diff |= mac[i] ^ _mac[i];
+    return diff == 0;
+}
+
+SignatureStore::UpdateResult SignatureStore::reset() {
+    if (_mapped == nullptr) return UPDATE_NOT_READY;
+    _target = -1;
+
+    // Detectors move to the built-in table before either slot goes away
+    PollutionSignatures::publish(&PollutionSignatures::builtin());
+    _active = -1;
+    Preferences prefs;
+    if (prefs.begin(MAC_NAMESPACE, false)) {
+        prefs.clear();
+        prefs.end();
+    }
+    for (int i = 0; i < SLOTS; i++) {
+        PollutionSignatures::waitUntilIdle(_slots[i].set);
+        if (!eraseSlot(i)) return UPDATE_FLASH_ERROR;
+    }
+    return UPDATE_OK;
+}
+
+uint32_t SignatureStore::activeVersion() const {
+    return _active < 0 ? PollutionSignatures::builtin().version : _slots[_active].set->version;
+}
+
+int SignatureStore::activeRows() const {
+    return _active < 0 ? PollutionSignatures::builtin().numPatterns : _slots[_active].set->numPatterns;
+}
+
+const char* SignatureStore::resultName(UpdateResult result) {
+    switch (result) {
+        case UPDATE_OK:          return "ok";
+        case UPDATE_INVALID:     return "invalid table";
+        case UPDATE_NOT_NEWER:   return "version not newer than active table";
+        case UPDATE_TOO_LARGE:   return "table too large";
+        case UPDATE_FLASH_ERROR: return "flash error";
+        case UPDATE_NOT_READY:   return "no rules partition";
+        case UPDATE_UNAUTHORIZED: return "bad or missing signature";
+        default:                 return "unknown";
+    }
+}
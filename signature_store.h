@@ -0,0 +1,107 @@
+#ifndef SIGNATURE_STORE_H
+#define SIGNATURE_STORE_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <mbedtls/md.h>
+#include "signature_table.h"
+
+// Signature tables pushed over WiFi, kept in the "rules" data partition
+// (see partitions.csv) as two SIGNATURE_TABLE_MAX_SIZE slots. The whole
+// partition is memory-mapped once at boot and the newest valid slot becomes
+// the active table; with no valid slot the built-in table stays active.
+//
+// An update always goes to the slot that is not active, so the running
+// table and its flash image are never touched. Once the new image checks
+// out it is compiled into that slot's preallocated SignatureSet and
+// published in one pointer store; detect() picks it up at its next sample.
+// A torn or corrupt upload fails its checksum and the previous table stays
+// in charge, now and after a reboot.
+//
+// The checksum only proves the image arrived intact. An update is also
+// signed: beginUpdate() takes an HMAC-SHA256 of the whole image under the
+// key given to begin(), and commit() erases the image unless the slot's
+// contents match it. The HMAC of each accepted slot is kept in NVS and
+// checked again at boot, so a slot that was never accepted cannot take
+// over after a reboot. Without a key, updates are refused outright. reset()
+// erases both slots and returns to the built-in table, the way out of a
+// table (or version) that should never have been installed.
+//
+// Everything is allocated in begin(); updates allocate nothing. Update
+// calls come from the export task only.
+class SignatureStore {
+public:
+    static const int SLOTS = 2;
+    static const size_t SLOT_SIZE = SIGNATURE_TABLE_MAX_SIZE;
+    static const uint8_t PARTITION_SUBTYPE = 0x40;
+    static const char* const PARTITION_LABEL;
+    static const size_t MAC_SIZE = 32;       // HMAC-SHA256
+    static const size_t KEY_MAX = 64;
+
+    // Store-level outcomes, on top of SignatureTableError
+    enum UpdateResult : uint8_t {
+        UPDATE_OK = 0,
+        UPDATE_INVALID,     // See lastError()
+        UPDATE_NOT_NEWER,   // Version must exceed the active one
+        UPDATE_TOO_LARGE,
+        UPDATE_FLASH_ERROR,
+        UPDATE_NOT_READY,   // No partition or no memory
+        UPDATE_UNAUTHORIZED, // No key configured, or the image's HMAC doesn't match
+    };
+
+    SignatureStore();
+
+    // Maps the partition, allocates both sets and publishes the newest valid
+    // slot. False without a partition (the built-in table stays active).
+    // 'key' signs updates; empty refuses them.
+    bool begin(const char* key);
+    bool ready() const { return _mapped != nullptr; }
+
+    // Upload session: begin, feed the image in any chunk size, then commit.
+    // beginUpdate() erases the target slot a sector at a time; 'mac' is
+    // the sender's HMAC-SHA256 of the image, checked by commit().
+    UpdateResult beginUpdate(size_t size, const uint8_t mac[MAC_SIZE]);
+    UpdateResult write(const uint8_t* data, size_t length);
+    UpdateResult commit();
+    void abort() { _target = -1; }
+
+    // Back to the built-in table: both slots erased, so any version can be
+    // pushed next. Blocks until no detector holds a pushed table.
+    UpdateResult reset();
+    bool updatesEnabled() const { return _keyLength > 0; }
+
+    SignatureTableError lastError() const { return _lastError; }
+    uint32_t activeVersion() const;
+    int activeRows() const;
+    int activeSlot() const { return _active; }   // -1: built-in table
+    uint32_t updatesApplied() const { return _updates; }
+
+    static const char* resultName(UpdateResult result);
+
+private:
+    struct Slot {
+        SignatureSet* set;
+        PollutionPattern* rows;     // Strings point into the mapped slot
+    };
+
+    const uint8_t* slotImage(int slot) const { return _mapped + slot * SLOT_SIZE; }
+    bool load(int slot);
+    bool eraseSlot(int slot);
+    bool signatureMatches(int slot);
+
+    const esp_partition_t* _partition;
+    const uint8_t* _mapped;
+    spi_flash_mmap_handle_t _mapHandle;
+    Slot _slots[SLOTS];
+    int _active;
+    int _target;                    // Slot being written, -1 when idle
+    size_t _expected, _written;
+    uint8_t _key[KEY_MAX];
+    size_t _keyLength;
+    uint8_t _mac[MAC_SIZE];         // Expected HMAC of the upload
+    mbedtls_md_context_t _hmac;     // Set up in begin()
+    SignatureTableError _lastError;
+    uint32_t _updates;
+};
+
+#endif
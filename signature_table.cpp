@@ -0,0 +1,162 @@
+#include "signature_table.h"
+
+const char* signatureTableErrorName(SignatureTableError error) {
+    switch (error) {
+        case TABLE_OK:            return "ok";
+        case TABLE_TRUNCATED:     return "truncated";
+        case TABLE_BAD_MAGIC:     return "not a signature table";
+        case TABLE_BAD_FORMAT:    return "unsupported format";
+        case TABLE_BAD_CHECKSUM:  return "checksum mismatch";
+        case TABLE_TOO_MANY_ROWS: return "too many rows";
+        case TABLE_BAD_ROW:       return "invalid row";
+        default:                  return "unknown";
+    }
+}
+
+uint32_t signatureTableCrc(const void* data, size_t length, uint32_t crc) {
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+    while (length--) {
+        crc ^= *p++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static bool validSignature(uint8_t id) {
+    return id == SIG_NONE ||
+           (id >= SIG_LETHAL_OPIOID_WEAPON && id <= SIG_STEALTH_CHEMICAL) ||
+           (id >= SIG_DECREASING_VOC_PATTERN && id < SIG_COUNT);
+}
+
+// Offset must start a NUL-terminated string inside the pool
+static bool validString(const uint8_t* pool, size_t poolSize, uint16_t offset) {
+    if (offset >= poolSize) return false;
+    size_t limit = min(poolSize - offset, SIGNATURE_TABLE_MAX_STRING);
+    return memchr(pool + offset, '\0', limit) != nullptr;
+}
+
+static bool validRow(const SignatureTableRow& row, const uint8_t* pool, size_t poolSize) {
+    if (!validSignature(row.signature) || row.isThreat > 1) return false;
+    for (int a = 0; a < AXIS_COUNT; a++) {
+        const RuleRange& r = row.range[a];
+        if (isnan(r.min) || isnan(r.max) || r.min > r.max) return false;
+    }
+    return validString(pool, poolSize, row.nameOffset) &&
+           validString(pool, poolSize, row.descriptionOffset);
+}
+
+SignatureTableError validateSignatureTable(const uint8_t* image, size_t size) {
+    SignatureTableHeader h;
+    if (size < sizeof(h)) return TABLE_TRUNCATED;
+    memcpy(&h, image, sizeof(h));
+
+    if (h.magic != SIGNATURE_TABLE_MAGIC) return TABLE_BAD_MAGIC;
+    if (h.headerCrc != signatureTableCrc(&h, offsetof(SignatureTableHeader, headerCrc))) {
+        return TABLE_BAD_CHECKSUM;
+    }
+    if (h.format != SIGNATURE_TABLE_FORMAT || h.rowSize != sizeof(SignatureTableRow)) {
+        return TABLE_BAD_FORMAT;
+    }
+    if (h.payloadSize > size - sizeof(h)) return TABLE_TRUNCATED;
+    if (h.rowCount > RuleIndex::MAX_RULES) return TABLE_TOO_MANY_ROWS;
+
+    size_t rowBytes = (size_t)h.rowCount * sizeof(SignatureTableRow);
+    if (rowBytes > h.payloadSize) return TABLE_TRUNCATED;
+
+    const uint8_t* payload = image + sizeof(h);
+    if (h.payloadCrc != signatureTableCrc(payload, h.payloadSize)) return TABLE_BAD_CHECKSUM;
+
+    const uint8_t* pool = payload + rowBytes;
+    size_t poolSize = h.payloadSize - rowBytes;
+    for (uint16_t i = 0; i < h.rowCount; i++) {
+        SignatureTableRow row;
+        memcpy(&row, payload + i * sizeof(row), sizeof(row));
+        if (!validRow(row, pool, poolSize)) return TABLE_BAD_ROW;
+    }
+    return TABLE_OK;
+}
+
+SignatureTableError readSignatureTable(const uint8_t* image, size_t size,
+                                       PollutionPattern* rows, int maxRows, int& count,
+                                       uint32_t& version) {
+    SignatureTableError error = validateSignatureTable(image, size);
+    if (error != TABLE_OK) return error;
+
+    SignatureTableHeader h;
+    memcpy(&h, image, sizeof(h));
+    if (h.rowCount > maxRows) return TABLE_TOO_MANY_ROWS;
+
+    const uint8_t* payload = image + sizeof(h);
+    const char* pool = (const char*)payload + h.rowCount * sizeof(SignatureTableRow);
+    for (uint16_t i = 0; i < h.rowCount; i++) {
+        SignatureTableRow row;
+        memcpy(&row, payload + i * sizeof(row), sizeof(row));
+        PollutionPattern& p = rows[i];
+        p.name = pool + row.nameOffset;
+        p.signature = row.signature;
+        p.priority = row.priority;
+        for (int a = 0; a < AXIS_COUNT; a++) p.range[a] = row.range[a];
+        p.description = pool + row.descriptionOffset;
+        p.isThreat = row.isThreat != 0;
+    }
+    count = h.rowCount;
+    version = h.version;
+    return TABLE_OK;
+}
+
+// Appends a string to the pool; returns its offset, or -1 if it won't fit
+static long appendString(uint8_t* pool, size_t& used, size_t capacity, const char* text) {
+    size_t len = strnlen(text, SIGNATURE_TABLE_MAX_STRING - 1);
+    if (used + len + 1 > capacity) return -1;
+    long offset = (long)used;
+    memcpy(pool + used, text, len);
+    pool[used + len] = '\0';
+    used += len + 1;
+    return offset;
+}
+
+size_t writeSignatureTable(const PollutionPattern* rows, int count, uint32_t version,
+                           uint8_t* out, size_t capacity) {
+    capacity = min(capacity, SIGNATURE_TABLE_MAX_SIZE);
+    size_t rowBytes = (size_t)count * sizeof(SignatureTableRow);
+    if (count < 0 || count > RuleIndex::MAX_RULES ||
+        sizeof(SignatureTableHeader) + rowBytes > capacity) {
+        return 0;
+    }
+
+    uint8_t* payload = out + sizeof(SignatureTableHeader);
+    uint8_t* pool = payload + rowBytes;
+    size_t poolCapacity = capacity - sizeof(SignatureTableHeader) - rowBytes;
+    size_t poolUsed = 0;
+
+    for (int i = 0; i < count; i++) {
+        const PollutionPattern& p = rows[i];
+        long name = appendString(pool, poolUsed, poolCapacity, p.name);
+        long description = appendString(pool, poolUsed, poolCapacity, p.description);
+        if (name < 0 || description < 0) return 0;
+
+        SignatureTableRow row = {};
+        row.signature = p.signature;
+        row.isThreat = p.isThreat ? 1 : 0;
+        row.priority = (int16_t)p.priority;
+        row.nameOffset = (uint16_t)name;
+        row.descriptionOffset = (uint16_t)description;
+        for (int a = 0; a < AXIS_COUNT; a++) row.range[a] = p.range[a];
+        memcpy(payload + i * sizeof(row), &row, sizeof(row));
+    }
+
+    SignatureTableHeader h = {};
+    h.magic = SIGNATURE_TABLE_MAGIC;
+    h.format = SIGNATURE_TABLE_FORMAT;
+    h.rowSize = sizeof(SignatureTableRow);
+    h.version = version;
+    h.rowCount = (uint16_t)count;
+    h.payloadSize = (uint32_t)(rowBytes + poolUsed);
+    h.payloadCrc = signatureTableCrc(payload, h.payloadSize);
+    h.headerCrc = signatureTableCrc(&h, offsetof(SignatureTableHeader, headerCrc));
+    memcpy(out, &h, sizeof(h));
+    return sizeof(h) + h.payloadSize;
+}
@@ -0,0 +1,74 @@
+#ifndef SIGNATURE_TABLE_H
+#define SIGNATURE_TABLE_H
+
+#include <Arduino.h>
+#include "pollution_signatures.h"
+
+// Binary signature table, as pushed over WiFi and kept in the "rules"
+// partition. Little-endian, fixed-size rows followed by a string pool:
+//
+//   SignatureTableHeader
+//   SignatureTableRow[rowCount]
+//   NUL-terminated names and descriptions, referenced by pool offset
+//
+// headerCrc covers the header up to itself, payloadCrc everything after
+// the header. Produced by tools/rules.cpp; rows use the same axis order and
+// RULE_ANY convention as the built-in table.
+static const uint32_t SIGNATURE_TABLE_MAGIC = 0x4C425453;   // "STBL"
+static const uint16_t SIGNATURE_TABLE_FORMAT = 1;
+static const size_t SIGNATURE_TABLE_MAX_SIZE = 0x10000;     // One partition slot
+static const size_t SIGNATURE_TABLE_MAX_STRING = 128;
+
+struct SignatureTableHeader {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t rowSize;       // sizeof(SignatureTableRow) when written
+    uint32_t version;       // Table version; a device only accepts a newer one
+    uint16_t rowCount;
+    uint16_t reserved;
+    uint32_t payloadSize;   // Rows plus string pool
+    uint32_t payloadCrc;
+    uint32_t headerCrc;
+};
+static_assert(sizeof(SignatureTableHeader) == 28, "SignatureTableHeader layout changed");
+
+struct SignatureTableRow {
+    uint8_t signature;      // SIG_NONE or a window/trend SignatureId
+    uint8_t isThreat;
+    int16_t priority;
+    uint16_t nameOffset;    // Into the string pool
+    uint16_t descriptionOffset;
+    RuleRange range[AXIS_COUNT];
+};
+static_assert(sizeof(SignatureTableRow) == 8 + 8 * AXIS_COUNT, "SignatureTableRow layout changed");
+
+enum SignatureTableError : uint8_t {
+    TABLE_OK = 0,
+    TABLE_TRUNCATED,
+    TABLE_BAD_MAGIC,
+    TABLE_BAD_FORMAT,
+    TABLE_BAD_CHECKSUM,
+    TABLE_TOO_MANY_ROWS,
+    TABLE_BAD_ROW,
+};
+
+const char* signatureTableErrorName(SignatureTableError error);
+
+// Standard CRC-32 (IEEE, reflected); pass the previous result to continue
+uint32_t signatureTableCrc(const void* data, size_t length, uint32_t crc = 0);
+
+// Checks framing, checksums and every row without copying anything
+SignatureTableError validateSignatureTable(const uint8_t* image, size_t size);
+
+// Validates, then fills rows[] with patterns whose strings point into the
+// image, so the image must stay mapped for as long as the rows are used.
+SignatureTableError readSignatureTable(const uint8_t* image, size_t size,
+                                       PollutionPattern* rows, int maxRows, int& count,
+                                       uint32_t& version);
+
+// Serializes patterns into out. Returns the image size, or 0 if it does not
+// fit in capacity (or exceeds SIGNATURE_TABLE_MAX_SIZE).
+size_t writeSignatureTable(const PollutionPattern* rows, int count, uint32_t version,
+                           uint8_t* out, size_t capacity);
+
+#endif
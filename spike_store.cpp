@@ -0,0 +1,207 @@
+#include "spike_store.h"
+#include "sample_log.h"
+#include <LittleFS.h>
+
+static const char* SPIKE_FILE = "/spikes.bin";
+static const char* SPIKE_TEMP_FILE = "/spikes.tmp";
+
+SpikeStore::SpikeStore()
+    : _records(nullptr), _hours(nullptr), _endBound(nullptr), _endHigh(0), _nextId(0),
+      _latestTime(0), _bootFirstId(0),
+      _fileRecords(0), _bootFileRecord(0), _flashReady(false) {
+    for (int i = 0; i < 256; i++) _latestBySignature[i] = NO_EVENT;
+}
+
+bool SpikeStore::begin(bool flashReady) {
+    if (_records == nullptr) {
+        size_t recordBytes = CAPACITY * sizeof(SpikeRecord);
+        size_t hourBytes = HOUR_BUCKETS * sizeof(HourBucket);
+        size_t boundBytes = CAPACITY * sizeof(uint32_t);
+        _records = (SpikeRecord*)ps_malloc(recordBytes);
+        if (_records == nullptr) _records = (SpikeRecord*)malloc(recordBytes);   // No PSRAM
+        _hours = (HourBucket*)ps_malloc(hourBytes);
+        if (_hours == nullptr) _hours = (HourBucket*)malloc(hourBytes);
+        _endBound = (uint32_t*)ps_malloc(boundBytes);
+        if (_endBound == nullptr) _endBound = (uint32_t*)malloc(boundBytes);
+        if (_records == nullptr || _hours == nullptr || _endBound == nullptr) return false;
+        for (uint32_t i = 0; i < HOUR_BUCKETS; i++) {
+            _hours[i].hour = NO_EVENT;
+        }
+    }
+    _flashReady = flashReady;
+    if (_flashReady) loadFromFlash();
+    _bootFirstId = _nextId;
+    _bootFileRecord = _fileRecords;
+    return true;
+}
+
+void SpikeStore::add(const SpikeEvent& event, uint32_t startTime) {
+    if (_records == nullptr) return;
+
+    const PollutionDetector::DetectionResult& d = event.detection;
+    SpikeRecord r;
+    r.startTime = startTime;
+    r.durationMs = event.endTime - event.startTime;
+    r.prevSameSignature = NO_EVENT;
+    r.maxIaq = quantizeU16(event.maxIaq, 10.0f);
+    r.maxVoc = quantizeU32(event.maxVoc, 1000000.0);
+    r.maxCo2 = quantizeU16(event.maxCo2, 1.0f);
+    r.maxPm25 = quantizeU16(event.maxPm25, 10.0f);
+    r.maxRawGas = quantizeU32(event.maxRawGas, 10.0);
+    r.signature = d.signature;
+    r.flags = (d.isThreat ? SPIKE_FLAG_THREAT : 0) | sampleFlagsForChannel(event.channel);
+    r.temp = quantizeI16(d.temp, 100.0f);
+    r.iaq = quantizeU16(d.iaq, 10.0f);
+    r.voc = quantizeU32(d.voc, 1000000.0);
+    r.humidity = quantizeU16(d.humidity, 100.0f);
+    r.rawGas = quantizeU32(d.rawGas, 10.0);
+    r.pm2_5 = quantizeU16(d.pm2_5, 10.0f);
+    r.vocDelta = quantizeI16(d.vocDelta, 1000.0f);
+    r.trend = quantizeI16(d.trend, 1000.0f);
+
+    index(r);
+    if (_flashReady && appendToFlash(r)) _fileRecords++;
+}
+
+// Places the record at the next id and links it into every index
+void SpikeStore::index(const SpikeRecord& record) {
+    uint32_t id = _nextId++;
+    _records[id % CAPACITY] = record;
+    link(id);
+}
+
+void SpikeStore::link(uint32_t id) {
+    SpikeRecord& r = _records[id % CAPACITY];
+    r.prevSameSignature = _latestBySignature[r.signature];
+    _latestBySignature[r.signature] = id;
+    _endHigh = max(_endHigh, r.startTime + r.durationMs / 1000);
+    _endBound[id % CAPACITY] = _endHigh;
+
+    if (r.signature < SIG_COUNT) {
+        uint32_t hour = r.startTime / 3600;
+        HourBucket& b = _hours[hour % HOUR_BUCKETS];
+        if (b.hour != hour) {
+            b.hour = hour;
+            memset(b.counts, 0, sizeof(b.counts));
+        }
+        if (b.counts[r.signature] < 0xFFFF) b.counts[r.signature]++;
+    }
+}
+
+void SpikeStore::rebuildIndexes() {
+    for (int i = 0; i < 256; i++) _latestBySignature[i] = NO_EVENT;
+    for (uint32_t i = 0; i < HOUR_BUCKETS; i++) _hours[i].hour = NO_EVENT;
+    _endHigh = 0;
+    for (uint32_t id = firstId(); id < _nextId; id++) link(id);
+}
+
+void SpikeStore::shiftBootTimes(int32_t delta) {
+    if (_records == nullptr || delta == 0) return;
+    for (uint32_t id = max(_bootFirstId, firstId()); id < _nextId; id++) {
+        _records[id % CAPACITY].startTime += delta;
+    }
+    rebuildIndexes();
+
+    if (!_flashReady || _fileRecords == _bootFileRecord) return;
+    File f = LittleFS.open(SPIKE_FILE, "r+");
+    if (!f) return;
+    SpikeRecord r;
+    for (uint32_t i = _bootFileRecord; i < _fileRecords; i++) {
+        if (!f.seek(i * sizeof(SpikeRecord)) || f.read((uint8_t*)&r, sizeof(r)) != sizeof(r)) break;
+        r.startTime += delta;
+        if (!f.seek(i * sizeof(SpikeRecord)) || f.write((const uint8_t*)&r, sizeof(r)) != sizeof(r)) break;
+    }
+    f.close();
+}
+
+const SpikeRecord* SpikeStore::get(uint32_t id) const {
+    if (_records == nullptr || id == NO_EVENT || id < firstId() || id >= _nextId) return nullptr;
+    return &_records[id % CAPACITY];
+}
+
+uint32_t SpikeStore::previous(uint32_t id) const {
+    const SpikeRecord* r = get(id);
+    return r && get(r->prevSameSignature) ? r->prevSameSignature : NO_EVENT;
+}
+
+// Every event before the first id whose end bound reaches 'time' ended, so
+// started, earlier; past it only the few overlapping events are stepped over
+uint32_t SpikeStore::lowerBound(uint32_t time) const {
+    if (_records == nullptr) return _nextId;
+    uint32_t lo = firstId(), hi = _nextId;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (_endBound[mid % CAPACITY] < time) lo = mid + 1;
+        else hi = mid;
+    }
+    while (lo < _nextId && _records[lo % CAPACITY].startTime < time) lo++;
+    return lo;
+}
+
+// Newest first; once the end bound drops below 'since', no older event can count
+uint32_t SpikeStore::countSince(uint8_t signature, uint32_t since) const {
+    uint32_t count = 0;
+    for (uint32_t id = latest(signature); get(id) != nullptr; id = previous(id)) {
+        if (_endBound[id % CAPACITY] < since) break;
+        if (get(id)->startTime >= since) count++;
+    }
+    return count;
+}
+
+uint16_t SpikeStore::hourlyCount(uint32_t hour, uint8_t signature) const {
+    if (_hours == nullptr || signature >= SIG_COUNT) return 0;
+    const HourBucket& b = _hours[hour % HOUR_BUCKETS];
+    return b.hour == hour ? b.counts[signature] : 0;
+}
+
+void SpikeStore::toDetection(const SpikeRecord& r, PollutionDetector::DetectionResult& out) {
+    out.signature = (SignatureId)r.signature;
+    out.isThreat = (r.flags & SPIKE_FLAG_THREAT) != 0;
+    out.isSpike = true;
+    out.iaq = dequantizeU16(r.iaq, 10.0f);
+    out.voc = dequantizeU32(r.voc, 1000000.0);
+    out.temp = dequantizeI16(r.temp, 100.0f);
+    out.humidity = dequantizeU16(r.humidity, 100.0f);
+    out.rawGas = dequantizeU32(r.rawGas, 10.0);
+    out.pm2_5 = dequantizeU16(r.pm2_5, 10.0f);
+    out.vocDelta = dequantizeI16(r.vocDelta, 1000.0f);
+    out.trend = dequantizeI16(r.trend, 1000.0f);
+}
+
+// ===== FLASH =====
+
+bool SpikeStore::appendToFlash(const SpikeRecord& record) {
+    File f = LittleFS.open(SPIKE_FILE, FILE_APPEND);
+    if (!f) return false;
+    size_t n = f.write((const uint8_t*)&record, sizeof(record));
+    f.close();
+    return n == sizeof(record);
+}
+
+// Rebuilds the RAM indexes from the newest CAPACITY records. A file that has
+// grown past twice that is compacted to its tail first.
+void SpikeStore::loadFromFlash() {
+    File f = LittleFS.open(SPIKE_FILE, FILE_READ);
+    if (!f) return;
+
+    uint32_t stored = f.size() / sizeof(SpikeRecord);
+    uint32_t skip = stored > CAPACITY ? stored - CAPACITY : 0;
+    f.seek(skip * sizeof(SpikeRecord));
+
+    SpikeRecord r;
+    while (f.read((uint8_t*)&r, sizeof(r)) == sizeof(r)) index(r);
+    f.close();
+    _latestTime = _endHigh;
+    _fileRecords = stored;
+
+    if (stored > 2 * CAPACITY) {
+        File out = LittleFS.open(SPIKE_TEMP_FILE, FILE_WRITE);
+        if (!out) return;
+        bool ok = true;
+        for (uint32_t id = firstId(); id < _nextId && ok; id++) {
+            ok = out.write((const uint8_t*)get(id), sizeof(SpikeRecord)) == sizeof(SpikeRecord);
+        }
+        out.close();
+        if (ok && LittleFS.rename(SPIKE_TEMP_FILE, SPIKE_FILE)) _fileRecords = size();
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef SPIKE_STORE_H
+#define SPIKE_STORE_H
+
+#include <Arduino.h>
+#include "pollution_detector.h"
+#include "sample_log.h"
+
+// Spike event as tracked while it is in progress
+struct SpikeEvent {
+    unsigned long startTime;
+    unsigned long endTime;
+    PollutionDetector::DetectionResult detection; // Formatted only when reported
+    float maxIaq;
+    float maxVoc;
+    float maxCo2;
+    float maxPm25;
+    float maxRawGas;  // Add raw gas tracking
+    uint8_t channel;  // Sensor channel that saw it
+};
+
+// Completed spike, 48 bytes. Scales match SampleRecord; the detection
+// snapshot keeps just enough to re-render the signature text.
+struct SpikeRecord {
+    uint32_t startTime;          // Unix seconds (see clockSeconds())
+    uint32_t durationMs;
+    uint32_t prevSameSignature;  // Id of the previous event with this signature (RAM only)
+    uint32_t maxVoc, maxRawGas;
+    uint16_t maxIaq, maxCo2, maxPm25;
+    uint8_t signature;
+    uint8_t flags;               // SPIKE_FLAG_THREAT | sampleFlagsForChannel(); old files: 0/1
+    int16_t temp;
+    uint16_t iaq, humidity, pm2_5;
+    uint32_t voc, rawGas;
+    int16_t vocDelta, trend;     // x1000
+};
+static_assert(sizeof(SpikeRecord) == 48, "SpikeRecord layout changed");
+
+const uint8_t SPIKE_FLAG_THREAT = 0x01;
+
+// Spike history in PSRAM, appended to /spikes.bin on LittleFS and reloaded
+// at boot. Event ids increase forever; the newest CAPACITY stay in RAM.
+// Indexes, all maintained on add():
+//  - by time: ids are in completion order, so start times are only roughly
+//    sorted (sensors overlap), but the running maximum of end times is
+//    monotonic in id; time lookups bisect on it and stop once below it
+//  - by signature: per-signature chain from the newest event backwards
+//  - hourly: event counts per signature for the last HOUR_BUCKETS hours
+// Analysis task only.
+class SpikeStore {
+public:
+    static const uint32_t CAPACITY = 4096;
+    static const uint32_t HOUR_BUCKETS = 168;   // One week
+    static const uint32_t NO_EVENT = 0xFFFFFFFF;
+
+    SpikeStore();
+
+    bool begin(bool flashReady);
+    void add(const SpikeEvent& event, uint32_t startTime);
+
+    uint32_t firstId() const { return _nextId > CAPACITY ? _nextId - CAPACITY : 0; }
+    uint32_t nextId() const { return _nextId; }
+    uint32_t size() const { return _nextId - firstId(); }
+    const SpikeRecord* get(uint32_t id) const;
+
+    // First event starting at or after 'time' (nextId() if none)
+    uint32_t lowerBound(uint32_t time) const;
+
+    // Newest end time among the events loaded at boot (0 if none)
+    uint32_t latestTime() const { return _latestTime; }
+
+    // Moves the events added since boot by 'delta' seconds, in RAM and on
+    // flash: their times were provisional until the clock was set
+    void shiftBootTimes(int32_t delta);
+
+    // Newest event of a signature, then follow prevSameSignature via previous()
+    uint32_t latest(uint8_t signature) const { return _latestBySignature[signature]; }
+    uint32_t previous(uint32_t id) const;
+
+    // Events of 'signature' that started at or after 'since'
+    uint32_t countSince(uint8_t signature, uint32_t since) const;
+
+    // Events per signature in the clock hour 'hour' (time / 3600)
+    uint16_t hourlyCount(uint32_t hour, uint8_t signature) const;
+
+    static void toDetection(const SpikeRecord& record, PollutionDetector::DetectionResult& out);
+    static uint8_t channelOf(const SpikeRecord& record) { return sampleFlagsChannel(record.flags); }
+
+private:
+    struct HourBucket {
+        uint32_t hour;
+        uint16_t counts[SIG_COUNT];
+    };
+
+    void index(const SpikeRecord& record);
+    void link(uint32_t id);
+    void rebuildIndexes();
+    bool appendToFlash(const SpikeRecord& record);
+    void loadFromFlash();
+
+    SpikeRecord* _records;
+    HourBucket* _hours;
+    uint32_t* _endBound;        // Per slot: newest end time of this id and every older one
+    uint32_t _endHigh;          // _endBound of the newest id
+    uint32_t _nextId;
+    uint32_t _latestBySignature[256];
+    uint32_t _latestTime;
+    uint32_t _bootFirstId;      // First event added since boot
+    uint32_t _fileRecords;      // In SPIKE_FILE
+    uint32_t _bootFileRecord;   // File position of the first event added since boot
+    bool _flashReady;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "spike_tracker.h"
+
+static const BaselineChannel METRIC_BASELINE[SPIKE_METRICS] = {
+    BASELINE_IAQ, BASELINE_VOC, BASELINE_CO2, BASELINE_PM2_5
+};
+
+SpikeTracker::SpikeTracker(const SpikeConfig& config) : _config(config) {
+    reset();
+}
+
+void SpikeTracker::reset() {
+    _state = IDLE;
+    _run = 0;
+    _score = 0.0f;
+    _scoreMetric = SPIKE_METRIC_NONE;
+    _trigger = SPIKE_METRIC_NONE;
+    _triggerScore = 0.0f;
+    _runStart = 0;
+    _startTime = 0;
+    _endTime = 0;
+    _resumes = 0;
+}
+
+// Missing values (PM before warm-up) score 0: they neither open nor hold a spike
+float SpikeTracker::zScore(float value, float mean, float stddev, float minDelta, float enterZ) {
+    if (isnan(value)) return 0.0f;
+    float floor = minDelta / enterZ;
+    return (value - mean) / (stddev > floor ? stddev : floor);
+}
+
+const char* SpikeTracker::metricName(SpikeMetric metric) {
+    switch (metric) {
+        case SPIKE_METRIC_IAQ:   return "IAQ";
+        case SPIKE_METRIC_VOC:   return "VOC";
+        case SPIKE_METRIC_CO2:   return "CO2";
+        case SPIKE_METRIC_PM2_5: return "PM2.5";
+        default:                 return "-";
+    }
+}
+
+SpikeTracker::Transition SpikeTracker::update(const SensorSample& sample, const BaselineService& baseline) {
+    _score = 0.0f;
+    _scoreMetric = SPIKE_METRIC_NONE;
+    if (!baseline.ready()) return NONE;
+    unsigned long now = sample.timestampMs;
+
+    const float values[SPIKE_METRICS] = { sample.iaq, sample.voc, sample.co2, sample.pm2_5 };
+    for (int m = 0; m < SPIKE_METRICS; m++) {
+        BaselineChannel b = METRIC_BASELINE[m];
+        // An empty PM window scores against 0, i.e. the value itself
+        float z = zScore(values[m], baseline.windowMean(b), baseline.windowStddev(b),
+                         _config.minDelta[m], _config.enterZ);
+        if (z > _score) {
+            _score = z;
+            _scoreMetric = (SpikeMetric)m;
+        }
+    }
+    bool enter = _score >= _config.enterZ;
+    bool clear = _score < _config.exitZ;
+
+    switch (_state) {
+        case IDLE:
+        case ARMING:
+            if (!enter) {
+                _state = IDLE;
+                _run = 0;
+                return NONE;
+            }
+            if (_run++ == 0) _runStart = now;
+            _state = ARMING;
+            if (_run < _config.enterCount) return NONE;
+            _state = ACTIVE;
+            _run = 0;
+            _startTime = _runStart;
+            _trigger = _scoreMetric;
+            _triggerScore = _score;
+            _resumes = 0;
+            return STARTED;
+
+        case ACTIVE:
+        case RELEASING:
+            if (!clear) {
+                _state = ACTIVE;
+                _run = 0;
+                return NONE;
+            }
+            if (_run++ == 0) _endTime = now;
+            _state = RELEASING;
+            if (_run < _config.exitCount) return NONE;
+            _state = COOLDOWN;
+            _run = 0;
+            return RELEASED;
+
+        case COOLDOWN:
+            _run = enter ? _run + 1 : 0;
+            if (_run == 1) _runStart = now;
+            if (now - _endTime >= _config.cooldownMs) {
+                // Final; a run already under way carries on as a new event
+                _state = _run > 0 ? ARMING : IDLE;
+                if (_run >= _config.enterCount) _run = _config.enterCount - 1;
+                return ENDED;
+            }
+            if (_run < _config.enterCount) return NONE;
+            _state = ACTIVE;
+            _run = 0;
+            _resumes++;
+            return RESUMED;
+    }
+    return NONE;
+}
@@ -0,0 +1,118 @@
+#ifndef SPIKE_TRACKER_H
+#define SPIKE_TRACKER_H
+
+#include <Arduino.h>
+#include "baseline_service.h"
+
+// Metrics a spike can be triggered by
+enum SpikeMetric : uint8_t {
+    SPIKE_METRIC_IAQ = 0,
+    SPIKE_METRIC_VOC,
+    SPIKE_METRIC_CO2,
+    SPIKE_METRIC_PM2_5,
+    SPIKE_METRICS,
+    SPIKE_METRIC_NONE = SPIKE_METRICS
+};
+
+// Tuning of one sensor channel's spike state machine
+struct SpikeConfig {
+    float enterZ;                   // Score that opens a spike
+    float exitZ;                    // Score everything must fall below to close it
+    float minDelta[SPIKE_METRICS];  // Rise above the baseline mean that scores enterZ on a flat baseline
+    uint8_t enterCount;             // Consecutive readings at enterZ before a spike opens
+    uint8_t exitCount;              // Consecutive readings under exitZ before it closes
+    unsigned long cooldownMs;       // A re-entry this soon after closing resumes the same event
+};
+
+// Device tuning, shared by the firmware and tools/replay. The thresholds
+// are also the detector's, and the rise that opens a spike on a flat
+// baseline; a noisy one needs proportionally more.
+const float SPIKE_THRESHOLD_IAQ = 10.0f;   // Reduced from 15.0
+const float SPIKE_THRESHOLD_VOC = 0.05f;   // Reduced from 0.15
+const float SPIKE_THRESHOLD_CO2 = 50.0f;   // Reduced from 100.0
+const float SPIKE_THRESHOLD_PM25 = 25.0f;  // PM2.5 spike threshold (µg/m³)
+const SpikeConfig SPIKE_CONFIG = {
+    4.0f,   // enterZ
+    2.0f,   // exitZ
+    { SPIKE_THRESHOLD_IAQ, SPIKE_THRESHOLD_VOC, SPIKE_THRESHOLD_CO2, SPIKE_THRESHOLD_PM25 },
+    2,      // enterCount: 20 s at 10 s readings
+    3,      // exitCount: 30 s
+    120000  // cooldownMs: a re-entry within 2 min is the same event
+};
+
+// Per-channel spike state machine with enter/exit hysteresis. Each metric
+// scores its distance from the baseline window as a z-score,
+//
+//   z = (value - windowMean) / max(windowStddev, minDelta / enterZ)
+//
+// so a noisy baseline needs a proportionally larger rise, while a flat one
+// (stddev near zero) still needs minDelta, the fixed spike thresholds of
+// old. The highest-scoring metric drives the machine:
+//
+//   IDLE -(score >= enterZ)-> ARMING -(enterCount in a row)-> ACTIVE
+//   ACTIVE -(all under exitZ)-> RELEASING -(exitCount in a row)-> COOLDOWN
+//   COOLDOWN -(enterCount in a row at enterZ)-> ACTIVE, same event
+//   COOLDOWN -(cooldownMs elapsed)-> IDLE, event final
+//
+// A short dip or a second burst within the cooldown therefore extends one
+// event instead of logging several; an event is reported once, when it can
+// no longer resume. Analysis task only.
+class SpikeTracker {
+public:
+    enum State : uint8_t { IDLE, ARMING, ACTIVE, RELEASING, COOLDOWN };
+
+    enum Transition : uint8_t {
+        NONE,
+        STARTED,     // ARMING -> ACTIVE: a new event
+        RESUMED,     // COOLDOWN -> ACTIVE: the previous event continues
+        RELEASED,    // RELEASING -> COOLDOWN; the readings are clean again
+        ENDED        // COOLDOWN -> IDLE; report the event now
+    };
+
+    explicit SpikeTracker(const SpikeConfig& config);
+
+    void reset();
+
+    // One reading, scored against the baseline before it takes the reading;
+    // feed the baseline afterwards with holdsBaseline()
+    Transition update(const SensorSample& sample, const BaselineService& baseline);
+
+    State state() const { return _state; }
+
+    // Event open (ACTIVE or RELEASING): spike rows, LED, detector input
+    bool inSpike() const { return _state == ACTIVE || _state == RELEASING; }
+
+    // After update(): keep this reading out of the baseline window. Holds
+    // the open event and every reading at enterZ, so arming runs and
+    // re-entries during the cooldown never shift the scores they are
+    // judged by; a clean reading after a false arm goes in.
+    bool holdsBaseline() const { return inSpike() || over(); }
+
+    // This reading scored at enterZ, before debouncing
+    bool over() const { return _score >= _config.enterZ; }
+
+    float score() const { return _score; }
+    SpikeMetric trigger() const { return _trigger; }          // Metric that opened the event
+    float triggerScore() const { return _triggerScore; }
+    unsigned long startTime() const { return _startTime; }    // First reading of the opening run
+    unsigned long endTime() const { return _endTime; }        // First reading of the closing run
+    uint32_t resumes() const { return _resumes; }             // Re-entries merged into this event
+
+    static float zScore(float value, float mean, float stddev, float minDelta, float enterZ);
+    static const char* metricName(SpikeMetric metric);
+
+private:
+    const SpikeConfig& _config;
+    State _state;
+    uint8_t _run;                  // Consecutive readings toward the next state
+    float _score;
+    SpikeMetric _scoreMetric;
+    SpikeMetric _trigger;
+    float _triggerScore;
+    unsigned long _runStart;
+    unsigned long _startTime;
+    unsigned long _endTime;
+    uint32_t _resumes;
+};
+
+#endif
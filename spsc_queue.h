@@ -0,0 +1,57 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Lock-free single-producer/single-consumer ring of fixed capacity N (one
+// slot is kept free to tell full from empty). push() is only ever called by
+// the producer task and pop() by the consumer task; the head/tail indices
+// are published with release/acquire ordering so the element copy is
+// visible before the index moves. Neither side ever blocks.
+template <typename T, size_t N>
+class SpscQueue {
+public:
+    SpscQueue() : _head(0), _tail(0), _dropped(0) {}
+
+    // Producer side. Returns false (and counts a drop) if the queue is full.
+    bool push(const T& item) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t next = (head + 1) % N;
+        if (next == _tail.load(std::memory_order_acquire)) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _items[head] = item;
+        _head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the queue is empty.
+    bool pop(T& item) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = _items[tail];
+        _tail.store((tail + 1) % N, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        size_t head = _head.load(std::memory_order_acquire);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        return (head + N - tail) % N;
+    }
+
+    static size_t capacity() { return N - 1; }
+    uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    T _items[N];
+    std::atomic<size_t> _head; // Next slot the producer writes
+    std::atomic<size_t> _tail; // Next slot the consumer reads
+    std::atomic<uint32_t> _dropped;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "temporal_engine.h"
+
+TemporalEngine::TemporalEngine() {
+    reset();
+}
+
+void TemporalEngine::reset() {
+    _head = 0;
+    _count = 0;
+    _sinceRebuild = 0;
+    _originMs = 0;
+    _transitions = 0;
+    _distinctThreats = 0;
+    memset(_threatCounts, 0, sizeof(_threatCounts));
+    memset(_fit, 0, sizeof(_fit));
+    memset(_lastValid, 0, sizeof(_lastValid));
+}
+
+float TemporalEngine::axisValue(const SensorSample& sample, int axis) {
+    switch (axis) {
+        case AXIS_IAQ:      return sample.iaq;
+        case AXIS_VOC:      return sample.voc;
+        case AXIS_CO2:      return sample.co2;
+        case AXIS_TEMP:     return sample.temp;
+        case AXIS_HUMIDITY: return sample.humidity;
+        case AXIS_RAW_GAS:  return sample.rawGas;
+        case AXIS_PM2_5:    return sample.pm2_5;
+        default:            return NAN;
+    }
+}
+
+void TemporalEngine::addPoint(int axis, double t, float y) {
+    if (isnan(y)) return;
+    Fit& f = _fit[axis];
+    f.n++;
+    f.st += t;
+    f.stt += t * t;
+    f.sy += y;
+    f.sty += t * y;
+}
+
+void TemporalEngine::removePoint(int axis, double t, float y) {
+    if (isnan(y)) return;
+    Fit& f = _fit[axis];
+    f.n--;
+    f.st -= t;
+    f.stt -= t * t;
+    f.sy -= y;
+    f.sty -= t * y;
+}
+
+void TemporalEngine::push(const SensorSample& sample, uint8_t signature, bool isThreat) {
+    if (_count == 0) _originMs = sample.timestampMs;
+
+    // Evict the oldest sample and the transition it started
+    if (_count == WINDOW) {
+        int oldest = slot(0);
+        double t = relTime(_timestamps[oldest]);
+        for (int axis = 0; axis < AXIS_COUNT; axis++) {
+            removePoint(axis, t, _values[oldest][axis]);
+        }
+        if (_signatures[oldest] != _signatures[slot(1)]) _transitions--;
+        if (_threats[oldest] && --_threatCounts[_signatures[oldest]] == 0) _distinctThreats--;
+        _count--;
+    }
+
+    if (_count > 0 && _signatures[slot(_count - 1)] != signature) _transitions++;
+    if (isThreat && _threatCounts[signature]++ == 0) _distinctThreats++;
+
+    int s = _head;
+    _timestamps[s] = sample.timestampMs;
+    _signatures[s] = signature;
+    _threats[s] = isThreat;
+    double t = relTime(sample.timestampMs);
+    for (int axis = 0; axis < AXIS_COUNT; axis++) {
+        float y = axisValue(sample, axis);
+        _values[s][axis] = y;
+        addPoint(axis, t, y);
+        if (!isnan(y)) {
+            LastValid& lv = _lastValid[axis];
+            lv.prevValue = lv.value;
+            lv.prevMs = lv.ms;
+            lv.havePrev = lv.have;
+            lv.value = y;
+            lv.ms = sample.timestampMs;
+            lv.have = true;
+        }
+    }
+    _head = (_head + 1) % WINDOW;
+    _count++;
+
+    if (++_sinceRebuild >= WINDOW) rebuild();
+}
+
+// Re-anchor time at the oldest sample and recompute the sums exactly
+void TemporalEngine::rebuild() {
+    _sinceRebuild = 0;
+    memset(_fit, 0, sizeof(_fit));
+    if (_count == 0) return;
+
+    _originMs = _timestamps[slot(0)];
+    for (int i = 0; i < _count; i++) {
+        int s = slot(i);
+        double t = relTime(_timestamps[s]);
+        for (int axis = 0; axis < AXIS_COUNT; axis++) {
+            addPoint(axis, t, _values[s][axis]);
+        }
+    }
+}
+
+float TemporalEngine::spanSeconds() const {
+    if (_count < 2) return 0.0f;
+    return (_timestamps[slot(_count - 1)] - _timestamps[slot(0)]) / 1000.0f;
+}
+
+float TemporalEngine::slope(RuleAxis axis) const {
+    const Fit& f = _fit[axis];
+    if (f.n < 2) return NAN;
+    double denom = f.n * f.stt - f.st * f.st;
+    if (denom <= 1e-9) return NAN;   // All points at the same instant
+    return (float)((f.n * f.sty - f.st * f.sy) / denom * 60.0);
+}
+
+float TemporalEngine::rate(RuleAxis axis) const {
+    const LastValid& lv = _lastValid[axis];
+    if (!lv.havePrev || lv.ms == lv.prevMs) return NAN;
+    return (lv.value - lv.prevValue) / ((lv.ms - lv.prevMs) / 60000.0f);
+}
+
+float TemporalEngine::latest(RuleAxis axis) const {
+    return _count > 0 ? _values[slot(_count - 1)][axis] : NAN;
+}
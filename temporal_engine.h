@@ -0,0 +1,69 @@
+#ifndef TEMPORAL_ENGINE_H
+#define TEMPORAL_ENGINE_H
+
+#include <Arduino.h>
+#include "range_kernel.h"
+#include "sensor_sample.h"
+
+// Streaming trend statistics over the last WINDOW samples, O(1) per push:
+//  - slope: least-squares fit of value against time, per axis (units/min)
+//  - rate: change between the two most recent valid samples (units/min)
+//  - transitions: signature changes between consecutive samples
+//  - distinct threats: how many different threat signatures are in the window
+// Running sums are rebuilt from the ring once per WINDOW pushes, which keeps
+// the time origin close and stops add/subtract drift.
+class TemporalEngine {
+public:
+    static const int WINDOW = 64;          // ~10 min at 10 s, ~1 min at 1 s
+    static const int MAX_SIGNATURES = 256; // uint8_t signature ids
+
+    TemporalEngine();
+
+    void reset();
+    void push(const SensorSample& sample, uint8_t signature, bool isThreat);
+
+    int count() const { return _count; }
+    float spanSeconds() const;
+
+    float slope(RuleAxis axis) const;
+    float rate(RuleAxis axis) const;
+    float latest(RuleAxis axis) const;
+    int transitions() const { return _transitions; }
+    int distinctThreats() const { return _distinctThreats; }
+
+private:
+    struct Fit {
+        int n;
+        double st, stt, sy, sty;
+    };
+
+    struct LastValid {
+        float value, prevValue;
+        unsigned long ms, prevMs;
+        bool have, havePrev;
+    };
+
+    int slot(int i) const { return (_head + WINDOW - _count + i) % WINDOW; } // 0 = oldest
+    void addPoint(int axis, double t, float y);
+    void removePoint(int axis, double t, float y);
+    void rebuild();
+    double relTime(unsigned long timestampMs) const { return (long)(timestampMs - _originMs) / 1000.0; }
+    static float axisValue(const SensorSample& sample, int axis);
+
+    unsigned long _timestamps[WINDOW];
+    float _values[WINDOW][AXIS_COUNT];
+    uint8_t _signatures[WINDOW];
+    bool _threats[WINDOW];
+    int _head;
+    int _count;
+    int _sinceRebuild;
+    unsigned long _originMs;
+
+    Fit _fit[AXIS_COUNT];
+    LastValid _lastValid[AXIS_COUNT];   // Rates look past NAN gaps
+    int _transitions;
+    uint8_t _threatCounts[MAX_SIGNATURES];
+    int _distinctThreats;
+};
+
+#endif
@@ -0,0 +1,134 @@
+// Host micro-benchmarks for the detector hot path.
+//
+//   pio run -e bench
+//   .pio/build/bench/program [samples]
+//
+// Input is a fixed pseudo-random trace: slow baseline drift with a spike
+// block every few hundred samples, so every rule family gets exercised.
+// Allocations are counted through the global operator new, which is where
+// String and any container growth would show up.
+
+#include <Arduino.h>
+#include <chrono>
+#include <new>
+#include <vector>
+#include "pollution_detector.h"
+
+static unsigned long allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static uint32_t rngState = 12345;
+
+static float uniform() {
+    rngState = rngState * 1664525u + 1013904223u;
+    return (rngState >> 8) / 16777216.0f;
+}
+
+static std::vector<SensorSample> makeTrace(size_t count) {
+    std::vector<SensorSample> trace(count);
+    for (size_t i = 0; i < count; i++) {
+        bool spike = (i % 400) >= 380;
+        SensorSample& s = trace[i];
+        s.timestampMs = i * 10000UL;
+        s.temp = 28.0f + 2.0f * sinf(i / 500.0f) + uniform() * 0.2f;
+        s.humidity = 65.0f + 10.0f * sinf(i / 700.0f) + uniform();
+        s.pressure = 1008.0f + uniform();
+        s.iaq = (spike ? 120.0f : 45.0f) + uniform() * 30.0f;
+        s.co2 = (spike ? 900.0f : 550.0f) + uniform() * 100.0f;
+        s.voc = (spike ? 2.0f : 0.5f) + uniform() * 0.8f;
+        s.rawGas = (spike ? 40000.0f : 150000.0f) + uniform() * 50000.0f;
+        bool pm = (i % 3) != 0;
+        s.pm1_0 = pm ? 8.0f + uniform() * 10.0f : NAN;
+        s.pm2_5 = pm ? (spike ? 60.0f : 12.0f) + uniform() * 20.0f : NAN;
+        s.pm10_0 = pm ? 20.0f + uniform() * 30.0f : NAN;
+    }
+    return trace;
+}
+
+struct BenchResult {
+    double seconds;
+    unsigned long allocations;
+};
+
+template <typename F>
+static BenchResult run(F body) {
+    unsigned long before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    body();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return { seconds, allocations - before };
+}
+
+static void report(const char* name, size_t samples, const BenchResult& r) {
+    printf("%-22s %12.0f samples/s %9.1f ns/sample %8.3f allocs/sample\n",
+           name, samples / r.seconds, r.seconds * 1e9 / samples, (double)r.allocations / samples);
+}
+
+static volatile unsigned long sink;  // Keeps results observable
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    std::vector<SensorSample> trace = makeTrace(count);
+    std::vector<bool> spikes(count);
+    for (size_t i = 0; i < count; i++) spikes[i] = (i % 400) >= 381;
+
+    static PollutionDetector detector(10.0f, 0.05f, 50.0f, 25.0f);
+    detector.begin();
+    printf("%zu samples\n", count);
+
+    report("updateBaseline()", count, run([&] {
+        for (size_t i = 0; i < count; i++) detector.updateBaseline(trace[i], spikes[i]);
+    }));
+
+    report("detect(sample)", count, run([&] {
+        unsigned long acc = 0;
+        for (size_t i = 0; i < count; i++) acc += detector.detect(trace[i], spikes[i]).signature;
+        sink = acc;
+    }));
+
+    report("detect(values)", count, run([&] {
+        unsigned long acc = 0;
+        for (size_t i = 0; i < count; i++) {
+            const SensorSample& s = trace[i];
+            acc += detector.detect(s.iaq, s.voc, s.co2, s.temp, s.humidity, s.rawGas, spikes[i],
+                                   s.pm1_0, s.pm2_5, s.pm10_0).signature;
+        }
+        sink = acc;
+    }));
+
+    // Column layout for the batch path, built outside the timed region
+    std::vector<float> iaq(count), voc(count), co2(count), temp(count), hum(count), gas(count), pm25(count);
+    for (size_t i = 0; i < count; i++) {
+        iaq[i] = trace[i].iaq; voc[i] = trace[i].voc; co2[i] = trace[i].co2; temp[i] = trace[i].temp;
+        hum[i] = trace[i].humidity; gas[i] = trace[i].rawGas; pm25[i] = trace[i].pm2_5;
+    }
+    std::vector<SignatureId> out(count);
+    report("detectBatch()", count, run([&] {
+        detector.detectBatch(iaq.data(), voc.data(), co2.data(), temp.data(), hum.data(), gas.data(),
+                             nullptr, pm25.data(), nullptr, count, out.data());
+        sink = out[count - 1];
+    }));
+
+    report("formatSignature()", count, run([&] {
+        char text[PollutionDetector::SIGNATURE_TEXT_MAX];
+        unsigned long acc = 0;
+        for (size_t i = 0; i < count; i++) {
+            PollutionDetector::DetectionResult r = {};
+            r.signature = out[i];
+            r.iaq = iaq[i]; r.voc = voc[i]; r.temp = temp[i];
+            r.humidity = hum[i]; r.rawGas = gas[i]; r.pm2_5 = pm25[i];
+            acc += PollutionDetector::formatSignature(r, text, sizeof(text));
+        }
+        sink = acc;
+    }));
+    return 0;
+}
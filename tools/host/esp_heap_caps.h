@@ -0,0 +1,20 @@
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+// ESP-IDF heap_caps calls the detector sources make, on the host heap
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+// aligned_alloc() wants the size in whole alignments
+inline void* heap_caps_aligned_alloc(size_t alignment, size_t size, unsigned caps) {
+    (void)caps;
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+inline void heap_caps_free(void* ptr) { free(ptr); }
+
+#endif
@@ -0,0 +1,239 @@
+// Re-runs the detector over a CSV capture from the Serial monitor and
+// compares its signatures with the ones the device recorded.
+//
+//   pio run -e replay
+//   .pio/build/replay/program [--rows | --diff] [--verify] capture.csv
+//
+// --verify also runs every row through the reference predicate chain and
+// stops at the first row where the optimized detector disagrees with it.
+//
+// Non-CSV lines (status messages, emoji logs) are skipped, so a raw monitor
+// dump works as-is. Rows from each sensor (last column; captures from
+// single-sensor firmware have none and count as one sensor) go to their own
+// detector and spike state machine, as in processReading(). Captures
+// taken with "csv <seconds>" decimation hold fewer baseline samples than
+// the device saw, so expect some disagreement until the window refills.
+
+#include <Arduino.h>
+#include <chrono>
+#include "pollution_detector.h"
+#include "detector_reference.h"
+#include "spike_tracker.h"
+
+static const int CSV_FIELDS = 17;
+static const int CSV_FIELDS_NO_SENSOR = 16;   // Before the sensor column
+static const unsigned long REBOOT_GAP_MS = 10000;  // Clock went backwards: assume one reading
+
+class StderrPrint : public Print {
+public:
+    size_t write(uint8_t c) override { return fputc(c, stderr) == EOF ? 0 : 1; }
+};
+
+enum CsvColumn {
+    COL_TIMESTAMP, COL_TEMP, COL_HUMIDITY, COL_PRESSURE, COL_IAQ, COL_CO2, COL_VOC,
+    COL_RAW_GAS, COL_PM1_0, COL_PM2_5, COL_PM10_0, COL_BASELINE_READY, COL_IN_SPIKE,
+    COL_SIGNATURE, COL_SPIKE_DURATION, COL_TOTAL_SPIKES, COL_SENSOR
+};
+
+// Detector and timeline of one sensor column
+struct SensorStream {
+    SensorStream() : detector(SPIKE_THRESHOLD_IAQ, SPIKE_THRESHOLD_VOC, SPIKE_THRESHOLD_CO2, SPIKE_THRESHOLD_PM25),
+                     spike(SPIKE_CONFIG), rows(0), lastMs(0), offsetMs(0) { name[0] = '\0'; }
+
+    char name[8];
+    PollutionDetector detector;
+    SpikeTracker spike;
+    unsigned long rows;
+    long long lastMs, offsetMs;
+};
+
+// Stream for a sensor label; nullptr once every stream is taken
+static SensorStream* streamFor(SensorStream* streams, const char* name) {
+    for (int i = 0; i < SENSOR_CHANNELS; i++) {
+        if (streams[i].name[0] == '\0') {
+            snprintf(streams[i].name, sizeof(streams[i].name), "%s", name);
+            return &streams[i];
+        }
+        if (strcmp(streams[i].name, name) == 0) return &streams[i];
+    }
+    return nullptr;
+}
+
+// Splits in place; returns the number of fields
+static int splitCsv(char* line, char* fields[], int maxFields) {
+    int n = 0;
+    char* p = line;
+    while (n < maxFields) {
+        fields[n++] = p;
+        char* comma = strchr(p, ',');
+        if (!comma) break;
+        *comma = '\0';
+        p = comma + 1;
+    }
+    char* end = fields[n - 1] + strcspn(fields[n - 1], "\r\n");
+    *end = '\0';
+    return n;
+}
+
+static float parseValue(const char* field) {
+    if (*field == '\0') return NAN;
+    char* end;
+    float v = strtof(field, &end);
+    return end == field ? NAN : v;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static long daysFromCivil(long y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (long)doe - 719468;
+}
+
+// "YYYY-MM-DD HH:MM:SS" or "Boot+HH:MM:SS", as formatTimestamp() writes them
+static bool parseTimestamp(const char* text, long long& seconds) {
+    long y, mo, d, h, mi, s;
+    if (sscanf(text, "%ld-%ld-%ld %ld:%ld:%ld", &y, &mo, &d, &h, &mi, &s) == 6) {
+        seconds = daysFromCivil(y, mo, d) * 86400LL + h * 3600 + mi * 60 + s;
+        return true;
+    }
+    if (sscanf(text, "Boot+%ld:%ld:%ld", &h, &mi, &s) == 3) {
+        seconds = h * 3600LL + mi * 60 + s;
+        return true;
+    }
+    return false;
+}
+
+// Recorded text starts with the signature name; take the longest that fits
+static SignatureId recordedSignature(const char* text) {
+    SignatureId best = SIG_COUNT;
+    size_t bestLen = 0;
+    for (int id = 0; id < SIG_COUNT; id++) {
+        const char* name = PollutionDetector::signatureName((SignatureId)id);
+        size_t len = strlen(name);
+        if (len > bestLen && strncmp(text, name, len) == 0) {
+            best = (SignatureId)id;
+            bestLen = len;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    bool printRows = false;
+    bool printDiff = false;
+    bool verify = false;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rows") == 0) printRows = true;
+        else if (strcmp(argv[i], "--diff") == 0) printDiff = true;
+        else if (strcmp(argv[i], "--verify") == 0) verify = true;
+        else path = argv[i];
+    }
+
+    FILE* in = path ? fopen(path, "r") : stdin;
+    if (!in) {
+        fprintf(stderr, "replay: cannot open %s\n", path);
+        return 1;
+    }
+
+    static SensorStream streams[SENSOR_CHANNELS];
+    for (SensorStream& stream : streams) stream.detector.begin();
+    unsigned long recordedCounts[SIG_COUNT + 1] = {};
+    unsigned long replayedCounts[SIG_COUNT] = {};
+    unsigned long rows = 0, agree = 0;
+    bool haveTime = false;
+    long long firstSeconds = 0;
+    double detectSeconds = 0;
+
+    if (printRows) printf("timestamp,sensor,recorded,replayed,is_threat\n");
+
+    char line[512];
+    char* fields[CSV_FIELDS];
+    while (fgets(line, sizeof(line), in)) {
+        int count = splitCsv(line, fields, CSV_FIELDS);
+        if (count != CSV_FIELDS && count != CSV_FIELDS_NO_SENSOR) continue;
+        long long seconds;
+        if (!parseTimestamp(fields[COL_TIMESTAMP], seconds)) continue;
+        const char* sensor = count == CSV_FIELDS ? fields[COL_SENSOR] : "A";
+        SensorStream* stream = streamFor(streams, sensor);
+        if (!stream) continue;
+        PollutionDetector& detector = stream->detector;
+        SpikeTracker& spike = stream->spike;
+
+        if (!haveTime) {
+            firstSeconds = seconds;
+            haveTime = true;
+        }
+        long long ms = (seconds - firstSeconds) * 1000 + stream->offsetMs;
+        if (stream->rows > 0 && ms <= stream->lastMs) {
+            stream->offsetMs += stream->lastMs + REBOOT_GAP_MS - ms;
+            ms = stream->lastMs + REBOOT_GAP_MS;
+        }
+        stream->lastMs = ms;
+
+        SensorSample sample = {
+            (unsigned long)ms,
+            parseValue(fields[COL_TEMP]), parseValue(fields[COL_HUMIDITY]), parseValue(fields[COL_PRESSURE]),
+            parseValue(fields[COL_IAQ]), parseValue(fields[COL_CO2]), parseValue(fields[COL_VOC]),
+            parseValue(fields[COL_RAW_GAS]),
+            parseValue(fields[COL_PM1_0]), parseValue(fields[COL_PM2_5]), parseValue(fields[COL_PM10_0])
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        spike.update(sample, detector.baseline());
+        detector.updateBaseline(sample, spike.holdsBaseline());
+        bool inSpike = spike.inSpike();
+        PollutionDetector::DetectionResult result = detector.detect(sample, inSpike);
+        detectSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (verify) {
+            StderrPrint err;
+            if (!checkDetection(detector, sample, inSpike, &result, err)) {
+                fprintf(stderr, "   at row %lu (%s, sensor %s)\n", rows + 1, fields[COL_TIMESTAMP], sensor);
+                return 2;
+            }
+        }
+
+        SignatureId recorded = recordedSignature(fields[COL_SIGNATURE]);
+        recordedCounts[recorded]++;
+        replayedCounts[result.signature]++;
+        rows++;
+        stream->rows++;
+        if (recorded == result.signature) agree++;
+
+        if (printRows || (printDiff && recorded != result.signature)) {
+            char text[PollutionDetector::SIGNATURE_TEXT_MAX];
+            PollutionDetector::formatSignature(result, text, sizeof(text));
+            printf("%s,%s,%s,%s,%s\n", fields[COL_TIMESTAMP], sensor, fields[COL_SIGNATURE], text,
+                   result.isThreat ? "YES" : "NO");
+        }
+    }
+    if (in != stdin) fclose(in);
+
+    if (rows == 0) {
+        fprintf(stderr, "replay: no CSV rows found\n");
+        return 1;
+    }
+
+    FILE* out = printRows || printDiff ? stderr : stdout;
+    fprintf(out, "Replayed %lu rows in %.1f ms (%.0f samples/s)\n",
+            rows, detectSeconds * 1000.0, detectSeconds > 0 ? rows / detectSeconds : 0.0);
+    for (int i = 0; i < SENSOR_CHANNELS; i++) {
+        if (streams[i].rows > 0) fprintf(out, "Sensor %s: %lu rows\n", streams[i].name, streams[i].rows);
+    }
+    fprintf(out, "Agreement with recorded signatures: %lu/%lu (%.2f%%)\n",
+            agree, rows, 100.0 * agree / rows);
+    fprintf(out, "%-26s %10s %10s\n", "signature", "recorded", "replayed");
+    for (int id = 0; id < SIG_COUNT; id++) {
+        if (recordedCounts[id] == 0 && replayedCounts[id] == 0) continue;
+        fprintf(out, "%-26s %10lu %10lu\n", PollutionDetector::signatureName((SignatureId)id),
+                recordedCounts[id], replayedCounts[id]);
+    }
+    if (recordedCounts[SIG_COUNT]) {
+        fprintf(out, "%-26s %10lu %10s\n", "(unrecognised)", recordedCounts[SIG_COUNT], "-");
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Builds and inspects signature table images for PUT /rules.
+//
+//   pio run -e rules
+//   .pio/build/rules/program dump > table.csv           built-in table as CSV
+//   .pio/build/rules/program build table.csv table.bin <version>
+//   .pio/build/rules/program show table.bin             validate, print as CSV
+//
+// CSV columns: name, signature, priority, threat, a min/max pair per
+// RuleAxis, description (last, so it may contain commas). An empty bound is
+// unbounded on that side; "-" as the signature marks a context pattern.
+// Versions must increase: a device refuses a table that isn't newer than
+// the one it runs. Uploads are signed with the device's rulesKey
+// (main.cpp). To roll out:
+//
+//   MAC=$(openssl dgst -sha256 -hmac "$RULES_KEY" -r table.bin | cut -c1-64)
+//   curl -T table.bin -H "X-Rules-HMAC: $MAC" http://<device>:8080/rules
+//
+// "rules reset" on the serial console erases every pushed table and goes
+// back to the built-in one, which also lifts the version floor.
+
+#include <Arduino.h>
+#include <vector>
+#include "pollution_detector.h"
+#include "signature_table.h"
+
+static const char* AXIS_NAMES[AXIS_COUNT] = {
+    "iaq", "voc", "co2", "temp", "humidity", "raw_gas", "pm2_5"
+};
+
+static void printBound(FILE* out, float v) {
+    if (!isinf(v)) fprintf(out, "%.9g", v);
+}
+
+static void printCsv(FILE* out, const PollutionPattern* rows, int count) {
+    fprintf(out, "name,signature,priority,threat");
+    for (int a = 0; a < AXIS_COUNT; a++) fprintf(out, ",%s_min,%s_max", AXIS_NAMES[a], AXIS_NAMES[a]);
+    fprintf(out, ",description\n");
+
+    for (int i = 0; i < count; i++) {
+        const PollutionPattern& p = rows[i];
+        fprintf(out, "%s,%s,%d,%d", p.name,
+                p.signature == SIG_NONE ? "-" : PollutionDetector::signatureName((SignatureId)p.signature),
+                p.priority, p.isThreat ? 1 : 0);
+        for (int a = 0; a < AXIS_COUNT; a++) {
+            fputc(',', out);
+            printBound(out, p.range[a].min);
+            fputc(',', out);
+            printBound(out, p.range[a].max);
+        }
+        fprintf(out, ",%s\n", p.description);
+    }
+}
+
+static bool parseSignature(const char* text, uint8_t& id) {
+    if (strcmp(text, "-") == 0) {
+        id = SIG_NONE;
+        return true;
+    }
+    for (int s = 1; s < SIG_COUNT; s++) {
+        if (strcmp(text, PollutionDetector::signatureName((SignatureId)s)) == 0) {
+            id = (uint8_t)s;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseBound(const char* text, float unbounded, float& v) {
+    if (*text == '\0') {
+        v = unbounded;
+        return true;
+    }
+    char* end;
+    v = strtof(text, &end);
+    return *end == '\0';
+}
+
+// Splits the first 'fields' columns in place; the last one takes the rest
+static bool splitFields(char* line, char** out, int fields) {
+    line[strcspn(line, "\r\n")] = '\0';
+    for (int i = 0; i < fields - 1; i++) {
+        out[i] = line;
+        char* comma = strchr(line, ',');
+        if (!comma) return false;
+        *comma = '\0';
+        line = comma + 1;
+    }
+    out[fields - 1] = line;
+    return true;
+}
+
+static int build(const char* csvPath, const char* binPath, uint32_t version) {
+    FILE* in = fopen(csvPath, "r");
+    if (!in) {
+        fprintf(stderr, "rules: cannot open %s\n", csvPath);
+        return 1;
+    }
+
+    // Strings live in 'text' until the image is written
+    static const int FIELDS = 4 + 2 * AXIS_COUNT + 1;
+    std::vector<std::string> text;
+    std::vector<PollutionPattern> rows;
+    char line[512];
+    int lineNumber = 0;
+    text.reserve(2 * RuleIndex::MAX_RULES);
+    while (fgets(line, sizeof(line), in)) {
+        lineNumber++;
+        if (lineNumber == 1 || line[0] == '#' || line[0] == '\n') continue;   // Header, comments
+
+        char* f[FIELDS];
+        PollutionPattern p = {};
+        bool ok = splitFields(line, f, FIELDS) && parseSignature(f[1], p.signature);
+        if (ok) {
+            p.priority = atoi(f[2]);
+            p.isThreat = atoi(f[3]) != 0;
+        }
+        for (int a = 0; ok && a < AXIS_COUNT; a++) {
+            ok = parseBound(f[4 + 2 * a], -INFINITY, p.range[a].min) &&
+                 parseBound(f[5 + 2 * a], INFINITY, p.range[a].max);
+        }
+        if (!ok || rows.size() >= (size_t)RuleIndex::MAX_RULES) {
+            fprintf(stderr, "rules: %s:%d: bad row\n", csvPath, lineNumber);
+            fclose(in);
+            return 1;
+        }
+        text.push_back(f[0]);
+        text.push_back(f[FIELDS - 1]);
+        p.name = text[text.size() - 2].c_str();
+        p.description = text.back().c_str();
+        rows.push_back(p);
+    }
+    fclose(in);
+
+    std::vector<uint8_t> image(SIGNATURE_TABLE_MAX_SIZE);
+    size_t size = writeSignatureTable(rows.data(), (int)rows.size(), version, image.data(), image.size());
+    SignatureTableError error = size ? validateSignatureTable(image.data(), size) : TABLE_TOO_MANY_ROWS;
+    if (error != TABLE_OK) {
+        fprintf(stderr, "rules: %s\n", size ? signatureTableErrorName(error) : "table too large");
+        return 1;
+    }
+
+    FILE* out = fopen(binPath, "wb");
+    if (!out || fwrite(image.data(), 1, size, out) != size) {
+        fprintf(stderr, "rules: cannot write %s\n", binPath);
+        if (out) fclose(out);
+        return 1;
+    }
+    fclose(out);
+    fprintf(stderr, "%s: version %lu, %zu rows, %zu bytes\n", binPath, (unsigned long)version,
+            rows.size(), size);
+    return 0;
+}
+
+static int show(const char* binPath) {
+    FILE* in = fopen(binPath, "rb");
+    if (!in) {
+        fprintf(stderr, "rules: cannot open %s\n", binPath);
+        return 1;
+    }
+    std::vector<uint8_t> image(SIGNATURE_TABLE_MAX_SIZE);
+    size_t size = fread(image.data(), 1, image.size(), in);
+    fclose(in);
+
+    static PollutionPattern rows[RuleIndex::MAX_RULES];
+    int count;
+    uint32_t version;
+    SignatureTableError error = readSignatureTable(image.data(), size, rows, RuleIndex::MAX_RULES,
+                                                   count, version);
+    if (error != TABLE_OK) {
+        fprintf(stderr, "rules: %s: %s\n", binPath, signatureTableErrorName(error));
+        return 1;
+    }
+
+    // Compile it the way the device will, so a table that can't load fails here
+    static SignatureSet set;
+    if (!set.compile(rows, count, version)) {
+        fprintf(stderr, "rules: %s: does not compile\n", binPath);
+        return 1;
+    }
+    fprintf(stderr, "%s: version %lu, %d rows (%d detector rules)\n", binPath,
+            (unsigned long)version, count, set.numDetector);
+    printCsv(stdout, rows, count);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 2 && strcmp(argv[1], "dump") == 0) {
+        printCsv(stdout, PollutionSignatures::getSignatures(), PollutionSignatures::getNumSignatures());
+        return 0;
+    }
+    if (argc == 5 && strcmp(argv[1], "build") == 0) {
+        return build(argv[2], argv[3], strtoul(argv[4], nullptr, 10));
+    }
+    if (argc == 3 && strcmp(argv[1], "show") == 0) {
+        return show(argv[2]);
+    }
+    fprintf(stderr, "usage: rules dump | build <csv> <bin> <version> | show <bin>\n");
+    return 2;
+}
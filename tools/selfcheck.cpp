@@ -0,0 +1,91 @@
+// Differential check of the detector against the reference predicate chain.
+//
+//   pio run -e selfcheck
+//   .pio/build/selfcheck/program [samples] [seed]
+//
+// Runs the generated boundary-heavy inputs from detectorSelfCheck() at a
+// few VOC baselines (the residual rules depend on it), then checks that
+// the spike state machine keeps arming runs and cooldown re-entries out of
+// the baseline window. Exits non-zero and prints the inputs of the first
+// divergence.
+
+#include <Arduino.h>
+#include "detector_reference.h"
+#include "spike_tracker.h"
+
+class StdoutPrint : public Print {
+public:
+    size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+};
+
+// Feeds one reading the way processReading() does and checks whether the
+// IAQ window took it
+static bool spikeStep(SpikeTracker& spike, BaselineService& baseline, unsigned long& now,
+                      float iaq, bool expectHeld, SpikeTracker::Transition expect, const char* what) {
+    now += 10000;
+    SensorSample s = { now, 25.0f, 50.0f, 1010.0f, iaq, 600.0f, 0.5f, 100000.0f, NAN, NAN, NAN };
+    int count = baseline.windowCount(BASELINE_IAQ);
+    float mean = baseline.windowMean(BASELINE_IAQ);
+    SpikeTracker::Transition transition = spike.update(s, baseline);
+    baseline.update(s, spike.holdsBaseline());
+    bool held = baseline.windowCount(BASELINE_IAQ) == count && baseline.windowMean(BASELINE_IAQ) == mean;
+    if (held == expectHeld && transition == expect) return true;
+    printf("spike baseline: %s (iaq %.1f): %s, transition %d, expected %s, %d\n", what, iaq,
+           held ? "held" : "taken", transition, expectHeld ? "held" : "taken", expect);
+    return false;
+}
+
+static bool spikeBaselineCheck() {
+    // Fixed tuning so the expected transitions don't follow retunes
+    static const SpikeConfig config = { 4.0f, 2.0f, { 10.0f, 0.05f, 50.0f, 25.0f }, 2, 3, 120000 };
+    static BaselineService baseline;
+    baseline.begin();
+    SpikeTracker spike(config);
+    unsigned long now = 0;
+    typedef SpikeTracker T;
+    for (int i = 0; i < 30; i++) {
+        if (!spikeStep(spike, baseline, now, 40.0f + (i % 3), false, T::NONE, "warm-up")) return false;
+    }
+    return spikeStep(spike, baseline, now, 41.0f, false, T::NONE, "clean") &&
+           // False arm: held while arming, the clean reading after it goes in
+           spikeStep(spike, baseline, now, 70.0f, true, T::NONE, "false arm") &&
+           spikeStep(spike, baseline, now, 41.0f, false, T::NONE, "after false arm") &&
+           // 2-reading arm and the event: the window never moves until
+           // the exitCount-th clean reading closes it
+           spikeStep(spike, baseline, now, 70.0f, true, T::NONE, "arming") &&
+           spikeStep(spike, baseline, now, 70.0f, true, T::STARTED, "start") &&
+           spikeStep(spike, baseline, now, 41.0f, true, T::NONE, "releasing") &&
+           spikeStep(spike, baseline, now, 41.0f, true, T::NONE, "releasing") &&
+           spikeStep(spike, baseline, now, 41.0f, false, T::RELEASED, "released") &&
+           // Cooldown: clean readings go in, a re-entry run is held
+           spikeStep(spike, baseline, now, 41.0f, false, T::NONE, "cooldown") &&
+           spikeStep(spike, baseline, now, 70.0f, true, T::NONE, "re-entry") &&
+           spikeStep(spike, baseline, now, 70.0f, true, T::RESUMED, "resumed");
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    uint32_t seed = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1;
+    StdoutPrint out;
+
+    // Shift the VOC EMA by feeding the baseline service, as readings would
+    static PollutionDetector detector;
+    detector.begin();
+    static const float VOC_LEVELS[] = { 0.5f, 0.52f, 0.6f, 1.5f };
+    unsigned long now = 0;
+    for (float level : VOC_LEVELS) {
+        for (int i = 0; i < 20; i++) {
+            now += BaselineService::EMA_UPDATE_INTERVAL + 1;
+            SensorSample s = { now, 25.0f, 50.0f, 1010.0f, 40.0f, 600.0f, level, 100000.0f, NAN, NAN, NAN };
+            detector.updateBaseline(s, false);
+        }
+        float baseline = detector.baseline().ema(BASELINE_VOC);
+        long bad = detectorSelfCheck(detector, seed, count, out);
+        if (bad >= 0) return 1;
+        printf("vocBaseline %.6f: %zu samples agree\n", baseline, count);
+        seed++;
+    }
+    if (!spikeBaselineCheck()) return 1;
+    printf("spike baseline: window held across arming and re-entry\n");
+    return 0;
+}